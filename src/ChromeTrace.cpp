@@ -0,0 +1,207 @@
+#include "ChromeTrace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <base/Time.hpp>
+#include <base-logging/Logging.hpp>
+
+namespace ugv_nav4d
+{
+
+constexpr size_t ChromeTraceEvent::maxArgs;
+constexpr const char *ChromeTrace::environmentVariable;
+
+ChromeTrace& ChromeTrace::instance()
+{
+    static ChromeTrace trace;
+    return trace;
+}
+
+ChromeTrace::ChromeTrace() : activeRecordings(0), recording(false), generation(0), sampleCounter(0), sampleInterval(1)
+{
+}
+
+uint64_t ChromeTrace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ChromeTrace::start(bool enable, unsigned interval)
+{
+    const char *envFileName = std::getenv(environmentVariable);
+    if(!enable && !envFileName)
+        return false;
+
+    std::lock_guard<std::mutex> recordingLock(recordingMutex);
+    if(activeRecordings++ > 0)
+        return true;
+
+    {
+        //threads that still hold a buffer of the last recording keep it alive
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.clear();
+    }
+    fileName = envFileName ? envFileName : "";
+    sampleInterval.store(std::max(interval, 1u), std::memory_order_relaxed);
+    sampleCounter.store(0, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_relaxed);
+    recording.store(true, std::memory_order_release);
+    return true;
+}
+
+std::string ChromeTrace::stop()
+{
+    std::lock_guard<std::mutex> recordingLock(recordingMutex);
+    if(activeRecordings == 0 || --activeRecordings > 0)
+        return "";
+    recording.store(false, std::memory_order_relaxed);
+
+    std::string targetFile = fileName;
+    if(targetFile.empty())
+        targetFile = "ugv4d_trace_" + base::Time::now().toString(base::Time::Milliseconds, "%Y-%m-%d_%H%M%S") + ".json";
+
+    std::ofstream output(targetFile, std::ios::out | std::ios::trunc);
+    if(!output)
+    {
+        LOG_ERROR_S << "Cannot write chrome trace to " << targetFile;
+        return "";
+    }
+    write(output);
+    LOG_INFO_S << "Wrote chrome trace to: " << targetFile;
+    return targetFile;
+}
+
+bool ChromeTrace::sample()
+{
+    if(!isRecording())
+        return false;
+    return sampleCounter.fetch_add(1, std::memory_order_relaxed) % sampleInterval.load(std::memory_order_relaxed) == 0;
+}
+
+ChromeTrace::ThreadBuffer& ChromeTrace::getThreadBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> cachedBuffer;
+    thread_local uint64_t cachedGeneration = 0;
+
+    const uint64_t currentGeneration = generation.load(std::memory_order_relaxed);
+    if(!cachedBuffer || cachedGeneration != currentGeneration)
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.push_back(std::make_shared<ThreadBuffer>());
+        buffers.back()->threadId = static_cast<uint32_t>(buffers.size() - 1);
+        cachedBuffer = buffers.back();
+        cachedGeneration = currentGeneration;
+    }
+    return *cachedBuffer;
+}
+
+void ChromeTrace::addSpan(const char* name, const char* category, uint64_t begin, uint64_t end,
+                          std::initializer_list<std::pair<const char*, double>> args)
+{
+    if(!isRecording())
+        return;
+
+    ChromeTraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.begin = begin;
+    event.end = std::max(begin, end);
+    event.numArgs = static_cast<uint32_t>(std::min(args.size(), ChromeTraceEvent::maxArgs));
+    std::copy_n(args.begin(), event.numArgs, event.args.begin());
+
+    ThreadBuffer& buffer(getThreadBuffer());
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(event);
+}
+
+std::vector<ChromeTraceEvent> ChromeTrace::getEvents() const
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    std::vector<ChromeTraceEvent> events;
+    for(const auto& buffer : buffers)
+    {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        events.insert(events.end(), buffer->events.begin(), buffer->events.end());
+    }
+    return events;
+}
+
+/** Names are static strings of this library, only quotes and backslashes need to be escaped */
+static void writeString(std::ostream& out, const char *str)
+{
+    out << '"';
+    for(; *str; ++str)
+    {
+        if(*str == '"' || *str == '\\')
+            out << '\\';
+        out << *str;
+    }
+    out << '"';
+}
+
+void ChromeTrace::write(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock(buffersMutex);
+
+    //threads might still add events, write a consistent copy of every buffer
+    std::vector<std::vector<ChromeTraceEvent>> events;
+    events.reserve(buffers.size());
+    for(const auto& buffer : buffers)
+    {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        events.push_back(buffer->events);
+    }
+
+    //timestamps are written relative to the first event, in microseconds
+    uint64_t origin = std::numeric_limits<uint64_t>::max();
+    for(const std::vector<ChromeTraceEvent>& threadEvents : events)
+        for(const ChromeTraceEvent& event : threadEvents)
+            origin = std::min(origin, event.begin);
+
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for(size_t b = 0; b < buffers.size(); ++b)
+    {
+        const uint32_t threadId = buffers[b]->threadId;
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadId
+            << ",\"args\":{\"name\":\"thread " << threadId << "\"}}";
+        first = false;
+
+        for(const ChromeTraceEvent& event : events[b])
+        {
+            out << ",\n{\"name\":";
+            writeString(out, event.name);
+            out << ",\"cat\":";
+            writeString(out, event.category);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadId
+                << ",\"ts\":" << (event.begin - origin) / 1000.0
+                << ",\"dur\":" << (event.end - event.begin) / 1000.0;
+            if(event.numArgs)
+            {
+                out << ",\"args\":{";
+                for(uint32_t i = 0; i < event.numArgs; ++i)
+                {
+                    if(i)
+                        out << ',';
+                    writeString(out, event.args[i].first);
+                    out << ':' << event.args[i].second;
+                }
+                out << '}';
+            }
+            out << '}';
+        }
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+}
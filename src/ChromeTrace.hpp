@@ -0,0 +1,170 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ugv_nav4d
+{
+
+/** A completed span ("X" event of the chrome trace event format) */
+struct ChromeTraceEvent
+{
+    static constexpr size_t maxArgs = 4;
+
+    /** static strings, only the pointers are stored */
+    const char *name;
+    const char *category;
+    /** nanoseconds of std::chrono::steady_clock */
+    uint64_t begin;
+    uint64_t end;
+    uint32_t numArgs;
+    std::array<std::pair<const char*, double>, maxArgs> args;
+};
+
+/** Records spans of a planning run and writes them as chrome trace event json, which can be
+ *  viewed in chrome://tracing or https://ui.perfetto.dev.
+ *
+ *  Every thread records into its own buffer. The mutex of a buffer is only contended while the
+ *  trace is written, thus recording does not synchronize the threads (except for the first event
+ *  of a thread). Recording is switched on at runtime, either by the planner config or by setting
+ *  the environment variable UGV_NAV4D_CHROME_TRACE to the name of the output file. If no recording
+ *  is active, a span costs one relaxed atomic load.
+ *
+ *  The recorder is process wide. Concurrent recordings (e.g. of several planners) are merged: the
+ *  first start() begins the recording and the last stop() writes the trace. Buffers stay alive
+ *  while a thread holds them, thus threads that record while another thread starts or stops a
+ *  recording never access freed memory.
+ */
+class ChromeTrace
+{
+public:
+    /** Name of the environment variable that enables the recording */
+    static constexpr const char *environmentVariable = "UGV_NAV4D_CHROME_TRACE";
+
+    static ChromeTrace& instance();
+
+    /** Joins the recording if @p enable is true or the environment variable is set. If no recording
+     *  is active, a new one is started and previously recorded events are dropped. Thread-safe.
+     *  @param sampleInterval see sample(), only used when a new recording is started
+     *  @return true if recording. stop() has to be called in that case */
+    bool start(bool enable, unsigned sampleInterval);
+
+    /** Leaves the recording. The last stop() of a recording stops it and writes the trace. The file name
+     *  is taken from the environment variable, if it is not set a new file ugv4d_trace_<date>.json is
+     *  created in the working directory. Thread-safe.
+     *  @return the name of the written file, empty if nothing was written */
+    std::string stop();
+
+    bool isRecording() const
+    {
+        return recording.load(std::memory_order_relaxed);
+    }
+
+    /** Used to trace only a subset of frequent operations (e.g. GetSuccs()).
+     *  @return true for every sampleInterval-th call while recording. Thread-safe */
+    bool sample();
+
+    /** Adds a span of the calling thread. Does nothing if not recording. Thread-safe */
+    void addSpan(const char *name, const char *category, uint64_t begin, uint64_t end,
+                 std::initializer_list<std::pair<const char*, double>> args = {});
+
+    /** Writes the events of the current or last recording as json */
+    void write(std::ostream& out) const;
+
+    /** @return all events of the current or last recording. Thread-safe */
+    std::vector<ChromeTraceEvent> getEvents() const;
+
+    /** @return nanoseconds of std::chrono::steady_clock */
+    static uint64_t now();
+
+private:
+    ChromeTrace();
+    ChromeTrace(const ChromeTrace&) = delete;
+    ChromeTrace& operator=(const ChromeTrace&) = delete;
+
+    struct ThreadBuffer
+    {
+        /** small sequential id, used as tid in the trace */
+        uint32_t threadId;
+        /** locked by the owning thread while adding an event and by readers */
+        std::mutex mutex;
+        std::vector<ChromeTraceEvent> events;
+    };
+
+    /** @return the buffer of the calling thread in the current recording.
+     *  The buffer is owned by the thread until it records into a newer recording */
+    ThreadBuffer& getThreadBuffer();
+
+    /** protects the recording state (activeRecordings and fileName) */
+    std::mutex recordingMutex;
+    /** number of start() calls without stop() */
+    unsigned activeRecordings;
+    std::atomic<bool> recording;
+    /** incremented by every start(), invalidates the buffers that are cached by the threads */
+    std::atomic<uint64_t> generation;
+    std::atomic<uint64_t> sampleCounter;
+    /** written by start(), read by sample() without lock */
+    std::atomic<unsigned> sampleInterval;
+    std::string fileName;
+
+    mutable std::mutex buffersMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+/** Joins the ChromeTrace recording for its lifetime, see ChromeTrace::start() and ChromeTrace::stop().
+ *  Leaves the recording even if an exception is thrown, otherwise it would never be written */
+class ChromeTraceRecording
+{
+public:
+    ChromeTraceRecording(bool enable, unsigned sampleInterval) :
+        active(ChromeTrace::instance().start(enable, sampleInterval))
+    {
+    }
+
+    ~ChromeTraceRecording()
+    {
+        if(active)
+            ChromeTrace::instance().stop();
+    }
+
+    ChromeTraceRecording(const ChromeTraceRecording&) = delete;
+    ChromeTraceRecording& operator=(const ChromeTraceRecording&) = delete;
+
+private:
+    const bool active;
+};
+
+/** Adds a span covering its lifetime to the ChromeTrace, if @p enabled and recording */
+class ChromeTraceSpan
+{
+public:
+    ChromeTraceSpan(const char *name, const char *category, bool enabled = true) :
+        name(name), category(category), active(enabled && ChromeTrace::instance().isRecording()),
+        begin(active ? ChromeTrace::now() : 0)
+    {
+    }
+
+    ~ChromeTraceSpan()
+    {
+        if(active)
+            ChromeTrace::instance().addSpan(name, category, begin, ChromeTrace::now());
+    }
+
+    ChromeTraceSpan(const ChromeTraceSpan&) = delete;
+    ChromeTraceSpan& operator=(const ChromeTraceSpan&) = delete;
+
+private:
+    const char *name;
+    const char *category;
+    const bool active;
+    const uint64_t begin;
+};
+
+}
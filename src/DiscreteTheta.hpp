@@ -1,53 +1,58 @@
 #pragma once
 #include <assert.h>
 #include <math.h>
+#include <stdint.h>
 #include <ostream>
 
+/** A discrete heading in [0, numAngles).
+ *  Stored in 4 bytes, it is part of every Motion (twice) and of every search state.
+ *  Results of operations on two headings are wrapped without a division, if the
+ *  number of angles is a power of two a bitmask is used for all values. */
 class DiscreteTheta
 {
-    int theta;
-    int numAngles;
-    
-    void normalize()
-    {
-        assert(numAngles >= 0);
-        if(theta < 0)
-        {
-            int num = (theta / -numAngles) + 1;
-            theta += numAngles * num;
-        }
+    uint16_t theta;
+    uint16_t numAngles;
 
-        if(theta >= numAngles)
-            theta = theta % numAngles;
+    static constexpr uint16_t normalize(int val, unsigned int numAngles)
+    {
+        assert(numAngles <= UINT16_MAX);
+        const int num = static_cast<int>(numAngles);
+        if(val >= 0 && val < num)
+            return static_cast<uint16_t>(val);
+        //the mask wraps negative values as well
+        if((numAngles & (numAngles - 1)) == 0)
+            return static_cast<uint16_t>(val & (num - 1));
+        //sums and differences of two normalized values
+        if(val >= num && val < 2 * num)
+            return static_cast<uint16_t>(val - num);
+        if(val < 0 && val >= -num)
+            return static_cast<uint16_t>(val + num);
+        return static_cast<uint16_t>((val % num + num) % num);
     }
-    
+
 public:
-    DiscreteTheta(int val, unsigned int numAngles) : theta(val) , numAngles(numAngles) {
-        normalize();
-    }
-    
-    DiscreteTheta(double val, unsigned int numAngles) : numAngles(numAngles) {
-        theta = round((val * numAngles) / (2.0 * M_PI));
-        normalize();
+    constexpr DiscreteTheta(int val, unsigned int numAngles) :
+        theta(normalize(val, numAngles)), numAngles(static_cast<uint16_t>(numAngles))
+    {
     }
-    
-    DiscreteTheta(const DiscreteTheta &o) : theta(o.theta), numAngles(o.numAngles) {
+
+    DiscreteTheta(double val, unsigned int numAngles) :
+        DiscreteTheta(static_cast<int>(round((val * numAngles) / (2.0 * M_PI))), numAngles)
+    {
     }
-    
+
     DiscreteTheta& operator+=(const DiscreteTheta& rhs)
     {
-        theta += rhs.theta;
-        normalize();
+        theta = normalize(theta + rhs.theta, numAngles);
         return *this;
     }
 
     DiscreteTheta& operator-=(const DiscreteTheta& rhs)
     {
-        theta -= rhs.theta;
-        normalize();
+        theta = normalize(theta - rhs.theta, numAngles);
         return *this;
     }
-    
+
     friend DiscreteTheta operator+(DiscreteTheta lhs, const DiscreteTheta& rhs)
     {
         lhs += rhs;
@@ -60,43 +65,36 @@ public:
         return lhs;
     }
 
-    friend bool operator<(const DiscreteTheta& l, const DiscreteTheta& r)
+    friend constexpr bool operator<(const DiscreteTheta& l, const DiscreteTheta& r)
     {
         return l.theta < r.theta;
     }
 
-    friend bool operator==(const DiscreteTheta& l, const DiscreteTheta& r)
+    friend constexpr bool operator==(const DiscreteTheta& l, const DiscreteTheta& r)
     {
         return l.theta == r.theta;
     }
-    
-    int getTheta() const
+
+    constexpr int getTheta() const
     {
         return theta;
     }
-    
+
     double getRadian() const
     {
         return M_PI * 2.0 * theta / static_cast<double>(numAngles);
     }
-    
-    int getNumAngles() const
+
+    constexpr int getNumAngles() const
     {
         return numAngles;
     }
-    
-    DiscreteTheta shortestDist(const DiscreteTheta &ain) const
+
+    constexpr DiscreteTheta shortestDist(const DiscreteTheta &ain) const
     {
-        DiscreteTheta diffA = ain-*this;
-        
-        int a = diffA.theta;
-        int b = numAngles - diffA.theta;
-        
-        
-        if(a < b)
-            return DiscreteTheta(a, numAngles);
-        
-        return DiscreteTheta(b, numAngles);
+        //[0, numAngles)
+        const int diff = normalize(ain.theta - theta, numAngles);
+        return DiscreteTheta(diff < numAngles - diff ? diff : numAngles - diff, numAngles);
     }
 };
 
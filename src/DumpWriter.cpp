@@ -0,0 +1,125 @@
+#include "DumpWriter.hpp"
+#include <algorithm>
+#include <base-logging/Logging.hpp>
+#include <stdexcept>
+
+namespace ugv_nav4d
+{
+
+DumpWriter::DumpWriter(size_t maxQueueSize, DropPolicy dropPolicy, PlannerDump::Compression compression) :
+    maxQueueSize(std::max<size_t>(maxQueueSize, 1)), dropPolicy(dropPolicy), compression(compression),
+    writing(false), stopping(false), numWritten(0), numDropped(0), numFailed(0)
+{
+    thread = std::thread(&DumpWriter::run, this);
+}
+
+DumpWriter::~DumpWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    thread.join();
+}
+
+bool DumpWriter::push(PlannerDump::Snapshot snapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(queue.size() >= maxQueueSize)
+        {
+            ++numDropped;
+            if(dropPolicy == DROP_NEWEST)
+            {
+                LOG_WARN_S << "Dump queue is full, dropping dump " << snapshot.filePostfix;
+                return false;
+            }
+            LOG_WARN_S << "Dump queue is full, dropping dump " << queue.front().filePostfix;
+            queue.pop_front();
+            queue.push_back(std::move(snapshot));
+            queueChanged.notify_all();
+            return false;
+        }
+        queue.push_back(std::move(snapshot));
+    }
+    queueChanged.notify_all();
+    return true;
+}
+
+void DumpWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    queueChanged.wait(lock, [this] { return queue.empty() && !writing; });
+}
+
+uint64_t DumpWriter::getNumWritten() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return numWritten;
+}
+
+uint64_t DumpWriter::getNumDropped() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return numDropped;
+}
+
+uint64_t DumpWriter::getNumFailed() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return numFailed;
+}
+
+std::string DumpWriter::getLastFileName() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastFileName;
+}
+
+void DumpWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true)
+    {
+        queueChanged.wait(lock, [this] { return !queue.empty() || stopping; });
+        //queued dumps are written before stopping
+        if(queue.empty())
+            return;
+
+        PlannerDump::Snapshot snapshot(std::move(queue.front()));
+        queue.pop_front();
+        writing = true;
+        lock.unlock();
+
+        std::string fileName;
+        bool failed = false;
+        try
+        {
+            PlannerDump dump(snapshot, compression);
+            fileName = dump.getFileName();
+        }
+        catch(const std::exception& ex)
+        {
+            LOG_ERROR_S << "Cannot write dump " << snapshot.filePostfix << ": " << ex.what();
+            failed = true;
+        }
+        //release the map before signalling the waiting threads
+        snapshot.mlsMap.reset();
+
+        lock.lock();
+        writing = false;
+        if(failed)
+        {
+            ++numFailed;
+        }
+        else
+        {
+            ++numWritten;
+            lastFileName = fileName;
+        }
+        queueChanged.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "PlannerDump.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ugv_nav4d
+{
+
+/** Writes planner dumps on a background thread.
+ *
+ *  push() only stores the snapshot (configs and a shared pointer to the mls map) in a bounded
+ *  queue, serialization, compression and file i/o happen on the writer thread. If the queue is
+ *  full the snapshot is dropped according to the DropPolicy, thus a slow disk never blocks the
+ *  planning thread and the number of retained maps is limited.
+ */
+class DumpWriter
+{
+public:
+    enum DropPolicy
+    {
+        DROP_NEWEST, /**< keep the queued dumps, discard the pushed one */
+        DROP_OLDEST, /**< discard the oldest queued dump to make room for the pushed one */
+    };
+
+    DumpWriter(size_t maxQueueSize = 2, DropPolicy dropPolicy = DROP_NEWEST,
+               PlannerDump::Compression compression = PlannerDump::getDefaultCompression());
+
+    /** Writes the queued dumps and stops the writer thread */
+    ~DumpWriter();
+
+    DumpWriter(const DumpWriter&) = delete;
+    DumpWriter& operator=(const DumpWriter&) = delete;
+
+    /** Queues @p snapshot for writing. Thread-safe, never blocks on i/o.
+     *  @return false if a dump has been dropped because the queue was full */
+    bool push(PlannerDump::Snapshot snapshot);
+
+    /** Blocks until all queued dumps have been written */
+    void flush();
+
+    uint64_t getNumWritten() const;
+    uint64_t getNumDropped() const;
+    /** number of dumps that could not be written, the error is logged */
+    uint64_t getNumFailed() const;
+
+    /** @return the name of the last written file, empty if none has been written */
+    std::string getLastFileName() const;
+
+private:
+    void run();
+
+    const size_t maxQueueSize;
+    const DropPolicy dropPolicy;
+    const PlannerDump::Compression compression;
+
+    mutable std::mutex mutex;
+    std::condition_variable queueChanged;
+    std::deque<PlannerDump::Snapshot> queue;
+    /** true while the writer thread writes a dump that has been taken from the queue */
+    bool writing;
+    bool stopping;
+    uint64_t numWritten;
+    uint64_t numDropped;
+    uint64_t numFailed;
+    std::string lastFileName;
+
+    std::thread thread;
+};
+
+}
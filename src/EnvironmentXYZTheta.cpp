@@ -8,8 +8,13 @@
 #include <vizkit3d_debug_drawings/DebugDrawingColors.hpp>
 #include "PathStatistic.hpp"
 #include "Dijkstra.hpp"
+#include "Trace.hpp"
+#include "ChromeTrace.hpp"
+#include <algorithm>
 #include <limits>
+#include <map>
 #include <base-logging/Logging.hpp>
+#include <omp.h>
 
 using namespace std;
 using namespace sbpl_spline_primitives;
@@ -33,17 +38,27 @@ EnvironmentXYZTheta::EnvironmentXYZTheta(std::shared_ptr<MLGrid> mlsGrid,
                                          const Mobility& mobilityConfig) :
     travGen(travConf), obsGen(travConf)
     , mlsGrid(mlsGrid)
+    , collectStatistics(false)
     , availableMotions(primitiveConfig, mobilityConfig)
     , startThetaNode(nullptr)
     , startXYZNode(nullptr)
     , goalThetaNode(nullptr)
     , goalXYZNode(nullptr)
     , obstacleStartNode(nullptr)
+    , usePathStatistics(false)
     , travConf(travConf)
     , primitiveConfig(primitiveConfig)
     , mobilityConfig(mobilityConfig)
+    , robotFootprint(travConf)
 {
     numAngles = primitiveConfig.numAngles;
+    for(unsigned int i = 0; i <= numAngles / 2; ++i)
+    {
+        rotationTimes.push_back(DiscreteTheta(static_cast<int>(i), numAngles).getRadian() / mobilityConfig.rotationSpeed);
+    }
+    robotFootprint.precompute(numAngles, footprintSubCellSteps);
+    updateClearanceRange();
+    updateEvaluateMotionKernel();
     travGen.setMLSGrid(mlsGrid);
     obsGen.setMLSGrid(mlsGrid);
     searchGrid.setResolution(Eigen::Vector2d(travConf.gridResolution, travConf.gridResolution));
@@ -52,6 +67,7 @@ EnvironmentXYZTheta::EnvironmentXYZTheta(std::shared_ptr<MLGrid> mlsGrid,
     if(mlsGrid)
     {
         availableMotions.computeMotions(mlsGrid->getResolution().x(), travConf.gridResolution);
+        availableMotions.computeSweptFootprints(robotFootprint);
     }
 }
 
@@ -74,6 +90,10 @@ void EnvironmentXYZTheta::clear()
 
     idToHash.clear();
     travNodeIdToDistance.clear();
+    travNodeIdToObstacleNode.clear();
+    lazyEdgeMotions.clear();
+    clearEdgeCache();
+    statistics = PlannerStatistics();
 
     startThetaNode = nullptr;
     startXYZNode = nullptr;
@@ -109,9 +129,14 @@ void EnvironmentXYZTheta::updateMap(shared_ptr< ugv_nav4d::EnvironmentXYZTheta::
     if(!this->mlsGrid)
     {
         availableMotions.computeMotions(mlsGrid->getResolution().x(), travConf.gridResolution);
+        availableMotions.computeSweptFootprints(robotFootprint);
     }
     travGen.setMLSGrid(mlsGrid);
     obsGen.setMLSGrid(mlsGrid);
+    travGen.clearNodeTables();
+    obsGen.clearNodeTables();
+    obsGen.clearDistanceFields();
+    obsGen.clearHeadingMasks();
     this->mlsGrid = mlsGrid;
 
     clear();
@@ -181,7 +206,7 @@ bool EnvironmentXYZTheta::obstacleCheck(const maps::grid::Vector3d& pos, double
     }
 
     if (usePathStatistics){
-        PathStatistic stats(travConf);
+        PathStatistic stats(travConf, &robotFootprint);
         std::vector<base::Pose2D> poses;
         std::vector<const traversability_generator3d::TravGenNode*> path;
         path.push_back(obstacleNode);
@@ -197,6 +222,8 @@ bool EnvironmentXYZTheta::obstacleCheck(const maps::grid::Vector3d& pos, double
         poses.push_back(base::Pose2D(centeredPos.topRows(2), discTheta.getRadian()));
 
         stats.calculateStatistics(path, poses, obsGen.getTraversabilityMap(), "ugv_nav4d_" + nodeName + "Box");
+        statistics.footprintMaskLookups += stats.getNumMaskLookups();
+        statistics.footprintGeometricChecks += stats.getNumGeometricChecks();
 
         if(stats.getRobotStats().getNumObstacles() || stats.getRobotStats().getNumFrontiers()) 
         {
@@ -282,7 +309,10 @@ void EnvironmentXYZTheta::setGoal(const Eigen::Vector3d& goalPos, double theta)
         throw ObstacleCheckFailed("goal position is invalid");
     }
 
-    precomputeCost();
+    {
+        ScopedTimer timer(collectStatistics, statistics.precomputeCostTime);
+        precomputeCost();
+    }
     LOG_INFO_S << "Heuristic computed";
     //draw greedy path
 #ifdef ENABLE_DEBUG_DRAWINGS
@@ -333,8 +363,59 @@ void EnvironmentXYZTheta::expandMap(const std::vector<Eigen::Vector3d>& position
     });
 #endif
 
-    travGen.expandAll(positions);
-    obsGen.expandAll(positions);
+    //called by every plan(), usually the map has been expanded by a previous call already
+    const bool travExpanded = travGen.expandAllParallel(positions);
+    const bool obsExpanded = obsGen.expandAllParallel(positions);
+    if(obsExpanded)
+    {
+        obsGen.rebuildDistanceFields();
+        obsGen.rebuildHeadingMasks();
+    }
+
+    //the expansion renumbers the nodes and might change the obstacles
+    if(travExpanded || obsExpanded)
+    {
+        travNodeIdToObstacleNode.clear();
+        clearEdgeCache();
+    }
+}
+
+void EnvironmentXYZTheta::saveExpandedMaps(std::ostream& out) const
+{
+    travGen.saveNodes(out);
+    obsGen.saveNodes(out);
+}
+
+void EnvironmentXYZTheta::loadExpandedMaps(std::istream& in)
+{
+    if(!mlsGrid)
+        throw std::runtime_error("EnvironmentXYZTheta::loadExpandedMaps : No mls map has been set");
+
+    //leaves the map unchanged if it throws
+    travGen.loadNodes(in);
+
+    //the search states point to the nodes of the old map
+    clear();
+    obsGen.clearDistanceFields();
+    obsGen.clearHeadingMasks();
+    try
+    {
+        obsGen.loadNodes(in);
+    }
+    catch(const std::runtime_error&)
+    {
+        //do not keep maps that do not fit to each other
+        travGen.clearTrMap();
+        obsGen.clearTrMap();
+        travGen.clearNodeTables();
+        obsGen.clearNodeTables();
+        throw;
+    }
+
+    obsGen.rebuildDistanceFields();
+    obsGen.rebuildHeadingMasks();
+    travNodeIdToObstacleNode.clear();
+    clearEdgeCache();
 }
 
 
@@ -429,6 +510,7 @@ const Motion& EnvironmentXYZTheta::getMotion(const int fromStateID, const int to
 
 int EnvironmentXYZTheta::GetGoalHeuristic(int stateID)
 {
+    ++statistics.heuristicCalls;
 
     // the heuristic distance has been calculated beforehand. Here it is just converted to
     // travel time.
@@ -455,7 +537,7 @@ int EnvironmentXYZTheta::GetGoalHeuristic(int stateID)
     const double timeTranslation = sourceToGoalDist / mobilityConfig.translationSpeed;
 
     //for point turns the translational time is zero, however turning still takes time
-    const double timeRotation = sourceThetaNode->theta.shortestDist(goalThetaNode->theta).getRadian() / mobilityConfig.rotationSpeed;
+    const double timeRotation = rotationTimes[sourceThetaNode->theta.shortestDist(goalThetaNode->theta).getTheta()];
 
     //scale by costScaleFactor to avoid loss of precision before converting to int
     const double maxTime = std::max(timeTranslation, timeRotation);
@@ -464,18 +546,9 @@ int EnvironmentXYZTheta::GetGoalHeuristic(int stateID)
     int result = maxTime >= 10000000 ? maxTime : maxTime * Motion::costScaleFactor;
     if(result < 0)
     {
-        LOG_INFO_S << sourceToGoalDist;
-        LOG_INFO_S << stateID;
-        LOG_INFO_S << mobilityConfig.translationSpeed;
-        LOG_INFO_S << timeTranslation;
-        LOG_INFO_S << sourceThetaNode->theta.shortestDist(goalThetaNode->theta).getRadian();
-        LOG_INFO_S << mobilityConfig.rotationSpeed;
-        LOG_INFO_S << timeRotation;
-        LOG_INFO_S << result;
-        LOG_INFO_S << travNode->getUserData().id;
-        LOG_INFO_S << travNode->getType();
         //throw std::runtime_error("Goal heuristic < 0");
-        LOG_INFO_S<< "Overflow while computing goal heuristic!";
+        UGV_NAV4D_TRACE(WARN, "Overflow while computing goal heuristic (stateID, sourceToGoalDist, timeTranslation, timeRotation, travNodeId, travNodeType)",
+                        {double(stateID), sourceToGoalDist, timeTranslation, timeRotation, double(travNode->getUserData().id), double(travNode->getType())});
         result = std::numeric_limits<int>::max();
     }
     oassert(result >= 0);
@@ -483,7 +556,10 @@ int EnvironmentXYZTheta::GetGoalHeuristic(int stateID)
 }
 
 void EnvironmentXYZTheta::enablePathStatistics(bool enable){
+    if(enable != usePathStatistics)
+        clearEdgeCache();
     usePathStatistics = enable;
+    updateEvaluateMotionKernel();
 }
 
 int EnvironmentXYZTheta::GetStartHeuristic(int stateID)
@@ -495,7 +571,7 @@ int EnvironmentXYZTheta::GetStartHeuristic(int stateID)
 
     const double startToTargetDist = travNodeIdToDistance[travNode->getUserData().id].distToStart;
     const double timeTranslation = startToTargetDist / mobilityConfig.translationSpeed;
-    double timeRotation = startThetaNode->theta.shortestDist(targetThetaNode->theta).getRadian() / mobilityConfig.rotationSpeed;
+    double timeRotation = rotationTimes[startThetaNode->theta.shortestDist(targetThetaNode->theta).getTheta()];
 
     const int result = floor(std::max(timeTranslation, timeRotation) * Motion::costScaleFactor);
     oassert(result >= 0);
@@ -540,22 +616,23 @@ EnvironmentXYZTheta::ThetaNode *EnvironmentXYZTheta::createNewState(const Discre
     return newNode;
 }
 
-traversability_generator3d::TravGenNode *EnvironmentXYZTheta::movementPossible(traversability_generator3d::TravGenNode *fromTravNode, const maps::grid::Index &fromIdx, const maps::grid::Index &toIdx)
+traversability_generator3d::TravGenNode *EnvironmentXYZTheta::movementPossible(TravMapGenerator3D& generator, traversability_generator3d::TravGenNode *fromTravNode, const maps::grid::Index &fromIdx, const maps::grid::Index &toIdx)
 {
     if(toIdx == fromIdx)
         return fromTravNode;
 
     //get trav node associated with the next index
-    traversability_generator3d::TravGenNode *targetNode = fromTravNode->getConnectedNode(toIdx);
+    traversability_generator3d::TravGenNode *targetNode = generator.getConnectedNeighbor(fromTravNode, toIdx);
     if(!targetNode)
     {
         //FIXME this should never happen but it did happen in the past and I have no idea why
         //      needs investigation!
-        LOG_INFO_S<< "movement not possible. nodes not conncted";
+        UGV_NAV4D_TRACE(WARN, "movement not possible. nodes not connected (fromX, fromY, toX, toY)",
+                        {double(fromIdx.x()), double(fromIdx.y()), double(toIdx.x()), double(toIdx.y())});
         return nullptr;
     }
 
-    if(!checkExpandTreadSafe(targetNode))
+    if(!checkExpandTreadSafe(generator, targetNode))
     {
         return nullptr;
     }
@@ -570,22 +647,9 @@ traversability_generator3d::TravGenNode *EnvironmentXYZTheta::movementPossible(t
     return targetNode;
 }
 
-bool EnvironmentXYZTheta::checkExpandTreadSafe(traversability_generator3d::TravGenNode * node)
+bool EnvironmentXYZTheta::checkExpandTreadSafe(TravMapGenerator3D& generator, traversability_generator3d::TravGenNode * node)
 {
-    if(node->isExpanded())
-    {
-        return true;
-    }
-
-    bool result = true;
-    #pragma omp critical(checkExpandTreadSafe)
-    {
-        if(!node->isExpanded())
-        {
-            result = travGen.expandNode(node);
-        }
-    }
-    return result;
+    return generator.expandNodeThreadSafe(node);
 }
 
 
@@ -606,7 +670,7 @@ traversability_generator3d::TravGenNode * EnvironmentXYZTheta::checkTraversableH
     {
         //diff is always a full offset to the start position
         const maps::grid::Index newIndex =  sourceIndex + diff.cell;
-        travNode = movementPossible(travNode, curIndex, newIndex);
+        travNode = movementPossible(travGen, travNode, curIndex, newIndex);
         if(!travNode)
         {
             return nullptr;
@@ -618,8 +682,91 @@ traversability_generator3d::TravGenNode * EnvironmentXYZTheta::checkTraversableH
     return travNode;
 }
 
+void EnvironmentXYZTheta::findGoalTravNodes(const XYZNode *sourceNode, const DiscreteTheta &theta,
+                                            std::vector<traversability_generator3d::TravGenNode*> &goalTravNodes, bool trace)
+{
+    ChromeTraceSpan span("findGoalTravNodes", "expand", trace);
+    const std::vector<MotionTrieNode> &trie(availableMotions.getMotionTrieForStartTheta(theta));
+    const maps::grid::Index sourceIndex = sourceNode->getIndex();
+    traversability_generator3d::TravGenNode *sourceTravNode = sourceNode->getUserData().travNode;
+
+    goalTravNodes.assign(availableMotions.getMotionForStartTheta(theta).size(), nullptr);
+    for(size_t motion : trie.front().motions)
+    {
+        goalTravNodes[motion] = sourceTravNode;
+    }
+
+    //trav nodes of the trie nodes, nullptr if the node is not traversable or was not reached.
+    //Every thread only writes the entries of its own subtree
+    std::vector<traversability_generator3d::TravGenNode*> travNodes(trie.size(), nullptr);
+    travNodes[0] = sourceTravNode;
+
+    //checks trie node i, its parent has to be traversable
+    auto checkTrieNode = [&](size_t i)
+    {
+        const MotionTrieNode &node(trie[i]);
+        const size_t parent = static_cast<size_t>(node.parent);
+        traversability_generator3d::TravGenNode *travNode = movementPossible(travGen, travNodes[parent], sourceIndex + trie[parent].cell, sourceIndex + node.cell);
+        if(travNode)
+        {
+            travNodes[i] = travNode;
+            for(size_t motion : node.motions)
+            {
+                goalTravNodes[motion] = travNode;
+            }
+        }
+        return travNode != nullptr;
+    };
+
+    //The start cell has at most 8 neighbors and most motions of one start theta leave it through
+    //only a few of them. The upper levels are therefore checked one by one until there are enough
+    //independent subtrees to keep all threads busy
+    const size_t minSubtrees = 4 * omp_get_max_threads();
+    std::vector<size_t> subtrees;
+    for(size_t i = 1; i < trie.size(); i = trie[i].subtreeEnd)
+    {
+        subtrees.push_back(i);
+    }
+    std::vector<size_t> nextLevel;
+    while(!subtrees.empty() && subtrees.size() < minSubtrees)
+    {
+        nextLevel.clear();
+        for(size_t s : subtrees)
+        {
+            if(!checkTrieNode(s))
+            {
+                //no motion below this node is traversable
+                continue;
+            }
+            for(size_t i = s + 1; i < trie[s].subtreeEnd; i = trie[i].subtreeEnd)
+            {
+                nextLevel.push_back(i);
+            }
+        }
+        subtrees.swap(nextLevel);
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t s = 0; s < subtrees.size(); ++s)
+    {
+        ChromeTraceSpan subtreeSpan("trie subtree", "expand", trace);
+        const size_t end = trie[subtrees[s]].subtreeEnd;
+        size_t i = subtrees[s];
+        while(i < end)
+        {
+            //no motion below a node that is not traversable is traversable
+            i = checkTrieNode(i) ? i + 1 : trie[i].subtreeEnd;
+        }
+    }
+}
+
 void EnvironmentXYZTheta::GetSuccs(int SourceStateID, vector< int >* SuccIDV, vector< int >* CostV, vector< size_t >& motionIdV)
 {
+    ScopedTimer timer(collectStatistics, statistics.getSuccsTime);
+    //only a subset of the expansions is recorded to keep the trace small
+    const bool traceSample = ChromeTrace::instance().sample();
+    ChromeTraceSpan span("GetSuccs", "expand", traceSample);
+    ++statistics.getSuccsCalls;
     SuccIDV->clear();
     CostV->clear();
     motionIdV.clear();
@@ -647,234 +794,445 @@ void EnvironmentXYZTheta::GetSuccs(int SourceStateID, vector< int >* SuccIDV, ve
         if(!travGen.expandNode(sourceTravNode))
         {
             //expansion failed, current node is not driveable -> there are not successors to this state
-            LOG_INFO_S<< "GetSuccs: current node not expanded and not expandable";
+            UGV_NAV4D_TRACE(INFO, "GetSuccs: current node not expanded and not expandable (stateID)", {double(SourceStateID)});
             return;
         }
     }
 
-    Eigen::Vector3d sourcePosWorld;
-    travGen.getTraversabilityMap().fromGrid(sourceNode->getIndex(), sourcePosWorld, sourceTravNode->getHeight(), false);
-
-    traversability_generator3d::TravGenNode *sourceObstacleNode = findObstacleNode(sourceTravNode);
+    traversability_generator3d::TravGenNode *sourceObstacleNode = getObstacleNode(sourceTravNode);
     assert(sourceObstacleNode);
 
-    const auto& motions = availableMotions.getMotionForStartTheta(sourceThetaNode->theta);
+    const MotionRange motions = availableMotions.getMotionForStartTheta(sourceThetaNode->theta);
+
+    travGen.beginConcurrentExpansion();
+    obsGen.beginConcurrentExpansion();
+
+    //later ARA* iterations and getMotion() expand the same states again
+    std::vector<EdgeCacheEntry> &cachedEdges(getCachedEdges(SourceStateID, motions.size()));
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t notTraversable = 0;
+    size_t obstacleMap = 0;
+    size_t inclineLimit = 0;
+    size_t collision = 0;
+
+    std::vector<traversability_generator3d::TravGenNode*> goalTravNodes;
+    if(std::any_of(cachedEdges.begin(), cachedEdges.end(), [](const EdgeCacheEntry &e) { return !e.known; }))
+    {
+        //check that the motions are traversable (without collision checks) and find their goal nodes
+        findGoalTravNodes(sourceNode, sourceThetaNode->theta, goalTravNodes, traceSample);
+    }
 
     //dynamic scheduling is choosen because the iterations have vastly different runtime
     //due to the different sanity checks
     //the chunk size (5) was chosen to reduce dynamic scheduling overhead.
     //**No** tests have been done to verify whether 5 is a good value or not!
     //#pragma omp parallel for schedule(dynamic, 5)
-    #pragma omp parallel for schedule(auto)
+    #pragma omp parallel for schedule(auto) reduction(+:hits, misses, notTraversable, obstacleMap, inclineLimit, collision)
     for(size_t i = 0; i < motions.size(); ++i)
     {
-        //check that the motion is traversable (without collision checks) and find the goal node of the motion
         const ugv_nav4d::Motion &motion(motions[i]);
-        traversability_generator3d::TravGenNode *goalTravNode = checkTraversableHeuristic(sourceNode->getIndex(), sourceNode->getUserData().travNode, motions[i], travGen.getTraversabilityMap());
-        if(!goalTravNode)
+
+        //every thread only touches its own entry
+        EdgeCacheEntry &edge(cachedEdges[i]);
+        if(edge.known)
         {
-            //at least one node on the path is not traversable
-            continue;
+            ++hits;
         }
-
-        //check motion path on obstacle map
-        std::vector<const traversability_generator3d::TravGenNode*> nodesOnObstPath;
-        std::vector<base::Pose2D> posesOnObstPath;
-        maps::grid::Index curObstIdx = sourceObstacleNode->getIndex();
-        traversability_generator3d::TravGenNode *obstNode = sourceObstacleNode;
-        bool intermediateStepsOk = true;
-        for(const PoseWithCell &diff : motion.intermediateStepsObstMap)
+        else
         {
-            //diff is always a full offset to the start position
-            const maps::grid::Index newIndex =  sourceObstacleNode->getIndex() + diff.cell;
-            obstNode = movementPossible(obstNode, curObstIdx, newIndex);
-            nodesOnObstPath.push_back(obstNode);
-            base::Pose2D curPose = diff.pose;
-            curPose.position += sourcePosWorld.head<2>();
-            posesOnObstPath.push_back(curPose);
-            if(!obstNode)
+            ++misses;
+            ChromeTraceSpan edgeSpan("evaluateEdge", "expand", traceSample);
+            edge = evaluateEdge(sourceNode, sourceObstacleNode, motion, goalTravNodes[i]);
+            switch(edge.cost)
             {
-                intermediateStepsOk = false;
-                break;
+                case REJECTED_NOT_TRAVERSABLE: ++notTraversable; break;
+                case REJECTED_OBSTACLE_MAP: ++obstacleMap; break;
+                case REJECTED_INCLINE_LIMIT: ++inclineLimit; break;
+                case REJECTED_COLLISION: ++collision; break;
+                default: break;
             }
+        }
+
+        if(edge.cost < 0)
+            continue;
 
-            if(travConf.enableInclineLimitting)
+        //includes the time waiting for the lock
+        ChromeTraceSpan lockSpan("critical(updateData)", "lock", traceSample);
+        #pragma omp critical(updateData)
+        {
+            SuccIDV->push_back(edge.targetStateID);
+            CostV->push_back(edge.cost);
+            motionIdV.push_back(motion.id);
+
+            //####BEGIN DEBUG BLOCK!
             {
-                if(!checkOrientationAllowed(obstNode, diff.pose.orientation))
+                const Hash &sourceHashh(idToHash[edge.targetStateID]);
+                const XYZNode *sourceNodeh = sourceHashh.node;
+                const traversability_generator3d::TravGenNode* travNodeh = sourceNodeh->getUserData().travNode;
+
+                if(travNodeh->getType() != maps::grid::TraversabilityNodeBase::TRAVERSABLE)
                 {
-                    intermediateStepsOk = false;
-                    break;
+                    throw std::runtime_error("In GetSuccs() returned id for non-traversable patch");
                 }
             }
-            curObstIdx = newIndex;
+            //####END DEBUG BLOCK!!!
         }
+    }
+    travGen.endConcurrentExpansion();
+    obsGen.endConcurrentExpansion();
+    //obstacles that have been found during lazy expansion
+    obsGen.updateDistanceFields();
+    obsGen.updateHeadingMasks();
+    statistics.edgeCacheHits += hits;
+    statistics.edgeCacheMisses += misses;
+    statistics.rejectedNotTraversable += notTraversable;
+    statistics.rejectedObstacleMap += obstacleMap;
+    statistics.rejectedInclineLimit += inclineLimit;
+    statistics.rejectedCollision += collision;
+    statistics.successorsGenerated += SuccIDV->size();
+}
 
-        //no way from start to end on obstacle map
-        if(!intermediateStepsOk)
-            continue;
+EnvironmentXYZTheta::EdgeCacheEntry EnvironmentXYZTheta::evaluateEdge(const XYZNode *sourceNode, traversability_generator3d::TravGenNode *sourceObstacleNode,
+                                                                      const Motion &motion, traversability_generator3d::TravGenNode *goalTravNode)
+{
+    EdgeCacheEntry edge;
+    edge.known = true;
 
-        if (usePathStatistics){
-            PathStatistic statistic(travConf);
+    if(!goalTravNode)
+    {
+        //at least one node on the path is not traversable
+        return edge;
+    }
 
-            if(!statistic.isPathFeasible(nodesOnObstPath, posesOnObstPath, getObstacleMap()))
-            {
-                continue;
-            }
-        }
+    edge.cost = evaluateMotion(sourceNode, sourceObstacleNode, motion, goalTravNode);
+    if(edge.cost < 0)
+        return edge;
 
-        //goal from source to the end of the motion was valid
-        XYZNode *successXYNode = nullptr;
-        ThetaNode *successthetaNode = nullptr;
+    //goal from source to the end of the motion was valid
+    edge.targetStateID = getSuccessorState(sourceNode, goalTravNode, motion)->id;
+    return edge;
+}
 
-        //WARNING This becomes a critical section if several motion primitives
-        //        share the same finalPos.
-        //        As long as this is not the case this section should be save.
-        const maps::grid::Index finalPos(sourceNode->getIndex() + maps::grid::Index(motion.xDiff,motion.yDiff));
+void EnvironmentXYZTheta::GetLazySuccs(int SourceStateID, vector< int >* SuccIDV, vector< int >* CostV, vector< bool >* isTrueCost)
+{
+    ScopedTimer timer(collectStatistics, statistics.getSuccsTime);
+    const bool traceSample = ChromeTrace::instance().sample();
+    ChromeTraceSpan span("GetLazySuccs", "expand", traceSample);
+    ++statistics.getSuccsCalls;
+    SuccIDV->clear();
+    CostV->clear();
+    isTrueCost->clear();
+    const Hash &sourceHash(idToHash[SourceStateID]);
+    const XYZNode *const sourceNode = sourceHash.node;
+    const ThetaNode *const sourceThetaNode = sourceHash.thetaNode;
+    traversability_generator3d::TravGenNode *sourceTravNode = sourceNode->getUserData().travNode;
 
-        #pragma omp critical(searchGridAccess)
+    if(!sourceTravNode->isExpanded())
+    {
+        if(!travGen.expandNode(sourceTravNode))
         {
-            const auto &candidateMap = searchGrid.at(finalPos);
+            UGV_NAV4D_TRACE(INFO, "GetLazySuccs: current node not expanded and not expandable (stateID)", {double(SourceStateID)});
+            return;
+        }
+    }
 
-            if(goalTravNode->getIndex() != finalPos)
-                throw std::runtime_error("Internal error, indexes do not match");
+    const MotionRange motions = availableMotions.getMotionForStartTheta(sourceThetaNode->theta);
 
-            XYZNode searchTmp(goalTravNode->getHeight(), goalTravNode->getIndex());
+    //successor state id -> (optimistic cost, motions that lead to the successor)
+    std::map<int, std::pair<int, std::vector<size_t>>> successors;
 
-            //this works, as the equals check is on the height, not the node itself
-            auto it = candidateMap.find(&searchTmp);
+    travGen.beginConcurrentExpansion();
 
-            if(it != candidateMap.end())
+    //only the cheap check on the traversability map, the obstacle map is checked in GetTrueCost()
+    std::vector<traversability_generator3d::TravGenNode*> goalTravNodes;
+    findGoalTravNodes(sourceNode, sourceThetaNode->theta, goalTravNodes, traceSample);
+
+    #pragma omp parallel for schedule(auto)
+    for(size_t i = 0; i < motions.size(); ++i)
+    {
+        const ugv_nav4d::Motion &motion(motions[i]);
+        traversability_generator3d::TravGenNode *goalTravNode = goalTravNodes[i];
+        if(!goalTravNode)
+            continue;
+
+        ThetaNode *successthetaNode = getSuccessorState(sourceNode, goalTravNode, motion);
+
+        #pragma omp critical(updateData)
+        {
+            auto it = successors.find(successthetaNode->id);
+            if(it == successors.end())
             {
-                //found a node with a matching height
-                successXYNode = *it;
+                successors[successthetaNode->id] = std::make_pair(motion.baseCost, std::vector<size_t>(1, motion.id));
             }
             else
             {
-                successXYNode = createNewXYZState(goalTravNode); //modifies searchGrid at travNode->getIndex()
+                it->second.first = std::min(it->second.first, motion.baseCost);
+                it->second.second.push_back(motion.id);
             }
         }
+    }
+    travGen.endConcurrentExpansion();
+
+    for(const auto &successor : successors)
+    {
+        SuccIDV->push_back(successor.first);
+        //evaluateMotion() only adds to the base cost, thus the base cost is a lower bound of the true cost
+        CostV->push_back(successor.second.first);
+        isTrueCost->push_back(false);
+        lazyEdgeMotions[getEdgeKey(SourceStateID, successor.first)] = successor.second.second;
+    }
+    statistics.rejectedNotTraversable += std::count(goalTravNodes.begin(), goalTravNodes.end(), nullptr);
+    statistics.successorsGenerated += SuccIDV->size();
+}
+
+int EnvironmentXYZTheta::GetTrueCost(int parentID, int childID)
+{
+    ScopedTimer timer(collectStatistics, statistics.getSuccsTime);
+    ChromeTraceSpan span("GetTrueCost", "expand", ChromeTrace::instance().sample());
+    ++statistics.getTrueCostCalls;
+    const auto edge = lazyEdgeMotions.find(getEdgeKey(parentID, childID));
+    if(edge == lazyEdgeMotions.end())
+        throw std::runtime_error("EnvironmentXYZTheta::GetTrueCost: Requested cost of an edge that has not been generated by GetLazySuccs()");
+
+    const Hash &sourceHash(idToHash[parentID]);
+    const XYZNode *const sourceNode = sourceHash.node;
+    traversability_generator3d::TravGenNode *sourceTravNode = sourceNode->getUserData().travNode;
+    traversability_generator3d::TravGenNode *sourceObstacleNode = getObstacleNode(sourceTravNode);
+    assert(sourceObstacleNode);
+
+    const MotionRange motions = availableMotions.getMotionForStartTheta(sourceHash.thetaNode->theta);
+    std::vector<EdgeCacheEntry> &cachedEdges(getCachedEdges(parentID, motions.size()));
 
-        #pragma omp critical(thetaToNodesAccess)
+    travGen.beginConcurrentExpansion();
+    obsGen.beginConcurrentExpansion();
+
+    int bestCost = -1;
+    for(size_t i = 0; i < motions.size(); ++i)
+    {
+        if(std::find(edge->second.begin(), edge->second.end(), motions[i].id) == edge->second.end())
+            continue;
+
+        EdgeCacheEntry &cachedEdge(cachedEdges[i]);
+        if(cachedEdge.known)
         {
-            const auto &thetaMap(successXYNode->getUserData().thetaToNodes);
+            ++statistics.edgeCacheHits;
+        }
+        else
+        {
+            ++statistics.edgeCacheMisses;
+            traversability_generator3d::TravGenNode *goalTravNode = checkTraversableHeuristic(sourceNode->getIndex(), sourceTravNode, motions[i], travGen.getTraversabilityMap());
+            cachedEdge = evaluateEdge(sourceNode, sourceObstacleNode, motions[i], goalTravNode);
+            countRejection(cachedEdge.cost);
+        }
 
-            auto thetaCandidate = thetaMap.find(motion.endTheta);
-            if(thetaCandidate != thetaMap.end())
-            {
-                successthetaNode = thetaCandidate->second;
-            }
-            else
-            {
-                successthetaNode = createNewState(motion.endTheta, successXYNode);
-            }
+        if(cachedEdge.cost >= 0 && (bestCost < 0 || cachedEdge.cost < bestCost))
+            bestCost = cachedEdge.cost;
+    }
+
+    travGen.endConcurrentExpansion();
+    obsGen.endConcurrentExpansion();
+    obsGen.updateDistanceFields();
+    obsGen.updateHeadingMasks();
+
+    //negative cost marks the edge as invalid
+    return bestCost;
+}
+
+template<traversability_generator3d::SlopeMetric slopeMetric, bool pathStatistics, bool inclineLimitting>
+int EnvironmentXYZTheta::evaluateMotionImpl(const XYZNode *sourceNode, traversability_generator3d::TravGenNode *sourceObstacleNode,
+                                            const Motion &motion, const traversability_generator3d::TravGenNode *goalTravNode)
+{
+    const traversability_generator3d::TravGenNode *sourceTravNode = sourceNode->getUserData().travNode;
+
+    //check motion path on obstacle map.
+    //The nodes are only needed for the path statistics, the slope is accumulated during the walk
+    std::vector<const traversability_generator3d::TravGenNode*> nodesOnObstPath;
+    if(pathStatistics)
+        nodesOnObstPath.reserve(motion.intermediateStepsObstMap.size());
+    double slopeSum = 0;
+    double maxSlope = 0;
+
+    maps::grid::Index curObstIdx = sourceObstacleNode->getIndex();
+    traversability_generator3d::TravGenNode *obstNode = sourceObstacleNode;
+    //same as motion.intermediateStepsObstMap, but the steps of all motions are stored in one array
+    for(const MotionStep &diff : availableMotions.getObstacleSteps(motion.id))
+    {
+        //diff is always a full offset to the start position
+        const maps::grid::Index newIndex =  sourceObstacleNode->getIndex() + diff.cell;
+        obstNode = movementPossible(obsGen, obstNode, curObstIdx, newIndex);
+
+        //no way from start to end on obstacle map
+        if(!obstNode)
+            return REJECTED_OBSTACLE_MAP;
+
+        if(inclineLimitting && !obsGen.isHeadingAllowed(obstNode, diff.orientation))
+            return REJECTED_INCLINE_LIMIT;
+
+        if(pathStatistics)
+            nodesOnObstPath.push_back(obstNode);
+        if(slopeMetric == traversability_generator3d::SlopeMetric::AVG_SLOPE)
+            slopeSum += obstNode->getUserData().slope;
+        if(slopeMetric == traversability_generator3d::SlopeMetric::MAX_SLOPE)
+            maxSlope = std::max(maxSlope, obstNode->getUserData().slope);
+
+        curObstIdx = newIndex;
+    }
+
+    //one pass over all cells that are swept by the robot instead of checking every pose separately.
+    //Not needed at all if the distance fields show that nothing is close to the motion
+    if (pathStatistics && !isOutsideClearanceRange(nodesOnObstPath)){
+        PathStatistic statistic(travConf, &robotFootprint);
+        if(!statistic.calculateSweptStatistics(motion.sweptFootprint, nodesOnObstPath, sourceObstacleNode->getIndex()))
+        {
+            return REJECTED_COLLISION;
         }
+    }
 
-        double cost = 0;
-        switch(travConf.slopeMetric)
+    double cost = 0;
+    switch(slopeMetric)
+    {
+        case traversability_generator3d::SlopeMetric::AVG_SLOPE:
         {
-            case traversability_generator3d::SlopeMetric::AVG_SLOPE:
+            double avgSlope = 0;
+            if(motion.intermediateStepsObstMap.size() > 0)
             {
-                double avgSlope = 0;
-                if(nodesOnObstPath.size() > 0)
-                {
-                    avgSlope = getAvgSlope(nodesOnObstPath);
-                }
-                else
-                {
-                    //This happens on point turns as they have no intermediate steps
-                    avgSlope = sourceTravNode->getUserData().slope;
-                }
-                const double slopeFactor = avgSlope * travConf.slopeMetricScale;
-                cost = motion.baseCost + motion.baseCost * slopeFactor;
-                LOG_INFO_S<< "cost: " << cost << ", baseCost: " << motion.baseCost << ", slopeFactor: " << slopeFactor;
-                break;
+                avgSlope = slopeSum / motion.intermediateStepsObstMap.size();
             }
-            case traversability_generator3d::SlopeMetric::MAX_SLOPE:
+            else
             {
-                double maxSlope = 0;
-                if(nodesOnObstPath.size() > 0)
-                {
-                    maxSlope = getMaxSlope(nodesOnObstPath);
-                }
-                else
-                {
-                    //This happens on point turns as they have no intermediate steps
-                    maxSlope = sourceTravNode->getUserData().slope;
-                }
-                const double slopeFactor = maxSlope * travConf.slopeMetricScale;
-                cost = motion.baseCost + motion.baseCost * slopeFactor;
-                break;
+                //This happens on point turns as they have no intermediate steps
+                avgSlope = sourceTravNode->getUserData().slope;
             }
-            case traversability_generator3d::SlopeMetric::TRIANGLE_SLOPE:
+            const double slopeFactor = avgSlope * travConf.slopeMetricScale;
+            cost = motion.baseCost + motion.baseCost * slopeFactor;
+            UGV_NAV4D_TRACE(DEBUG, "motion cost (cost, baseCost, slopeFactor)", {cost, double(motion.baseCost), slopeFactor});
+            break;
+        }
+        case traversability_generator3d::SlopeMetric::MAX_SLOPE:
+        {
+            if(motion.intermediateStepsObstMap.empty())
             {
-                //assume that the motion is a straight line, extrapolate into third dimension
-                //by projecting onto a plane that connects start and end cell.
-                const double heightDiff = std::abs(sourceNode->getHeight() - successXYNode->getHeight());
-                //not perfect but probably more exact than the slope factors above
-                const double approxMotionLen3D = std::sqrt(std::pow(motion.translationlDist, 2) + std::pow(heightDiff, 2));
-                assert(approxMotionLen3D >= motion.translationlDist);//due to triangle inequality
-                const double translationalVelocity = mobilityConfig.translationSpeed;
-                cost = Motion::calculateCost(approxMotionLen3D, motion.angularDist, translationalVelocity,
-                                             mobilityConfig.rotationSpeed, motion.costMultiplier);
-                break;
+                //This happens on point turns as they have no intermediate steps
+                maxSlope = sourceTravNode->getUserData().slope;
             }
-            case traversability_generator3d::SlopeMetric::NONE:
-                cost = motion.baseCost;
-                break;
-            default:
-                throw std::runtime_error("unknown slope metric selected");
+            const double slopeFactor = maxSlope * travConf.slopeMetricScale;
+            cost = motion.baseCost + motion.baseCost * slopeFactor;
+            break;
+        }
+        case traversability_generator3d::SlopeMetric::TRIANGLE_SLOPE:
+        {
+            //assume that the motion is a straight line, extrapolate into third dimension
+            //by projecting onto a plane that connects start and end cell.
+            const double heightDiff = std::abs(sourceNode->getHeight() - goalTravNode->getHeight());
+            //not perfect but probably more exact than the slope factors above
+            const double approxMotionLen3D = std::sqrt(std::pow(motion.translationlDist, 2) + std::pow(heightDiff, 2));
+            assert(approxMotionLen3D >= motion.translationlDist);//due to triangle inequality
+            const double translationalVelocity = mobilityConfig.translationSpeed;
+            cost = Motion::calculateCost(approxMotionLen3D, motion.angularDist, translationalVelocity,
+                                         mobilityConfig.rotationSpeed, motion.costMultiplier);
+            break;
         }
+        default:
+            cost = motion.baseCost;
+            break;
+    }
 
-        if (usePathStatistics){
-            PathStatistic statistic(travConf);
-            if(statistic.getBoundaryStats().getNumObstacles())
-            {
-                const double outer_radius = travConf.costFunctionDist;
-                double minDistToRobot = statistic.getBoundaryStats().getMinDistToObstacles();
-                minDistToRobot = std::min(outer_radius, minDistToRobot);
-                double impactFactor = (outer_radius - minDistToRobot) / outer_radius;
-                oassert(impactFactor < 1.001 && impactFactor >= 0);
+    //NOTE the boundary statistics are not used for the cost. The clearance cost that has been
+    //     computed here was always based on an empty PathStatistic and thus never changed the cost.
 
-                cost += cost * impactFactor;
-            }
+    oassert(cost <= std::numeric_limits<int>::max() && cost >= std::numeric_limits< int >::min());
+    oassert(int(cost) >= motion.baseCost);
+    oassert(motion.baseCost > 0);
 
-            if(statistic.getBoundaryStats().getNumFrontiers())
-            {
-                const double outer_radius = travConf.costFunctionDist;
-                double minDistToRobot = statistic.getBoundaryStats().getMinDistToFrontiers();
-                minDistToRobot = std::min(outer_radius, minDistToRobot);
-                double impactFactor = (outer_radius - minDistToRobot) / outer_radius;
-                oassert(impactFactor < 1.001 && impactFactor >= 0);
+    return (int)cost;
+}
 
-                cost += cost * impactFactor;
-            }
-        }
+template<traversability_generator3d::SlopeMetric slopeMetric>
+EnvironmentXYZTheta::EvaluateMotionKernel EnvironmentXYZTheta::selectEvaluateMotionKernel() const
+{
+    if(usePathStatistics)
+    {
+        if(travConf.enableInclineLimitting)
+            return &EnvironmentXYZTheta::evaluateMotionImpl<slopeMetric, true, true>;
+        return &EnvironmentXYZTheta::evaluateMotionImpl<slopeMetric, true, false>;
+    }
+    if(travConf.enableInclineLimitting)
+        return &EnvironmentXYZTheta::evaluateMotionImpl<slopeMetric, false, true>;
+    return &EnvironmentXYZTheta::evaluateMotionImpl<slopeMetric, false, false>;
+}
 
-        oassert(cost <= std::numeric_limits<int>::max() && cost >= std::numeric_limits< int >::min());
-        oassert(int(cost) >= motion.baseCost);
-        oassert(motion.baseCost > 0);
+void EnvironmentXYZTheta::updateEvaluateMotionKernel()
+{
+    switch(travConf.slopeMetric)
+    {
+        case traversability_generator3d::SlopeMetric::AVG_SLOPE:
+            evaluateMotionKernel = selectEvaluateMotionKernel<traversability_generator3d::SlopeMetric::AVG_SLOPE>();
+            break;
+        case traversability_generator3d::SlopeMetric::MAX_SLOPE:
+            evaluateMotionKernel = selectEvaluateMotionKernel<traversability_generator3d::SlopeMetric::MAX_SLOPE>();
+            break;
+        case traversability_generator3d::SlopeMetric::TRIANGLE_SLOPE:
+            evaluateMotionKernel = selectEvaluateMotionKernel<traversability_generator3d::SlopeMetric::TRIANGLE_SLOPE>();
+            break;
+        case traversability_generator3d::SlopeMetric::NONE:
+            evaluateMotionKernel = selectEvaluateMotionKernel<traversability_generator3d::SlopeMetric::NONE>();
+            break;
+        default:
+            throw std::runtime_error("unknown slope metric selected");
+    }
+}
 
-        const int iCost = (int)cost;
-        #pragma omp critical(updateData)
+EnvironmentXYZTheta::ThetaNode* EnvironmentXYZTheta::getSuccessorState(const XYZNode *sourceNode, traversability_generator3d::TravGenNode *goalTravNode,
+                                                                       const Motion &motion)
+{
+    XYZNode *successXYNode = nullptr;
+    ThetaNode *successthetaNode = nullptr;
+
+    //WARNING This becomes a critical section if several motion primitives
+    //        share the same finalPos.
+    //        As long as this is not the case this section should be save.
+    const maps::grid::Index finalPos(sourceNode->getIndex() + maps::grid::Index(motion.xDiff,motion.yDiff));
+
+    #pragma omp critical(searchGridAccess)
+    {
+        const auto &candidateMap = searchGrid.at(finalPos);
+
+        if(goalTravNode->getIndex() != finalPos)
+            throw std::runtime_error("Internal error, indexes do not match");
+
+        XYZNode searchTmp(goalTravNode->getHeight(), goalTravNode->getIndex());
+
+        //this works, as the equals check is on the height, not the node itself
+        auto it = candidateMap.find(&searchTmp);
+
+        if(it != candidateMap.end())
         {
-            SuccIDV->push_back(successthetaNode->id);
-            CostV->push_back(iCost);
-            motionIdV.push_back(motion.id);
+            //found a node with a matching height
+            successXYNode = *it;
+        }
+        else
+        {
+            successXYNode = createNewXYZState(goalTravNode); //modifies searchGrid at travNode->getIndex()
+        }
+    }
 
-            //####BEGIN DEBUG BLOCK!
-            {
-                const Hash &sourceHashh(idToHash[successthetaNode->id]);
-                const XYZNode *sourceNodeh = sourceHashh.node;
-                const traversability_generator3d::TravGenNode* travNodeh = sourceNodeh->getUserData().travNode;
+    #pragma omp critical(thetaToNodesAccess)
+    {
+        const auto &thetaMap(successXYNode->getUserData().thetaToNodes);
 
-                if(travNodeh->getType() != maps::grid::TraversabilityNodeBase::TRAVERSABLE)
-                {
-                    throw std::runtime_error("In GetSuccs() returned id for non-traversable patch");
-                }
-            }
-            //####END DEBUG BLOCK!!!
+        auto thetaCandidate = thetaMap.find(motion.endTheta);
+        if(thetaCandidate != thetaMap.end())
+        {
+            successthetaNode = thetaCandidate->second;
+        }
+        else
+        {
+            successthetaNode = createNewState(motion.endTheta, successXYNode);
         }
     }
+
+    return successthetaNode;
 }
 
 bool EnvironmentXYZTheta::checkOrientationAllowed(const traversability_generator3d::TravGenNode* node,
@@ -974,12 +1332,12 @@ void EnvironmentXYZTheta::getTrajectory(const vector<int>& stateIDPath,
         traversability_generator3d::TravGenNode *curNode = startHash.node->getUserData().travNode;
         std::vector<base::Vector3d> positions;
 
-        for(const CellWithPoses &cwp : curMotion.fullSplineSamples)
+        for(const CellWithPoses &cwp : availableMotions.getFullSplineSamples(curMotion))
         {
             maps::grid::Index curIndex = startIndex + cwp.cell;
             if(curIndex != lastIndex)
             {
-                traversability_generator3d::TravGenNode *nextNode = curNode->getConnectedNode(curIndex);
+                traversability_generator3d::TravGenNode *nextNode = travGen.getConnectedNeighbor(curNode, curIndex);
                 if(!nextNode)
                 {
                     for(auto *n : curNode->getConnections())
@@ -1158,12 +1516,17 @@ const EnvironmentXYZTheta::MLGrid& EnvironmentXYZTheta::getMlsMap() const
     return *mlsGrid;
 }
 
+std::shared_ptr<const EnvironmentXYZTheta::MLGrid> EnvironmentXYZTheta::getMlsMapPtr() const
+{
+    return mlsGrid;
+}
+
 const PreComputedMotions& EnvironmentXYZTheta::getAvailableMotions() const
 {
     return availableMotions;
 }
 
-double EnvironmentXYZTheta::getAvgSlope(std::vector<const traversability_generator3d::TravGenNode*> path) const
+double EnvironmentXYZTheta::getAvgSlope(const std::vector<const traversability_generator3d::TravGenNode*>& path) const
 {
     if(path.size() <= 0)
     {
@@ -1179,7 +1542,7 @@ double EnvironmentXYZTheta::getAvgSlope(std::vector<const traversability_generat
     return avgSlope;
 }
 
-double EnvironmentXYZTheta::getMaxSlope(std::vector<const traversability_generator3d::TravGenNode*> path) const
+double EnvironmentXYZTheta::getMaxSlope(const std::vector<const traversability_generator3d::TravGenNode*>& path) const
 {
     const traversability_generator3d::TravGenNode* maxElem =  *std::max_element(path.begin(), path.end(),
                                   [] (const traversability_generator3d::TravGenNode* lhs, const traversability_generator3d::TravGenNode* rhs)
@@ -1232,6 +1595,34 @@ traversability_generator3d::TraversabilityGenerator3d& EnvironmentXYZTheta::getO
 void EnvironmentXYZTheta::setTravConfig(const traversability_generator3d::TraversabilityConfig& cfg)
 {
     travConf = cfg;
+    clearEdgeCache();
+    robotFootprint = RobotFootprint(travConf);
+    robotFootprint.precompute(numAngles, footprintSubCellSteps);
+    availableMotions.computeSweptFootprints(robotFootprint);
+    updateClearanceRange();
+    updateEvaluateMotionKernel();
+    //the distances have been computed for the old range. They are rebuilt during the next expandMap()
+    obsGen.clearDistanceFields();
+    obsGen.clearHeadingMasks();
+}
+
+void EnvironmentXYZTheta::updateClearanceRange()
+{
+    //the robot pose can be anywhere inside the cell of the node and obstacles are considered if any
+    //corner of their cell is close enough. The error margin is added because the propagated distances
+    //may be larger than the exact euclidean distance.
+    clearanceRange = robotFootprint.getOuterRadius() + (std::sqrt(2.0) + ObstacleDistanceField::maxErrorCells) * travConf.gridResolution;
+    obsGen.setDistanceFieldRange(clearanceRange + travConf.gridResolution);
+}
+
+bool EnvironmentXYZTheta::isOutsideClearanceRange(const std::vector<const traversability_generator3d::TravGenNode*>& path) const
+{
+    for(const traversability_generator3d::TravGenNode *node : path)
+    {
+        if(obsGen.getDistanceToObstacle(node) <= clearanceRange || obsGen.getDistanceToFrontier(node) <= clearanceRange)
+            return false;
+    }
+    return true;
 }
 
 
@@ -1261,6 +1652,89 @@ traversability_generator3d::TravGenNode* EnvironmentXYZTheta::findObstacleNode(c
 
 }
 
+traversability_generator3d::TravGenNode* EnvironmentXYZTheta::getObstacleNode(const traversability_generator3d::TravGenNode* travNode)
+{
+    const size_t id = travNode->getUserData().id;
+    if(id >= travNodeIdToObstacleNode.size())
+    {
+        travNodeIdToObstacleNode.resize(std::max(id + 1, static_cast<size_t>(travGen.getNumNodes())), nullptr);
+    }
+
+    traversability_generator3d::TravGenNode*& obstNode = travNodeIdToObstacleNode[id];
+    if(obstNode)
+    {
+        ++statistics.obstacleNodeCacheHits;
+        return obstNode;
+    }
+
+    ++statistics.obstacleNodeCacheMisses;
+    obstNode = findObstacleNode(travNode);
+    return obstNode;
+}
+
+size_t EnvironmentXYZTheta::getObstacleNodeCacheHits() const
+{
+    return statistics.obstacleNodeCacheHits;
+}
+
+size_t EnvironmentXYZTheta::getObstacleNodeCacheMisses() const
+{
+    return statistics.obstacleNodeCacheMisses;
+}
+
+size_t EnvironmentXYZTheta::getEdgeCacheHits() const
+{
+    return statistics.edgeCacheHits;
+}
+
+size_t EnvironmentXYZTheta::getEdgeCacheMisses() const
+{
+    return statistics.edgeCacheMisses;
+}
+
+void EnvironmentXYZTheta::countRejection(int cost)
+{
+    switch(cost)
+    {
+        case REJECTED_NOT_TRAVERSABLE: ++statistics.rejectedNotTraversable; break;
+        case REJECTED_OBSTACLE_MAP: ++statistics.rejectedObstacleMap; break;
+        case REJECTED_INCLINE_LIMIT: ++statistics.rejectedInclineLimit; break;
+        case REJECTED_COLLISION: ++statistics.rejectedCollision; break;
+        default: break;
+    }
+}
+
+PlannerStatistics EnvironmentXYZTheta::getStatistics() const
+{
+    PlannerStatistics result(statistics);
+    result.statesCreated = idToHash.size();
+    return result;
+}
+
+void EnvironmentXYZTheta::setCollectStatistics(bool collect)
+{
+    collectStatistics = collect;
+}
+
+std::vector<EnvironmentXYZTheta::EdgeCacheEntry>& EnvironmentXYZTheta::getCachedEdges(int stateID, size_t numMotions)
+{
+    if(edgeCache.size() <= static_cast<size_t>(stateID))
+        edgeCache.resize(stateID + 1);
+
+    std::vector<EdgeCacheEntry> &edges(edgeCache[stateID]);
+    if(edges.empty())
+        edges.resize(numMotions);
+    assert(edges.size() == numMotions);
+    return edges;
+}
+
+void EnvironmentXYZTheta::clearEdgeCache()
+{
+    edgeCache.clear();
+    statistics.edgeCacheHits = 0;
+    statistics.edgeCacheMisses = 0;
+}
+
 std::shared_ptr<SubTrajectory> EnvironmentXYZTheta::findTrajectoryOutOfObstacle(const Eigen::Vector3d& start,
                                                                                 double theta,
                                                                                 const Eigen::Affine3d& ground2Body)
@@ -1278,14 +1752,14 @@ std::shared_ptr<SubTrajectory> EnvironmentXYZTheta::findTrajectoryOutOfObstacle(
     travGen.getTraversabilityMap().fromGrid(startTravNode->getIndex(), startPosWorld, startTravNode->getHeight(), false);
 
     DiscreteTheta thetaD(theta, numAngles);
-    traversability_generator3d::TravGenNode* startNodeObstMap = findObstacleNode(startTravNode);
-    const maps::grid::Index startIdxObstMap =  startNodeObstMap->getIndex();
+    traversability_generator3d::TravGenNode* startNodeObstMap = getObstacleNode(startTravNode);
 
     if(!startNodeObstMap)
     {
         LOG_ERROR_S<< "EnvironmentXYZTheta::findTrajectoryOutOfObstacle(): Unable to find obstacle node corresponding to start position trav node";
         throw std::runtime_error("EnvironmentXYZTheta::findTrajectoryOutOfObstacle(): Unable to find obstacle node corresponding to start position trav node");
     }
+    const maps::grid::Index startIdxObstMap =  startNodeObstMap->getIndex();
 
     int bestMotionIndex = -1;
     std::vector<const traversability_generator3d::TravGenNode*> bestNodesOnPath;
@@ -1293,7 +1767,7 @@ std::shared_ptr<SubTrajectory> EnvironmentXYZTheta::findTrajectoryOutOfObstacle(
     int bestMotionObstacleCount = std::numeric_limits<int>::max();
 
     bool intermediateStepsOk = true;
-    const auto& motions = availableMotions.getMotionForStartTheta(thetaD);
+    const MotionRange motions = availableMotions.getMotionForStartTheta(thetaD);
     for(size_t i = 0; i < motions.size(); ++i)
     {
         const ugv_nav4d::Motion &motion(motions[i]);
@@ -1351,7 +1825,7 @@ std::shared_ptr<SubTrajectory> EnvironmentXYZTheta::findTrajectoryOutOfObstacle(
         endPose.position = endPosWorld.topRows(2);
         endPose.orientation = motions[i].endTheta.getRadian();
         endPosePoses.push_back(endPose);
-        PathStatistic endPoseStats(travConf);
+        PathStatistic endPoseStats(travConf, &robotFootprint);
         endPoseStats.calculateStatistics(endPosePath, endPosePoses, obsGen.getTraversabilityMap());
         if(endPoseStats.getRobotStats().getNumObstacles() > 0 ||
            endPoseStats.getRobotStats().getNumFrontiers() > 0)
@@ -1361,7 +1835,7 @@ std::shared_ptr<SubTrajectory> EnvironmentXYZTheta::findTrajectoryOutOfObstacle(
         }
 
 
-        PathStatistic stats(travConf);
+        PathStatistic stats(travConf, &robotFootprint);
         stats.calculateStatistics(nodesOnPath, posesOnObstPath, obsGen.getTraversabilityMap());
         const int obstacleCount = stats.getRobotStats().getNumObstacles() + stats.getRobotStats().getNumFrontiers();
 
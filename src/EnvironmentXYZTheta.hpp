@@ -3,12 +3,16 @@
 #include <sbpl/discrete_space_information/environment.h>
 #undef DEBUG //sbpl defines DEBUG 0 but the word debug is also used in base-logging which is included from TraversabilityGenerator3d
 #include <traversability_generator3d/TraversabilityGenerator3d.hpp>
+#include "TravMapGenerator3D.hpp"
 #include "ObstacleMapGenerator3D.hpp"
 #include <maps/grid/TraversabilityMap3d.hpp>
 #include <base/Pose.hpp>
 #include "DiscreteTheta.hpp"
 #include "PreComputedMotions.hpp"
+#include "RobotFootprint.hpp"
+#include "PlannerStatistics.hpp"
 #include <trajectory_follower/SubTrajectory.hpp>
+#include <unordered_map>
 
 std::ostream& operator<< (std::ostream& stream, const DiscreteTheta& angle);
 
@@ -26,7 +30,7 @@ class EnvironmentXYZTheta : public DiscreteSpaceInformation
 public:
     typedef traversability_generator3d::TraversabilityGenerator3d::MLGrid MLGrid;
 protected:
-    traversability_generator3d::TraversabilityGenerator3d travGen;
+    TravMapGenerator3D travGen;
     ObstacleMapGenerator3D obsGen;
     std::shared_ptr<MLGrid > mlsGrid;
 
@@ -96,6 +100,47 @@ protected:
      * Stored in real-world coordinates (i.e. do NOT scale with gridResolution before use)*/
     std::vector<Distance> travNodeIdToDistance;
 
+    /**Contains the obstacle map node corresponding to each travNode.
+     * Indexed by travNode id. Filled lazily by getObstacleNode(). nullptr if not resolved yet. */
+    std::vector<traversability_generator3d::TravGenNode*> travNodeIdToObstacleNode;
+
+    /** Counters (and timers if collectStatistics) of the current search. Reset by clear() */
+    PlannerStatistics statistics;
+    bool collectStatistics;
+
+    /**Motions that lead from one state to another, for all edges that have been generated by GetLazySuccs()
+     * but have not necessarily been checked on the obstacle map. Indexed by getEdgeKey(). */
+    std::unordered_map<uint64_t, std::vector<size_t>> lazyEdgeMotions;
+
+    static uint64_t getEdgeKey(int fromStateID, int toStateID)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(fromStateID)) << 32) | static_cast<uint32_t>(toStateID);
+    }
+
+    /** Reasons for rejecting a motion. Negative, thus they are returned instead of a cost */
+    enum MotionRejection
+    {
+        REJECTED_NOT_TRAVERSABLE = -1,
+        REJECTED_OBSTACLE_MAP = -2,
+        REJECTED_INCLINE_LIMIT = -3,
+        REJECTED_COLLISION = -4,
+    };
+
+    /** Result of the checks and cost computation of one motion starting at one state */
+    struct EdgeCacheEntry
+    {
+        bool known = false;
+        /** cost of the motion or a (negative) MotionRejection if the motion is not possible */
+        int cost = REJECTED_NOT_TRAVERSABLE;
+        /** state that is reached by the motion. Only valid if cost >= 0 */
+        int targetStateID = -1;
+    };
+
+    /**Edges of all states that have been expanded since the last clear(). Indexed by source state id.
+     * The entries of one state are indexed like availableMotions.getMotionForStartTheta().
+     * State ids are only valid during one search, thus the cache is cleared together with the search space. */
+    std::vector<std::vector<EdgeCacheEntry>> edgeCache;
+
     PreComputedMotions availableMotions;
 
     ThetaNode *startThetaNode;
@@ -116,6 +161,65 @@ protected:
     /** Find the obstacle node corresponding to @p travNode */
     traversability_generator3d::TravGenNode* findObstacleNode(const traversability_generator3d::TravGenNode* travNode) const;
 
+    /** Cached version of findObstacleNode().
+     *  Not thread-safe. */
+    traversability_generator3d::TravGenNode* getObstacleNode(const traversability_generator3d::TravGenNode* travNode);
+
+    /** Checks @p motion on the obstacle map (incline limits and path statistics) and computes its cost.
+     *  The motion has to be traversable on the traversability map, i.e. checkTraversableHeuristic() returned @p goalTravNode.
+     *  Thread-safe between beginConcurrentExpansion() and endConcurrentExpansion() of both generators.
+     *  @return the cost of the motion (never smaller than motion.baseCost) or a (negative) MotionRejection if the motion is not possible */
+    int evaluateMotion(const XYZNode *sourceNode, traversability_generator3d::TravGenNode *sourceObstacleNode,
+                       const Motion &motion, const traversability_generator3d::TravGenNode *goalTravNode)
+    {
+        return (this->*evaluateMotionKernel)(sourceNode, sourceObstacleNode, motion, goalTravNode);
+    }
+
+    typedef int (EnvironmentXYZTheta::*EvaluateMotionKernel)(const XYZNode *, traversability_generator3d::TravGenNode *,
+                                                            const Motion &, const traversability_generator3d::TravGenNode *);
+
+    /** evaluateMotion() for one combination of settings. The settings are template parameters
+     *  to get rid of all configuration branches inside of the obstacle walk */
+    template<traversability_generator3d::SlopeMetric slopeMetric, bool pathStatistics, bool inclineLimitting>
+    int evaluateMotionImpl(const XYZNode *sourceNode, traversability_generator3d::TravGenNode *sourceObstacleNode,
+                           const Motion &motion, const traversability_generator3d::TravGenNode *goalTravNode);
+
+    template<traversability_generator3d::SlopeMetric slopeMetric>
+    EvaluateMotionKernel selectEvaluateMotionKernel() const;
+
+    /** Selects the evaluateMotionImpl() instance matching travConf and usePathStatistics.
+     *  Needs to be called whenever one of them changes */
+    void updateEvaluateMotionKernel();
+
+    /** @return the state that is reached by following @p motion from @p sourceNode. The state is created if needed.
+     *          Thread-safe. */
+    ThetaNode *getSuccessorState(const XYZNode *sourceNode, traversability_generator3d::TravGenNode *goalTravNode, const Motion &motion);
+
+    /** Does the remaining checks of @p motion, computes its cost and finds the target state.
+     *  @param goalTravNode end of the motion on the traversability map or nullptr if the motion is not traversable
+     *  Thread-safe between beginConcurrentExpansion() and endConcurrentExpansion() of both generators. */
+    EdgeCacheEntry evaluateEdge(const XYZNode *sourceNode, traversability_generator3d::TravGenNode *sourceObstacleNode,
+                                const Motion &motion, traversability_generator3d::TravGenNode *goalTravNode);
+
+    /** Checks all motions that start at @p sourceNode with @p theta on the traversability map in one walk
+     *  over the motion trie. Motions with a common prefix share its traversal and a cell that is not traversable
+     *  rules out all motions below it at once. The upper levels of the trie are checked sequentially until
+     *  there are enough subtrees to check them in parallel.
+     *  @param goalTravNodes is filled with the end node of each motion (indexed like getMotionForStartTheta()),
+     *                       nullptr if the motion is not traversable
+     *  @param trace record the walk in the ChromeTrace
+     *  Needs to be called between beginConcurrentExpansion() and endConcurrentExpansion() of travGen. */
+    void findGoalTravNodes(const XYZNode *sourceNode, const DiscreteTheta &theta,
+                           std::vector<traversability_generator3d::TravGenNode*> &goalTravNodes, bool trace = false);
+
+    /** @return the cached edges of state @p stateID. Not thread-safe. */
+    std::vector<EdgeCacheEntry>& getCachedEdges(int stateID, size_t numMotions);
+
+    void clearEdgeCache();
+
+    /** Adds a motion with result @p cost to the rejection counters of statistics if it has been rejected. Not thread-safe */
+    void countRejection(int cost);
+
 public:
 
     /** @param pos Position in map frame */
@@ -141,9 +245,19 @@ public:
     virtual bool InitializeMDPCfg(MDPConfig* MDPCfg);
 
 
-    /**Expand the underlying travmap and obstacle map starting from all given positions. */
+    /**Expand the underlying travmap and obstacle map starting from all given positions.
+     * Uses all available OpenMP threads. */
     void expandMap(const std::vector<Eigen::Vector3d>& positions);
 
+    /** Writes the expanded traversability map and obstacle map, see TravMapGenerator3D::saveNodes() */
+    void saveExpandedMaps(std::ostream& out) const;
+
+    /** Replaces the traversability map and obstacle map by maps that have been written by saveExpandedMaps()
+     *  for the current mls map. Clears the search, following calls of expandMap() only expand missing parts.
+     *  @throw std::runtime_error if the maps are invalid or do not fit to the mls map. The maps are unchanged
+     *         if the traversability map is rejected, both maps are cleared if only the obstacle map is rejected */
+    void loadExpandedMaps(std::istream& in);
+
     /**Returns the trajectory of least resistance to leave the obstacle.
      * @param start start position that is inside an obstacle
      * @param theta robot orientation
@@ -172,6 +286,15 @@ public:
     virtual void GetSuccs(int SourceStateID, std::vector< int >* SuccIDV, std::vector< int >* CostV);
     virtual void GetSuccs(int SourceStateID, std::vector< int >* SuccIDV, std::vector< int >* CostV, std::vector< size_t >& motionIdV);
 
+    /** Lazy version of GetSuccs() used by LazyARAPlanner.
+     *  Only checks the motions on the traversability map. The returned costs are the base costs
+     *  of the motions, which are a lower bound of the true costs. */
+    virtual void GetLazySuccs(int SourceStateID, std::vector< int >* SuccIDV, std::vector< int >* CostV, std::vector< bool >* isTrueCost);
+
+    /** Does the expensive checks for an edge returned by GetLazySuccs().
+     *  @return the cost of the cheapest valid motion between the states or -1 if there is none */
+    virtual int GetTrueCost(int parentID, int childID);
+
     virtual void PrintEnv_Config(FILE* fOut);
     virtual void PrintState(int stateID, bool bVerbose, FILE* fOut = 0);
 
@@ -197,6 +320,9 @@ public:
 
     const MLGrid &getMlsMap() const;
 
+    /** @return the shared map. It is replaced by updateMap() but never modified, thus it can be kept as a snapshot */
+    std::shared_ptr<const MLGrid> getMlsMapPtr() const;
+
     std::vector<Motion> getMotions(const std::vector<int> &stateIDPath);
 
     void getTrajectory(const std::vector<int> &stateIDPath, std::vector<trajectory_follower::SubTrajectory> &result,
@@ -214,6 +340,22 @@ public:
     void dijkstraComputeCost(const traversability_generator3d::TravGenNode* source, std::vector<double> &outDistances,
                              const double maxDist) const;
 
+    /** Number of obstacle node lookups that have been answered from the cache since the last clear() */
+    size_t getObstacleNodeCacheHits() const;
+    /** Number of obstacle node lookups that needed a search on the obstacle map since the last clear() */
+    size_t getObstacleNodeCacheMisses() const;
+
+    /** Number of motions whose feasibility and cost have been answered from the edge cache since the last clear() */
+    size_t getEdgeCacheHits() const;
+    /** Number of motions that had to be checked since the last clear() */
+    size_t getEdgeCacheMisses() const;
+
+    /** @return the counters and timers of the search since the last clear(). See PlannerStatistics */
+    PlannerStatistics getStatistics() const;
+
+    /** Measure the time spent in the successor generation and the heuristic computation */
+    void setCollectStatistics(bool collect);
+
     /** Should a computationally expensive obstacle check be done to check whether the robot bounding box
      *  is in collision with obstacles. This mode is useful for highly cluttered and tight spaced environments */
     void enablePathStatistics(bool enable);
@@ -236,10 +378,10 @@ private:
     void precomputeCost();
 
     /**Return the avg slope of all patches on the given @p path */
-    double getAvgSlope(std::vector<const traversability_generator3d::TravGenNode*> path) const;
+    double getAvgSlope(const std::vector<const traversability_generator3d::TravGenNode*>& path) const;
 
     /**Returns the max slope of all patches on the given @p path */
-    double getMaxSlope(std::vector<const traversability_generator3d::TravGenNode*> path) const;
+    double getMaxSlope(const std::vector<const traversability_generator3d::TravGenNode*>& path) const;
 
 
     /**Determines the distance between @p a and @p b depending on travConf.heuristicType */
@@ -247,14 +389,14 @@ private:
 
     /** Checks if movement from @p fromTravNode to its neighbor at position @p toIdx is possible.
      *  I.e. if a direct connection exists and if the neighbor is traversable.
-     *  Expands the neighbor if not already expanded.
+     *  Expands the neighbor using @p generator if not already expanded.
      *  @return the neighbor at position @p toIdx */
-    traversability_generator3d::TravGenNode* movementPossible(traversability_generator3d::TravGenNode* fromTravNode, const maps::grid::Index& fromIdx, const maps::grid::Index& toIdx);
+    traversability_generator3d::TravGenNode* movementPossible(TravMapGenerator3D& generator, traversability_generator3d::TravGenNode* fromTravNode, const maps::grid::Index& fromIdx, const maps::grid::Index& toIdx);
 
     /** Expands @p node if it needs expansion.
-     *  Thread-safe.
+     *  Thread-safe. Only expansions of neighboring nodes block each other.
      *  @return True if the expansion succeeded */
-    bool checkExpandTreadSafe(traversability_generator3d::TravGenNode * node);
+    bool checkExpandTreadSafe(TravMapGenerator3D& generator, traversability_generator3d::TravGenNode * node);
 
     bool usePathStatistics;
 
@@ -264,6 +406,28 @@ private:
     unsigned int numAngles;
 
     Mobility mobilityConfig;
+
+    /** Time needed to turn by n discrete angles, indexed by n (i.e. DiscreteTheta::shortestDist()).
+     *  Used by the heuristics, which are evaluated for every generated state */
+    std::vector<double> rotationTimes;
+
+    /** Footprint masks of the robot for all discrete headings. Used by the path statistics */
+    RobotFootprint robotFootprint;
+    /** Sub-cell offsets per axis of the footprint masks. Odd, thus the cell center is exact */
+    static const unsigned int footprintSubCellSteps = 3;
+
+    /** Instance of evaluateMotionImpl() for the current configuration */
+    EvaluateMotionKernel evaluateMotionKernel;
+
+    /** Obstacles and frontiers that are farther away from all nodes of a motion do not
+     *  influence the path statistics of the motion */
+    double clearanceRange;
+
+    /** Computes clearanceRange and configures the distance fields of the obstacle map accordingly */
+    void updateClearanceRange();
+
+    /** @return true if no obstacle or frontier is within clearanceRange of any node in @p path */
+    bool isOutsideClearanceRange(const std::vector<const traversability_generator3d::TravGenNode*>& path) const;
 };
 
 }
@@ -0,0 +1,66 @@
+#include "HeadingMask.hpp"
+#include <cmath>
+
+namespace ugv_nav4d
+{
+
+static const double binWidth = 2.0 * M_PI / HeadingMask::numBins;
+//makes the classification of bins that touch a segment border conservative
+static const double eps = 1e-9;
+
+/** @return @p rad normalized to [0, 2pi) */
+static double normalize(double rad)
+{
+    const double normalized = std::fmod(rad, 2.0 * M_PI);
+    return normalized < 0 ? normalized + 2.0 * M_PI : normalized;
+}
+
+HeadingMask::HeadingMask() : allowed(0), undecided(~uint64_t(0))
+{
+}
+
+HeadingMask::HeadingMask(const std::vector<base::AngleSegment>& allowedOrientations) : allowed(0), undecided(0)
+{
+    for(int bin = 0; bin < numBins; ++bin)
+    {
+        const double binStart = bin * binWidth;
+        const uint64_t bit = uint64_t(1) << bin;
+
+        bool inside = false;
+        bool touched = false;
+        for(const base::AngleSegment& segment : allowedOrientations)
+        {
+            const double segmentStart = normalize(segment.getStart().getRad());
+            const double segmentWidth = segment.getWidth();
+
+            //offset of the bin start inside of the segment and of the segment start inside of the bin
+            const double binOffset = normalize(binStart - segmentStart);
+            const double segmentOffset = normalize(segmentStart - binStart);
+
+            if(binOffset + binWidth + eps < segmentWidth)
+            {
+                inside = true;
+                break;
+            }
+            if(binOffset <= segmentWidth + eps || segmentOffset <= binWidth + eps ||
+               2.0 * M_PI - binOffset <= eps || 2.0 * M_PI - segmentOffset <= eps)
+            {
+                touched = true;
+            }
+        }
+
+        if(inside)
+            allowed |= bit;
+        else if(touched)
+            undecided |= bit;
+    }
+}
+
+int HeadingMask::getBin(double headingRad)
+{
+    const int bin = static_cast<int>(normalize(headingRad) / binWidth);
+    //rounding might map values just below 2pi to numBins
+    return bin < numBins ? bin : numBins - 1;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <base/Angle.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace ugv_nav4d
+{
+
+/** Allowed headings of one node as bitmask over fixed heading bins.
+ *
+ *  The headings [0, 2pi) are split into numBins bins. A bin is either completely inside one of
+ *  the allowed AngleSegments of the node, completely outside of all of them or undecided (a
+ *  segment border lies inside of the bin). Only headings in undecided bins need to be checked
+ *  against the segments, all other checks are a single bit test.
+ *
+ *  The intermediate poses of backward motions are already flipped by PreComputedMotions,
+ *  thus no separate mask for flipped headings is needed.
+ */
+class HeadingMask
+{
+public:
+    enum Result
+    {
+        ALLOWED,
+        FORBIDDEN,
+        UNDECIDED,
+    };
+
+    static constexpr int numBins = 64;
+
+    /** Every heading is undecided */
+    HeadingMask();
+
+    /** Computes the mask of a node with @p allowedOrientations */
+    HeadingMask(const std::vector<base::AngleSegment>& allowedOrientations);
+
+    Result check(double headingRad) const
+    {
+        const uint64_t bit = uint64_t(1) << getBin(headingRad);
+        if(allowed & bit)
+            return ALLOWED;
+        if(undecided & bit)
+            return UNDECIDED;
+        return FORBIDDEN;
+    }
+
+    /** @return the bin that contains @p headingRad */
+    static int getBin(double headingRad);
+
+private:
+    uint64_t allowed;
+    uint64_t undecided;
+};
+
+}
@@ -0,0 +1,36 @@
+#include "MappedFile.hpp"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ugv_nav4d
+{
+
+MappedFile::MappedFile(const std::string& name) : data(nullptr), size(0)
+{
+    const int fd = open(name.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("MappedFile: Cannot open " + name);
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        size = static_cast<size_t>(fileStat.st_size);
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping != MAP_FAILED)
+            data = static_cast<const char*>(mapping);
+    }
+    close(fd);
+
+    if(!data)
+        throw std::runtime_error("MappedFile: Cannot map " + name);
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(const_cast<char*>(data), size);
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace ugv_nav4d
+{
+
+/** Read only memory mapping of a whole file */
+class MappedFile
+{
+public:
+    /** @throw std::runtime_error if the file cannot be opened or mapped (e.g. because it is empty) */
+    explicit MappedFile(const std::string& name);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char *getData() const
+    {
+        return data;
+    }
+
+    size_t getSize() const
+    {
+        return size;
+    }
+
+private:
+    const char *data;
+    size_t size;
+};
+
+}
@@ -0,0 +1,96 @@
+#include "ObstacleDistanceField.hpp"
+#include <functional>
+#include <limits>
+#include <queue>
+
+using traversability_generator3d::TravGenNode;
+
+namespace ugv_nav4d
+{
+
+ObstacleDistanceField::ObstacleDistanceField() : gridResolution(1.0)
+{
+}
+
+void ObstacleDistanceField::reset(size_t numNodes, double gridResolution)
+{
+    this->gridResolution = gridResolution;
+    Entry far;
+    far.distance = std::numeric_limits<double>::max();
+    far.source = maps::grid::Index(0, 0);
+    entries.assign(numNodes, far);
+    newSources.clear();
+}
+
+void ObstacleDistanceField::clear()
+{
+    entries.clear();
+    newSources.clear();
+}
+
+void ObstacleDistanceField::addSource(const TravGenNode* node)
+{
+    newSources.push_back(node);
+}
+
+void ObstacleDistanceField::propagate(double range)
+{
+    typedef std::pair<double, const TravGenNode*> QueueEntry;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+    for(const TravGenNode *node : newSources)
+    {
+        const size_t id = node->getUserData().id;
+        if(id >= entries.size())
+        {
+            Entry unknown;
+            unknown.distance = -1;
+            entries.resize(id + 1, unknown);
+        }
+        entries[id].distance = 0;
+        entries[id].source = node->getIndex();
+        queue.push(QueueEntry(0, node));
+    }
+    newSources.clear();
+
+    while(!queue.empty())
+    {
+        const QueueEntry current = queue.top();
+        queue.pop();
+
+        const Entry &entry(entries[current.second->getUserData().id]);
+        if(current.first > entry.distance)
+        {
+            //outdated, the node has been reached from a closer source in the meantime
+            continue;
+        }
+
+        for(const maps::grid::TraversabilityNodeBase *n : current.second->getConnections())
+        {
+            const TravGenNode *neighbor = static_cast<const TravGenNode*>(n);
+            const size_t neighborId = neighbor->getUserData().id;
+
+            //unknown nodes stay unknown, they might be closer to a source that has not been propagated to them
+            if(neighborId >= entries.size() || entries[neighborId].distance < 0)
+                continue;
+
+            const double distance = (neighbor->getIndex() - entry.source).cast<double>().norm() * gridResolution;
+            if(distance > range || distance >= entries[neighborId].distance)
+                continue;
+
+            entries[neighborId].distance = distance;
+            entries[neighborId].source = entry.source;
+            queue.push(QueueEntry(distance, neighbor));
+        }
+    }
+}
+
+double ObstacleDistanceField::getDistance(const TravGenNode* node) const
+{
+    const size_t id = node->getUserData().id;
+    if(id >= entries.size() || entries[id].distance < 0)
+        return 0;
+    return entries[id].distance;
+}
+
+}
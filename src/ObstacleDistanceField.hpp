@@ -0,0 +1,63 @@
+#pragma once
+#include <traversability_generator3d/TravGenNode.hpp>
+#include <vector>
+
+namespace ugv_nav4d
+{
+
+/** Distance from each node of a traversability map to the closest source node (e.g. the closest obstacle).
+ *
+ *  The distance is the euclidean distance in the xy-plane between the cell centers of a node and of its
+ *  closest source. It is propagated from the sources along the node connections (breadth first with
+ *  source tracking). Thus only sources that are connected to a node are taken into account, this
+ *  matches the flood fill that is done by PathStatistic.
+ *
+ *  Distances are only propagated up to a given range and can only decrease when new sources are added.
+ *  Entries are indexed by node id.
+ *
+ *  Source tracking is not exact: a node may inherit the source of its neighbor although another source is
+ *  closer. The propagated distance is never smaller than the exact one. If every cell around the traversable
+ *  nodes has a node, as in a traversability map, it is at most maxErrorCells cells larger (a few hundredths of
+ *  a cell in practice). Users that decide on the distance whether something has to be checked add this margin.
+ */
+class ObstacleDistanceField
+{
+public:
+    /** Upper bound of the overestimation in cells, see check_obstacle_distance_field_concave */
+    static constexpr double maxErrorCells = 1.0;
+
+    ObstacleDistanceField();
+
+    /** Marks all nodes with an id below @p numNodes as known and farther away than the range.
+     *  Nodes with larger ids are unknown until they are added as source. */
+    void reset(size_t numNodes, double gridResolution);
+
+    /** Forgets all nodes */
+    void clear();
+
+    /** Adds @p node as source. Takes effect in the next call to propagate() */
+    void addSource(const traversability_generator3d::TravGenNode *node);
+
+    /** Propagates all sources that have been added since the last call.
+     *  @param range distances larger than this are not propagated */
+    void propagate(double range);
+
+    /** @return the distance from @p node to the closest source.
+     *          std::numeric_limits<double>::max() if there is no source within range.
+     *          0 if the node is unknown, i.e. it has been created after the last reset() */
+    double getDistance(const traversability_generator3d::TravGenNode *node) const;
+
+private:
+    struct Entry
+    {
+        /** < 0 if unknown */
+        double distance;
+        maps::grid::Index source;
+    };
+
+    double gridResolution;
+    std::vector<Entry> entries;
+    std::vector<const traversability_generator3d::TravGenNode *> newSources;
+};
+
+}
@@ -1,13 +1,17 @@
 #include "ObstacleMapGenerator3D.hpp"
 #include <vizkit3d_debug_drawings/DebugDrawing.hpp>
 #include <vizkit3d_debug_drawings/DebugDrawingColors.hpp>
+#include <limits>
 
 using namespace maps::grid;
 
 namespace ugv_nav4d
 {
     
-ObstacleMapGenerator3D::ObstacleMapGenerator3D(const traversability_generator3d::TraversabilityConfig& config): TraversabilityGenerator3d(config)
+ObstacleMapGenerator3D::ObstacleMapGenerator3D(const traversability_generator3d::TraversabilityConfig& config): TravMapGenerator3D(config),
+    distanceFieldRange(std::numeric_limits<double>::max()),
+    trackDistanceFieldSources(false),
+    trackHeadingMaskNodes(false)
 {
 
 }
@@ -24,23 +28,25 @@ bool ObstacleMapGenerator3D::expandNode(traversability_generator3d::TravGenNode
 
     if(node->getType() == TraversabilityNodeBase::UNKNOWN)
     {   
+        addDistanceFieldSource(node);
         return false;
     }
 
     if(node->getType() == TraversabilityNodeBase::OBSTACLE)
     {   
-        obstacleNodesGrowList.push_back(node);       
+        addToGrowList(node);       
         return false;
     }
     
     if(node->getUserData().slope > config.maxSlope){
+        addDistanceFieldSource(node);
         return false;
     }
 
     if(!obstacleCheck(node))
     {
         node->setType(TraversabilityNodeBase::OBSTACLE);
-        obstacleNodesGrowList.push_back(node);
+        addToGrowList(node);
         return false;
     }
 
@@ -49,17 +55,29 @@ bool ObstacleMapGenerator3D::expandNode(traversability_generator3d::TravGenNode
         if(!computeAllowedOrientations(node))
         {
             node->setType(TraversabilityNodeBase::OBSTACLE);
-            obstacleNodesGrowList.push_back(node);
+            addToGrowList(node);
             return false;
         }
+        addHeadingMaskNode(node);
     }
 
     //add sourounding 
-    addConnectedPatches(node);
+    addConnectedPatchesThreadSafe(node);
+
+    if(trackDistanceFieldSources)
+    {
+        //new nodes are unknown to the distance fields. Until they are expanded, they count as obstacle
+        for(TraversabilityNodeBase *n : node->getConnections())
+        {
+            if(!n->isExpanded())
+                addDistanceFieldSource(static_cast<traversability_generator3d::TravGenNode *>(n));
+        }
+    }
 
     if(checkForFrontier(node))
     {
         node->setType(TraversabilityNodeBase::FRONTIER);
+        addDistanceFieldSource(node);
         return false;
     }
 
@@ -69,6 +87,173 @@ bool ObstacleMapGenerator3D::expandNode(traversability_generator3d::TravGenNode
 }
 
 
+void ObstacleMapGenerator3D::addToGrowList(traversability_generator3d::TravGenNode* node)
+{
+    //nodes might be expanded concurrently by TravMapGenerator3D::expandAllParallel()
+    addToGrowListThreadSafe(node);
+    addDistanceFieldSource(node);
+}
+
+void ObstacleMapGenerator3D::addDistanceFieldSource(traversability_generator3d::TravGenNode* node)
+{
+    //the fields are rebuilt from scratch anyway
+    if(!trackDistanceFieldSources)
+        return;
+
+    #pragma omp critical(newDistanceFieldSources)
+    {
+        newDistanceFieldSources.push_back(node);
+    }
+}
+
+void ObstacleMapGenerator3D::addHeadingMaskNode(traversability_generator3d::TravGenNode* node)
+{
+    //the masks are rebuilt from scratch anyway
+    if(!trackHeadingMaskNodes)
+        return;
+
+    #pragma omp critical(newHeadingMaskNodes)
+    {
+        newHeadingMaskNodes.push_back(node);
+    }
+}
+
+void ObstacleMapGenerator3D::addToDistanceFields(const traversability_generator3d::TravGenNode* node)
+{
+    //same classification as PathStatistic, i.e. nodes that have not been expanded yet count as obstacle
+    switch(node->getType())
+    {
+        case TraversabilityNodeBase::TRAVERSABLE:
+            break;
+        case TraversabilityNodeBase::FRONTIER:
+            frontierDistances.addSource(node);
+            break;
+        default:
+            obstacleDistances.addSource(node);
+            break;
+    }
+}
+
+void ObstacleMapGenerator3D::rebuildDistanceFields()
+{
+    obstacleDistances.reset(getNumNodes(), config.gridResolution);
+    frontierDistances.reset(getNumNodes(), config.gridResolution);
+    newDistanceFieldSources.clear();
+    trackDistanceFieldSources = true;
+
+    for(const LevelList<traversability_generator3d::TravGenNode *> &l : trMap)
+    {
+        for(const traversability_generator3d::TravGenNode *n : l)
+        {
+            addToDistanceFields(n);
+        }
+    }
+
+    obstacleDistances.propagate(distanceFieldRange);
+    frontierDistances.propagate(distanceFieldRange);
+}
+
+void ObstacleMapGenerator3D::updateDistanceFields()
+{
+    if(newDistanceFieldSources.empty())
+        return;
+
+    for(const traversability_generator3d::TravGenNode *n : newDistanceFieldSources)
+    {
+        addToDistanceFields(n);
+    }
+    newDistanceFieldSources.clear();
+
+    obstacleDistances.propagate(distanceFieldRange);
+    frontierDistances.propagate(distanceFieldRange);
+}
+
+void ObstacleMapGenerator3D::clearDistanceFields()
+{
+    obstacleDistances.clear();
+    frontierDistances.clear();
+    newDistanceFieldSources.clear();
+    trackDistanceFieldSources = false;
+}
+
+void ObstacleMapGenerator3D::setDistanceFieldRange(double range)
+{
+    distanceFieldRange = range;
+}
+
+double ObstacleMapGenerator3D::getDistanceToObstacle(const traversability_generator3d::TravGenNode* node) const
+{
+    return obstacleDistances.getDistance(node);
+}
+
+double ObstacleMapGenerator3D::getDistanceToFrontier(const traversability_generator3d::TravGenNode* node) const
+{
+    return frontierDistances.getDistance(node);
+}
+
+void ObstacleMapGenerator3D::rebuildHeadingMasks()
+{
+    headingMasks.assign(getNumNodes(), HeadingMask());
+    newHeadingMaskNodes.clear();
+    trackHeadingMaskNodes = true;
+
+    if(!config.enableInclineLimitting)
+        return;
+
+    for(const LevelList<traversability_generator3d::TravGenNode *> &l : trMap)
+    {
+        for(const traversability_generator3d::TravGenNode *n : l)
+        {
+            if(n->isExpanded() && n->getType() == TraversabilityNodeBase::TRAVERSABLE && n->getUserData().id < headingMasks.size())
+                headingMasks[n->getUserData().id] = HeadingMask(n->getUserData().allowedOrientations);
+        }
+    }
+}
+
+void ObstacleMapGenerator3D::updateHeadingMasks()
+{
+    for(const traversability_generator3d::TravGenNode *n : newHeadingMaskNodes)
+    {
+        const size_t id = n->getUserData().id;
+        if(id >= headingMasks.size())
+            headingMasks.resize(id + 1);
+        headingMasks[id] = HeadingMask(n->getUserData().allowedOrientations);
+    }
+    newHeadingMaskNodes.clear();
+}
+
+void ObstacleMapGenerator3D::clearHeadingMasks()
+{
+    headingMasks.clear();
+    newHeadingMaskNodes.clear();
+    trackHeadingMaskNodes = false;
+}
+
+bool ObstacleMapGenerator3D::isHeadingAllowed(const traversability_generator3d::TravGenNode* node, double headingRad) const
+{
+    const size_t id = node->getUserData().id;
+    if(id < headingMasks.size())
+    {
+        switch(headingMasks[id].check(headingRad))
+        {
+            case HeadingMask::ALLOWED:
+                return true;
+            case HeadingMask::FORBIDDEN:
+                return false;
+            case HeadingMask::UNDECIDED:
+                break;
+        }
+    }
+
+    const base::Angle heading = base::Angle::fromRad(headingRad);
+    for(const base::AngleSegment& segment : node->getUserData().allowedOrientations)
+    {
+        if(segment.isInside(heading))
+            return true;
+    }
+    return false;
+}
+
 bool ObstacleMapGenerator3D::obstacleCheck(const traversability_generator3d::TravGenNode* node) const
 {
     //check if there is an mls patch above the ground
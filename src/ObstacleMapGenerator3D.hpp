@@ -1,19 +1,85 @@
 #pragma once
-#include <traversability_generator3d/TraversabilityGenerator3d.hpp>
+#include "TravMapGenerator3D.hpp"
+#include "ObstacleDistanceField.hpp"
+#include "HeadingMask.hpp"
 
 namespace ugv_nav4d
 {
-    class ObstacleMapGenerator3D : public traversability_generator3d::TraversabilityGenerator3d
+    class ObstacleMapGenerator3D : public TravMapGenerator3D
     {
     public:
         ObstacleMapGenerator3D(const traversability_generator3d::TraversabilityConfig &config);
         virtual ~ObstacleMapGenerator3D();
         virtual bool expandNode(traversability_generator3d::TravGenNode *node) override;
 //         virtual traversability_generator3d::TravGenNode *generateStartNode(const Eigen::Vector3d &startPos) override;
+
+        /** Recomputes the distance of all nodes to the closest obstacle and frontier.
+         *  Should be called after the map has been expanded. Not thread-safe. */
+        void rebuildDistanceFields();
+
+        /** Propagates the obstacles and frontiers that have been found by expandNode()
+         *  since the last update into the distance fields. Not thread-safe. */
+        void updateDistanceFields();
+
+        /** Forgets all distances, e.g. because the map has been cleared */
+        void clearDistanceFields();
+
+        /** Distances larger than @p range are not computed */
+        void setDistanceFieldRange(double range);
+
+        /** @return the distance to the closest connected obstacle (any non traversable, non frontier
+         *          patch including patches that have not been expanded), see ObstacleDistanceField::getDistance() */
+        double getDistanceToObstacle(const traversability_generator3d::TravGenNode* node) const;
+
+        /** @return the distance to the closest connected frontier, see ObstacleDistanceField::getDistance() */
+        double getDistanceToFrontier(const traversability_generator3d::TravGenNode* node) const;
+
+        /** Computes the heading masks of all expanded nodes.
+         *  Should be called after the map has been expanded. Not thread-safe. */
+        void rebuildHeadingMasks();
+
+        /** Computes the heading masks of the nodes that have been expanded by expandNode()
+         *  since the last update. Not thread-safe. */
+        void updateHeadingMasks();
+
+        /** Forgets all heading masks, e.g. because the map has been cleared */
+        void clearHeadingMasks();
+
+        /** @return true if @p headingRad is inside of the allowed orientations of @p node.
+         *          Usually a single bit test, nodes without heading mask are checked against
+         *          node->getUserData().allowedOrientations. Thread-safe. */
+        bool isHeadingAllowed(const traversability_generator3d::TravGenNode* node, double headingRad) const;
         
     private:
         
         /** @return true if obstacle check passed */
         bool obstacleCheck(const traversability_generator3d::TravGenNode* node) const;
+
+        /** Adds @p node to the obstacle grow list. Thread-safe. */
+        void addToGrowList(traversability_generator3d::TravGenNode* node);
+
+        /** Remembers @p node for the next updateDistanceFields() if the fields have been built. Thread-safe. */
+        void addDistanceFieldSource(traversability_generator3d::TravGenNode* node);
+
+        /** Adds @p node to the matching distance field if it is an obstacle or a frontier */
+        void addToDistanceFields(const traversability_generator3d::TravGenNode* node);
+
+        /** Remembers @p node for the next updateHeadingMasks() if the masks have been built. Thread-safe. */
+        void addHeadingMaskNode(traversability_generator3d::TravGenNode* node);
+
+        double distanceFieldRange;
+        ObstacleDistanceField obstacleDistances;
+        ObstacleDistanceField frontierDistances;
+        /** false until the fields have been built. The expansion of the whole map does not need to track sources */
+        bool trackDistanceFieldSources;
+        /** nodes whose type has been determined since the last update of the distance fields */
+        std::vector<traversability_generator3d::TravGenNode*> newDistanceFieldSources;
+
+        /** indexed by node id. Default masks (everything undecided) for unknown nodes */
+        std::vector<HeadingMask> headingMasks;
+        /** false until the masks have been built */
+        bool trackHeadingMaskNodes;
+        /** nodes whose allowed orientations have been computed since the last update of the masks */
+        std::vector<traversability_generator3d::TravGenNode*> newHeadingMaskNodes;
     };
 }
@@ -1,5 +1,5 @@
 #include "PathStatistic.hpp"
-#include <unordered_set>
+#include <algorithm>
 #include <deque>
 #include <vizkit3d_debug_drawings/DebugDrawing.hpp>
 #include <vizkit3d_debug_drawings/DebugDrawingColors.hpp>
@@ -55,9 +55,35 @@ double ugv_nav4d::PathStatistic::Stats::getMinDistToObstacles() const
     return minDistToObstacle;
 }
 
-ugv_nav4d::PathStatistic::PathStatistic(const traversability_generator3d::TraversabilityConfig& config) : 
-        config(config)
+ugv_nav4d::PathStatistic::PathStatistic(const traversability_generator3d::TraversabilityConfig& config, const RobotFootprint *footprint) : 
+        config(config), footprint(footprint), maskLookups(0), geometricChecks(0)
 {
+    if(!footprint || !footprint->matches(config))
+    {
+        ownFootprint.reset(new RobotFootprint(config));
+        this->footprint = ownFootprint.get();
+    }
+}
+
+const ugv_nav4d::RobotFootprint::Mask* ugv_nav4d::PathStatistic::findMask(const base::Vector2d& poseOffset, double orientation)
+{
+    const RobotFootprint::Mask *mask = footprint->findMask(poseOffset, orientation);
+    if(mask)
+        ++maskLookups;
+    else
+        ++geometricChecks;
+    return mask;
+}
+
+ugv_nav4d::RobotFootprint::Cell ugv_nav4d::PathStatistic::classify(const RobotFootprint::Mask *mask, const base::Vector2d& poseOffset,
+                                                                   const Eigen::Rotation2D<double>& yawInverse,
+                                                                   const maps::grid::TraversabilityNodeBase *node,
+                                                                   const maps::grid::TraversabilityNodeBase *neighbor) const
+{
+    const maps::grid::Index cellOffset(neighbor->getIndex() - node->getIndex());
+    if(mask)
+        return mask->at(cellOffset);
+    return footprint->classify(poseOffset, yawInverse, cellOffset);
 }
 
 void ugv_nav4d::PathStatistic::calculateStatistics(const std::vector<const traversability_generator3d::TravGenNode* >& path, 
@@ -67,24 +93,11 @@ void ugv_nav4d::PathStatistic::calculateStatistics(const std::vector<const trave
 {
     assert(path.size() == poses.size());
 //     CLEAR_DRAWING("CollisionBox");
-   
-    const Eigen::Vector2d travGridResolution(config.gridResolution, config.gridResolution);
 
-    Eigen::Vector2d halfRobotDimension(config.robotSizeX / 2.0, config.robotSizeY/2.0);
-    Eigen::Vector2d halfOuterBoxDimension(halfRobotDimension + Eigen::Vector2d::Constant(config.costFunctionDist));
-    
-    std::vector<Eigen::Vector2d> edgePositions = {
-        Eigen::Vector2d(- config.gridResolution /2.0, - config.gridResolution / 2.0),
-        Eigen::Vector2d(- config.gridResolution / 2.0, config.gridResolution / 2.0),
-        Eigen::Vector2d(config.gridResolution / 2.0, config.gridResolution / 2.0),
-        Eigen::Vector2d(config.gridResolution / 2.0, -config.gridResolution / 2.0)
-    };
-    
-    Eigen::AlignedBox<double, 2> robotBoundingBox(- halfRobotDimension, halfRobotDimension);
-    Eigen::AlignedBox<double, 2> costFunctionBoundingBox(- halfOuterBoxDimension, halfOuterBoxDimension);
-
-    std::unordered_set<const maps::grid::TraversabilityNodeBase*> inRobot;
-    std::unordered_set<const maps::grid::TraversabilityNodeBase*> inBoundary;
+    //a node is usually visited several times (once per pose). Collect them in vectors
+    //and remove the duplicates afterwards, this is a lot cheaper than hashing every visit
+    std::vector<const maps::grid::TraversabilityNodeBase*> inRobot;
+    std::vector<const maps::grid::TraversabilityNodeBase*> inBoundary;
 
     for(size_t i = 0; i < path.size(); i++)
     {
@@ -94,46 +107,15 @@ void ugv_nav4d::PathStatistic::calculateStatistics(const std::vector<const trave
         const Eigen::Rotation2D<double> yawInverse(Eigen::Rotation2D<double>(curPose.orientation).inverse());
 
         maps::grid::Vector3d nodePos3 = node->getPosition(trMap);
-        const maps::grid::Vector2d nodePos(nodePos3.head<2>());
+        const base::Vector2d poseOffset(curPose.position - nodePos3.head<2>());
+        const RobotFootprint::Mask *mask = findMask(poseOffset, curPose.orientation);
 
         bool hasObstacle = false;
         
         node->eachConnectedNode([&] (const maps::grid::TraversabilityNodeBase *neighbor, bool &explandNode, bool &stop){
-            //we need to compute the four edges of a cell and check if any is inside of the robot
-            maps::grid::Vector3d neighborPos;
-            trMap.fromGrid(neighbor->getIndex(), neighborPos, neighbor->getHeight(), false);
-            
-            bool isInsideRobot = false;
-            bool isInsideOuterBox = false;
-            
-            for(const Eigen::Vector2d &ep : edgePositions)
-            {
-                const Eigen::Vector2d edgePos(neighborPos.head<2>() + ep);
-                
-                //translate to center
-                Eigen::Vector2d tp = edgePos - curPose.position;
-                //rotate invers to orientation of robot
-                tp = yawInverse * tp;
-                
-                if(costFunctionBoundingBox.contains(tp))
-                {
-                    isInsideOuterBox = true;
-                    
-                    //it is only inside the robot
-                    if(robotBoundingBox.contains(tp))
-                    {
-                        isInsideRobot = true;
-                        robotStats.updateDistance(neighbor, (nodePos3 - neighborPos).head<2>().norm());
-                        //we continue iteration here, to compute the correct distances of all edges
-                    }
-                    else
-                    {
-                        boundaryStats.updateDistance(neighbor, robotBoundingBox.exteriorDistance(tp));
-                    }
-                }
-            }
-                
-            if(!isInsideOuterBox)
+            const RobotFootprint::Cell cell(classify(mask, poseOffset, yawInverse, node, neighbor));
+
+            if(!cell.insideCorridor)
             {
                 return;
             }
@@ -141,9 +123,15 @@ void ugv_nav4d::PathStatistic::calculateStatistics(const std::vector<const trave
             //further expand node
             explandNode = true;
 
-            if(isInsideRobot)
+            if(cell.boundaryDistance != std::numeric_limits<double>::max())
             {
-                inRobot.insert(neighbor);
+                boundaryStats.updateDistance(neighbor, cell.boundaryDistance);
+            }
+
+            if(cell.insideRobot)
+            {
+                robotStats.updateDistance(neighbor, cell.robotDistance);
+                inRobot.push_back(neighbor);
                 
                 if(neighbor->getType() != maps::grid::TraversabilityNodeBase::TRAVERSABLE)
                 {
@@ -152,6 +140,8 @@ void ugv_nav4d::PathStatistic::calculateStatistics(const std::vector<const trave
                     {
                         if(!debugObstacleName.empty())
                         {
+                        maps::grid::Vector3d neighborPos;
+                        trMap.fromGrid(neighbor->getIndex(), neighborPos, neighbor->getHeight(), false);
                         V3DD::DRAW_ARROW(debugObstacleName,
                                          neighborPos,
                                          Eigen::Quaterniond(Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitX())), Eigen::Vector3d(.3, 0.3, 0.8), V3DD::Color::red);
@@ -165,7 +155,7 @@ void ugv_nav4d::PathStatistic::calculateStatistics(const std::vector<const trave
                 return;
             }
             
-            inBoundary.insert(neighbor);
+            inBoundary.push_back(neighbor);
             
         });
         /*
@@ -185,9 +175,14 @@ void ugv_nav4d::PathStatistic::calculateStatistics(const std::vector<const trave
             break;
     }
 
+    std::sort(inRobot.begin(), inRobot.end());
+    inRobot.erase(std::unique(inRobot.begin(), inRobot.end()), inRobot.end());
+    std::sort(inBoundary.begin(), inBoundary.end());
+    inBoundary.erase(std::unique(inBoundary.begin(), inBoundary.end()), inBoundary.end());
+
     for(const maps::grid::TraversabilityNodeBase* n : inBoundary)
     {
-        if(inRobot.find(n) == inRobot.end())
+        if(!std::binary_search(inRobot.begin(), inRobot.end(), n))
         {
             boundaryStats.updateStatistic(n);
         }
@@ -200,29 +195,51 @@ void ugv_nav4d::PathStatistic::calculateStatistics(const std::vector<const trave
 
 }
 
+bool ugv_nav4d::PathStatistic::calculateSweptStatistics(const std::vector<SweptCell>& sweptFootprint,
+                                                       const std::vector<const traversability_generator3d::TravGenNode*>& path,
+                                                       const maps::grid::Index& startIndex)
+{
+    std::vector<const traversability_generator3d::TravGenNode*> nodes(sweptFootprint.size(), nullptr);
+
+    for(size_t i = 0; i < sweptFootprint.size(); ++i)
+    {
+        const SweptCell &cell(sweptFootprint[i]);
+        const traversability_generator3d::TravGenNode *node = nullptr;
+        if(cell.parent < 0)
+        {
+            assert(cell.step < (int)path.size());
+            node = path[cell.step];
+        }
+        else if(nodes[cell.parent])
+        {
+            node = nodes[cell.parent]->getConnectedNode(startIndex + cell.cell);
+        }
+
+        //not reachable from the path, same as for the flood fill in calculateStatistics()
+        if(!node)
+            continue;
+        nodes[i] = node;
+
+        if(cell.insideRobot)
+        {
+            robotStats.updateStatistic(node);
+            if(node->getType() != maps::grid::TraversabilityNodeBase::TRAVERSABLE)
+                return false;
+        }
+        else
+        {
+            boundaryStats.updateDistance(node, cell.boundaryDistance);
+            boundaryStats.updateStatistic(node);
+        }
+    }
+    return true;
+}
+
 bool ugv_nav4d::PathStatistic::isPathFeasible(const std::vector<const traversability_generator3d::TravGenNode* >& path, 
                                                    const std::vector< base::Pose2D >& poses, 
                                                    const maps::grid::TraversabilityMap3d<traversability_generator3d::TravGenNode *> &trMap)
 {    
     assert(path.size() == poses.size());
- 
-    const Eigen::Vector2d travGridResolution(config.gridResolution, config.gridResolution);
-
-    Eigen::Vector2d halfRobotDimension(config.robotSizeX / 2.0, config.robotSizeY/2.0);
-    Eigen::Vector2d halfOuterBoxDimension(halfRobotDimension + Eigen::Vector2d::Constant(config.costFunctionDist));
-    
-    std::vector<Eigen::Vector2d> edgePositions = {
-        Eigen::Vector2d(- config.gridResolution /2.0, - config.gridResolution / 2.0),
-        Eigen::Vector2d(- config.gridResolution / 2.0, config.gridResolution / 2.0),
-        Eigen::Vector2d(config.gridResolution / 2.0, config.gridResolution / 2.0),
-        Eigen::Vector2d(config.gridResolution / 2.0, -config.gridResolution / 2.0)
-    };
-    
-    Eigen::AlignedBox<double, 2> robotBoundingBox(- halfRobotDimension, halfRobotDimension);
-    Eigen::AlignedBox<double, 2> costFunctionBoundingBox(- halfOuterBoxDimension, halfOuterBoxDimension);
-
-    std::unordered_set<const maps::grid::TraversabilityNodeBase*> inRobot;
-    std::unordered_set<const maps::grid::TraversabilityNodeBase*> inBoundary;
 
     for(size_t i = 0; i < path.size(); i++)
     {
@@ -232,41 +249,15 @@ bool ugv_nav4d::PathStatistic::isPathFeasible(const std::vector<const traversabi
         const Eigen::Rotation2D<double> yawInverse(Eigen::Rotation2D<double>(curPose.orientation).inverse());
 
         maps::grid::Vector3d nodePos3 = node->getPosition(trMap);
-        const maps::grid::Vector2d nodePos(nodePos3.head<2>());
+        const base::Vector2d poseOffset(curPose.position - nodePos3.head<2>());
+        const RobotFootprint::Mask *mask = findMask(poseOffset, curPose.orientation);
 
         bool hasObstacle = false;
  
         node->eachConnectedNode([&] (const maps::grid::TraversabilityNodeBase *neighbor, bool &explandNode, bool &stop){
-            //we need to compute the four edges of a cell and check if any is inside of the robot
-            maps::grid::Vector3d neighborPos;
-            trMap.fromGrid(neighbor->getIndex(), neighborPos, neighbor->getHeight(), false);
-            
-            bool isInsideRobot = false;
-            bool isInsideOuterBox = false;
-            
-            for(const Eigen::Vector2d &ep : edgePositions)
-            {
-                const Eigen::Vector2d edgePos(neighborPos.head<2>() + ep);
-                
-                //translate to center
-                Eigen::Vector2d tp = edgePos - curPose.position;
-                //rotate invers to orientation of robot
-                tp = yawInverse * tp;
-                
-                if(costFunctionBoundingBox.contains(tp))
-                {
-                    isInsideOuterBox = true;
-                    
-                    //it is only inside the robot
-                    if(robotBoundingBox.contains(tp))
-                    {
-                        isInsideRobot = true;
-                        break;
-                    }
-                }
-            }
-                
-            if(!isInsideOuterBox)
+            const RobotFootprint::Cell cell(classify(mask, poseOffset, yawInverse, node, neighbor));
+
+            if(!cell.insideCorridor)
             {
                 return;
             }
@@ -274,7 +265,7 @@ bool ugv_nav4d::PathStatistic::isPathFeasible(const std::vector<const traversabi
             //further expand node
             explandNode = true;
 
-            if(isInsideRobot)
+            if(cell.insideRobot)
             {
                if(neighbor->getType() != maps::grid::TraversabilityNodeBase::TRAVERSABLE)
                 {
@@ -290,4 +281,4 @@ bool ugv_nav4d::PathStatistic::isPathFeasible(const std::vector<const traversabi
             return false;
     }
     return true;
-}
\ No newline at end of file
+}
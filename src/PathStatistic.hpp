@@ -3,6 +3,9 @@
 #include <traversability_generator3d/TravGenNode.hpp>
 #include <traversability_generator3d/TraversabilityConfig.hpp>
 #include <base/Pose.hpp>
+#include <memory>
+#include "RobotFootprint.hpp"
+#include "PreComputedMotions.hpp"
 
 namespace ugv_nav4d
 {
@@ -13,6 +16,22 @@ namespace ugv_nav4d
 class PathStatistic
 {
     const traversability_generator3d::TraversabilityConfig &config;
+    /** Used if no matching footprint was given to the constructor */
+    std::unique_ptr<RobotFootprint> ownFootprint;
+    const RobotFootprint *footprint;
+    /** Poses that have been checked with a precomputed mask and with the geometric check */
+    size_t maskLookups;
+    size_t geometricChecks;
+
+    /** RobotFootprint::findMask() that counts the lookups and fallbacks */
+    const RobotFootprint::Mask *findMask(const base::Vector2d& poseOffset, double orientation);
+
+    /** @return the classification of @p neighbor relative to the robot standing on @p node with @p mask.
+     *          Falls back to the geometric check if there is no precomputed mask for the pose */
+    RobotFootprint::Cell classify(const RobotFootprint::Mask *mask, const base::Vector2d& poseOffset,
+                                  const Eigen::Rotation2D<double>& yawInverse,
+                                  const maps::grid::TraversabilityNodeBase *node,
+                                  const maps::grid::TraversabilityNodeBase *neighbor) const;
 public:
     
     class Stats
@@ -50,7 +69,9 @@ protected:
     Stats boundaryStats;
 public:
     
-    PathStatistic(const traversability_generator3d::TraversabilityConfig &config);
+    /** @param footprint Precomputed robot footprint. Only used if it matches @p config.
+     *                   Needs to outlive this object. */
+    PathStatistic(const traversability_generator3d::TraversabilityConfig &config, const RobotFootprint *footprint = nullptr);
     
     /**
      * Accumulates statistics about all patches that are inside a config.costFunctionDist wide corridor around @p path.
@@ -74,6 +95,20 @@ public:
     bool isPathFeasible(const std::vector<const traversability_generator3d::TravGenNode*> &path, const std::vector<base::Pose2D> &poses, 
                              const maps::grid::TraversabilityMap3d<traversability_generator3d::TravGenNode *> &trMap);                             
     
+    /**
+     * Same as calculateStatistics() for the poses of Motion::intermediateStepsObstMap, but uses the
+     * precomputed Motion::sweptFootprint instead of checking every pose separately.
+     * Stops at the first obstacle inside the robot. Robot distances are not computed.
+     *
+     * @param sweptFootprint Motion::sweptFootprint of the motion
+     * @param path Obstacle map nodes of Motion::intermediateStepsObstMap
+     * @param startIndex Index of the start cell of the motion
+     * @return false if an obstacle is inside the robot at any pose
+     */
+    bool calculateSweptStatistics(const std::vector<SweptCell> &sweptFootprint,
+                                  const std::vector<const traversability_generator3d::TravGenNode*> &path,
+                                  const maps::grid::Index &startIndex);
+
     const Stats &getRobotStats() const
     {
         return robotStats;
@@ -83,6 +118,18 @@ public:
     {
         return boundaryStats;
     }
+
+    /** @return number of poses that have been checked with a precomputed footprint mask */
+    size_t getNumMaskLookups() const
+    {
+        return maskLookups;
+    }
+
+    /** @return number of poses without a precomputed mask. Their cells are classified geometrically */
+    size_t getNumGeometricChecks() const
+    {
+        return geometricChecks;
+    }
     
 };
 
@@ -1,15 +1,19 @@
 #include "Planner.hpp"
 #include <sbpl/planners/araplanner.h>
+#include <sbpl/planners/lazyARA.h>
 #include <sbpl/utils/mdpconfig.h>
 #include <maps/grid/MultiLevelGridMap.hpp>
 #include <vizkit3d_debug_drawings/DebugDrawing.hpp>
 #include <vizkit3d_debug_drawings/DebugDrawingColors.hpp>
 #include <base/Eigen.hpp>
 #include "PlannerDump.hpp"
+#include "DumpWriter.hpp"
 #include <omp.h>
+#include <sys/resource.h>
 #include <cmath>
 #include <base-logging/Logging.hpp>
-#include "Logger.hpp"
+#include "Trace.hpp"
+#include "ChromeTrace.hpp"
 
 using namespace maps::grid;
 using trajectory_follower::SubTrajectory;
@@ -61,8 +65,8 @@ bool Planner::calculateGoal(const Eigen::Vector3d& start_translation, Eigen::Vec
     else {
         bool is_invalid = true;
         const double start_angle = std::atan2(start_translation.y() - goal_translation.y(), start_translation.x() - goal_translation.x());
-        LOG_PLAN("start_angle", start_angle);
-        LOG_PLAN("goal", goal_translation);
+        UGV_NAV4D_TRACE(DEBUG, "calculateGoal: start_angle", {start_angle});
+        UGV_NAV4D_TRACE(DEBUG, "calculateGoal: goal (x, y, z)", {goal_translation.x(), goal_translation.y(), goal_translation.z()});
 
         double current_radius = mobility.searchProgressSteps;
         double theta = start_angle;
@@ -70,7 +74,7 @@ bool Planner::calculateGoal(const Eigen::Vector3d& start_translation, Eigen::Vec
         int multiplier = 1;
         Eigen::Vector2d pos(0, 0);
         while(is_invalid) {
-            LOG_PLAN("translation change", pos.x(), pos.y());
+            UGV_NAV4D_TRACE(DEBUG, "calculateGoal: translation change (x, y)", {pos.x(), pos.y()});
             Eigen::Vector3d temp = goal_translation;
             temp.x() += pos.x();
             temp.y() += pos.y();
@@ -92,7 +96,7 @@ bool Planner::calculateGoal(const Eigen::Vector3d& start_translation, Eigen::Vec
             if(std::abs(theta_pi - EIGEN_PI) < std::numeric_limits<double>::epsilon()) {
                 current_radius += mobility.searchProgressSteps;
                 theta_pi = 0;
-                LOG_PLAN("reset theta", theta_pi);
+                UGV_NAV4D_TRACE(DEBUG, "calculateGoal: reset theta", {theta_pi});
 
                 // do we have reached our max. search radius?
                 if(current_radius > mobility.searchRadius) {
@@ -108,7 +112,7 @@ bool Planner::calculateGoal(const Eigen::Vector3d& start_translation, Eigen::Vec
                 theta = std::remainder(start_angle - theta_pi, 2 * EIGEN_PI);
                 multiplier = 1;
             }
-            LOG_PLAN("Calc pos", current_radius, theta);
+            UGV_NAV4D_TRACE(DEBUG, "calculateGoal: calc pos (radius, theta)", {current_radius, theta});
             // calculate new position
             pos.y() = current_radius * std::sin(theta);
             pos.x() = current_radius * std::cos(theta);
@@ -137,6 +141,87 @@ Planner::PLANNING_RESULT Planner::plan(const base::Time& maxTime, const base::sa
                                        std::vector<SubTrajectory>& resultTrajectory3D,
                                        bool dumpOnError, bool dumpOnSuccess)
 {
+    statistics = PlannerStatistics();
+    if(env)
+        env->setCollectStatistics(plannerConfig.collectStatistics);
+
+    PLANNING_RESULT result;
+    {
+        //stops the recording even if planInternal() throws
+        ChromeTraceRecording recording(plannerConfig.recordChromeTrace, plannerConfig.chromeTraceSampleInterval);
+        ScopedTimer timer(plannerConfig.collectStatistics, statistics.totalTime);
+        ChromeTraceSpan span("plan", "plan");
+        result = planInternal(maxTime, start_pose, end_pose, resultTrajectory2D, resultTrajectory3D, dumpOnError, dumpOnSuccess);
+    }
+
+    if(env)
+    {
+        //counters of the search are kept by the environment, the phases are measured here
+        PlannerStatistics envStatistics = env->getStatistics();
+        envStatistics.expandMapTime = statistics.expandMapTime;
+        envStatistics.setStartTime = statistics.setStartTime;
+        envStatistics.setGoalTime = statistics.setGoalTime;
+        envStatistics.searchTime = statistics.searchTime;
+        envStatistics.getTrajectoryTime = statistics.getTrajectoryTime;
+        envStatistics.totalTime = statistics.totalTime;
+        envStatistics.expands = statistics.expands;
+        envStatistics.solutionCost = statistics.solutionCost;
+        statistics = envStatistics;
+    }
+
+    if(plannerConfig.collectStatistics)
+    {
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+            //kilobytes on linux
+            statistics.peakMemory = static_cast<size_t>(usage.ru_maxrss) * 1024;
+        }
+    }
+    return result;
+}
+
+const PlannerStatistics& Planner::getStatistics() const
+{
+    return statistics;
+}
+
+std::vector<PlannerStats> Planner::getSearchStats() const
+{
+    std::vector<PlannerStats> stats;
+    if(ARAPlanner *araPlanner = dynamic_cast<ARAPlanner *>(planner.get()))
+        araPlanner->get_search_stats(&stats);
+    else if(LazyARAPlanner *lazyPlanner = dynamic_cast<LazyARAPlanner *>(planner.get()))
+        lazyPlanner->get_search_stats(&stats);
+    return stats;
+}
+
+void Planner::traceSearchIterations(const std::vector<PlannerStats>& stats, uint64_t searchBegin, uint64_t searchEnd) const
+{
+    //sbpl only reports the duration of the iterations. They are laid out back to back from the
+    //start of the search and scaled down if they do not fit (ARA* measures processor time)
+    double totalTime = 0;
+    for(const PlannerStats &s : stats)
+        totalTime += s.time;
+    const double searchTime = (searchEnd - searchBegin) * 1e-9;
+    const double scale = totalTime > searchTime ? searchTime / totalTime : 1.0;
+
+    uint64_t begin = searchBegin;
+    for(const PlannerStats &s : stats)
+    {
+        const uint64_t end = begin + static_cast<uint64_t>(s.time * scale * 1e9);
+        ChromeTrace::instance().addSpan("ARA* iteration", "search", begin, end,
+                                        {{"eps", s.eps}, {"expands", double(s.expands)}, {"cost", double(s.cost)}});
+        begin = end;
+    }
+}
+
+Planner::PLANNING_RESULT Planner::planInternal(const base::Time& maxTime, const base::samples::RigidBodyState& start_pose,
+                                               const base::samples::RigidBodyState& end_pose,
+                                               std::vector<SubTrajectory>& resultTrajectory2D,
+                                               std::vector<SubTrajectory>& resultTrajectory3D,
+                                               bool dumpOnError, bool dumpOnSuccess)
+{
 
     LOG_INFO_S << "Planning with " << plannerConfig.numThreads << " threads";
     omp_set_num_threads(plannerConfig.numThreads);
@@ -154,7 +239,12 @@ Planner::PLANNING_RESULT Planner::plan(const base::Time& maxTime, const base::sa
     env->clear();
 
     if(!planner)
-        planner.reset(new ARAPlanner(env.get(), true));
+    {
+        if(plannerConfig.useLazyEvaluation)
+            planner.reset(new LazyARAPlanner(env.get(), true));
+        else
+            planner.reset(new ARAPlanner(env.get(), true));
+    }
 
 
     Eigen::Affine3d ground2Body(Eigen::Affine3d::Identity());
@@ -178,33 +268,45 @@ Planner::PLANNING_RESULT Planner::plan(const base::Time& maxTime, const base::sa
     //TODO maybe use a deque and limit to last 30 starts?
     previousStartPositions.push_back(startGround2Mls.translation());
 
-    env->expandMap(previousStartPositions);
+    {
+        ScopedTimer timer(plannerConfig.collectStatistics, statistics.expandMapTime);
+        ChromeTraceSpan span("expandMap", "plan");
+        env->expandMap(previousStartPositions);
+    }
     if(travMapCallback)
         travMapCallback();
     try
     {
+        ScopedTimer timer(plannerConfig.collectStatistics, statistics.setStartTime);
+        ChromeTraceSpan span("setStart", "plan");
         env->setStart(startGround2Mls.translation(), base::getYaw(Eigen::Quaterniond(startGround2Mls.linear())));
     }
     catch(const ugv_nav4d::ObstacleCheckFailed& ex)
     {
         LOG_INFO_S << "Start inside obstacle.";
         if(dumpOnError)
-            PlannerDump dump(*this, "start_inside_obstacle", maxTime, startbody2Mls, endbody2Mls);
+            writeDump("start_inside_obstacle", maxTime, startbody2Mls, endbody2Mls);
         return START_INVALID;
     }
     catch(const std::runtime_error& ex)
     {
         if(dumpOnError)
-            PlannerDump dump(*this, "bad_start", maxTime, startbody2Mls, endbody2Mls);
+            writeDump("bad_start", maxTime, startbody2Mls, endbody2Mls);
         return START_INVALID;
     }
 
     Eigen::Vector3d start_translation = startGround2Mls.translation();
     Eigen::Vector3d goal_translation = endGround2Mls.translation();
 
-    if(!calculateGoal(startGround2Mls.translation(), goal_translation, base::getYaw(Eigen::Quaterniond(endGround2Mls.linear())))) {
+    bool goalValid;
+    {
+        ScopedTimer timer(plannerConfig.collectStatistics, statistics.setGoalTime);
+        ChromeTraceSpan span("setGoal", "plan");
+        goalValid = calculateGoal(startGround2Mls.translation(), goal_translation, base::getYaw(Eigen::Quaterniond(endGround2Mls.linear())));
+    }
+    if(!goalValid) {
         if(dumpOnError) {
-            PlannerDump dump(*this, "bad_goal", maxTime, startbody2Mls, endbody2Mls);
+            writeDump("bad_goal", maxTime, startbody2Mls, endbody2Mls);
         }
         return GOAL_INVALID;
     }
@@ -241,31 +343,47 @@ Planner::PLANNING_RESULT Planner::plan(const base::Time& maxTime, const base::sa
     try
     {
         LOG_INFO_S << "Initial Epsilon: " << plannerConfig.initialEpsilon << ", steps: " << plannerConfig.epsilonSteps;
-        planner->set_eps_step(plannerConfig.epsilonSteps);
+        ARAPlanner *araPlanner = dynamic_cast<ARAPlanner *>(planner.get());
+        if(araPlanner)
+            araPlanner->set_eps_step(plannerConfig.epsilonSteps);
         planner->set_initialsolution_eps(plannerConfig.initialEpsilon);
 
         solutionIds.clear();
-        if(!planner->replan(maxTime.toSeconds(), &solutionIds))
+        bool solutionFound;
+        const uint64_t searchBegin = ChromeTrace::now();
+        {
+            ScopedTimer timer(plannerConfig.collectStatistics, statistics.searchTime);
+            ChromeTraceSpan span("search", "plan");
+            solutionFound = planner->replan(maxTime.toSeconds(), &solutionIds);
+        }
+        const uint64_t searchEnd = ChromeTrace::now();
+        statistics.expands = planner->get_n_expands();
+        const std::vector<PlannerStats> searchStats = getSearchStats();
+        if(ChromeTrace::instance().isRecording())
+            traceSearchIterations(searchStats, searchBegin, searchEnd);
+        if(!solutionFound)
         {
             LOG_INFO_S << "num expands: " << planner->get_n_expands();
             if(dumpOnError)
-                PlannerDump dump(*this, "no_solution", maxTime, startbody2Mls, endbody2Mls);
+                writeDump("no_solution", maxTime, startbody2Mls, endbody2Mls);
             return NO_SOLUTION;
         }
 
         LOG_INFO_S << "num expands: " << planner->get_n_expands();
         LOG_INFO_S << "Epsilon is " << planner->get_final_epsilon();
 
-        std::vector<PlannerStats> stats;
-
-        planner->get_search_stats(&stats);
+        //the last iteration found the best solution
+        if(!searchStats.empty())
+            statistics.solutionCost = searchStats.back().cost;
 
         LOG_INFO_S << "Stats";
-        for(const PlannerStats &s: stats)
+        for(const PlannerStats &s: searchStats)
         {
             LOG_INFO_S << "cost " << s.cost << " time " << s.time << "num childs " << s.expands;
         }
 
+        ScopedTimer timer(plannerConfig.collectStatistics, statistics.getTrajectoryTime);
+        ChromeTraceSpan span("getTrajectory", "plan");
         env->getTrajectory(solutionIds, resultTrajectory2D, true, start_translation, goal_translation, end_pose.getYaw(), ground2Body);
         env->getTrajectory(solutionIds, resultTrajectory3D, false, start_translation, goal_translation,end_pose.getYaw(), ground2Body);
     }
@@ -274,16 +392,52 @@ Planner::PLANNING_RESULT Planner::plan(const base::Time& maxTime, const base::sa
         LOG_ERROR_S << "caught sbpl exception: " << ex.what();
         LOG_ERROR_S << "dumping state";
         if(dumpOnError)
-            PlannerDump dump(*this, "no_solution", maxTime, startbody2Mls, endbody2Mls);
+            writeDump("no_solution", maxTime, startbody2Mls, endbody2Mls);
         return NO_SOLUTION;
     }
 
     if(dumpOnSuccess)
-        PlannerDump dump(*this, "success", maxTime, startbody2Mls, endbody2Mls);
+        writeDump("success", maxTime, startbody2Mls, endbody2Mls);
 
     return FOUND_SOLUTION;
 }
 
+void Planner::writeDump(const std::string& filePostfix, const base::Time& maxTime, const base::samples::RigidBodyState& startbody2Mls,
+                        const base::samples::RigidBodyState& endbody2Mls)
+{
+    ChromeTraceSpan span("captureDump", "plan");
+    getDumpWriter().push(PlannerDump::capture(*this, filePostfix, maxTime, startbody2Mls, endbody2Mls));
+}
+
+DumpWriter& Planner::getDumpWriter()
+{
+    if(!dumpWriter)
+        dumpWriter = std::make_shared<DumpWriter>();
+    return *dumpWriter;
+}
+
+void Planner::flushDumps()
+{
+    if(dumpWriter)
+        dumpWriter->flush();
+}
+
+void Planner::saveExpandedMaps(std::ostream& out) const
+{
+    if(!env)
+        throw std::runtime_error("Planner::saveExpandedMaps : No map was set");
+    env->saveExpandedMaps(out);
+}
+
+void Planner::loadExpandedMaps(std::istream& in)
+{
+    if(!env)
+        throw std::runtime_error("Planner::loadExpandedMaps : No map was set");
+    env->loadExpandedMaps(in);
+    if(travMapCallback)
+        travMapCallback();
+}
+
 std::vector< Motion > Planner::getMotions() const
 {
     return env->getMotions(solutionIds);
@@ -329,6 +483,9 @@ void Planner::setTravConfig(const traversability_generator3d::TraversabilityConf
 
  void Planner::setPlannerConfig(const PlannerConfig& config)
  {
+     //the search algorithm changes, it is created again during the next plan()
+     if(config.useLazyEvaluation != plannerConfig.useLazyEvaluation)
+         planner.reset();
      plannerConfig = config;
  }
 
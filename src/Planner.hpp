@@ -5,15 +5,18 @@
 #include "EnvironmentXYZTheta.hpp"
 #include <trajectory_follower/SubTrajectory.hpp>
 #include "PlannerConfig.hpp"
+#include "PlannerStatistics.hpp"
+#include <sbpl/planners/planner.h>
 
 #include <memory>
 
-class ARAPlanner;
+class SBPLPlanner;
 
 namespace ugv_nav4d
 {
 
 class PlannerDump;
+class DumpWriter;
     
 class Planner
 {
@@ -21,18 +24,22 @@ protected:
     friend class PlannerDump;
     typedef EnvironmentXYZTheta::MLGrid MLSBase;
     std::shared_ptr<EnvironmentXYZTheta> env;
-    std::shared_ptr<ARAPlanner> planner;
+    std::shared_ptr<SBPLPlanner> planner;
     
     const sbpl_spline_primitives::SplinePrimitivesConfig splinePrimitiveConfig; 
     const Mobility mobility;
     traversability_generator3d::TraversabilityConfig traversabilityConfig;
     PlannerConfig plannerConfig;
     std::vector<int> solutionIds;
+    PlannerStatistics statistics;
     
     std::function<void ()> travMapCallback;
     
     /**are buffered and reused for a more robust map generation */
     std::vector<Eigen::Vector3d> previousStartPositions;
+
+    /** writes the dumps requested by plan(), created on first use */
+    std::shared_ptr<DumpWriter> dumpWriter;
     
 public:
     enum PLANNING_RESULT {
@@ -117,7 +124,7 @@ public:
      * @param resultTrajectory3D The resulting trajectory. Make sure to read the comment for @p resultTrajectory2D to understand
      *                           why this exists!
      * @param dumpOnError If true a planner dump will be written in case of error. This dump can be loaded and analyzed later
-     *                    using the ugv_nav4d_replay tool.
+     *                    using the ugv_nav4d_replay tool. Dumps are written asynchronously, see getDumpWriter().
      * @param dumpOnSuccess If true a planner dump will be written in case of successful planning. This dump can be loaded and analyzed later
      *                    using the ugv_nav4d_replay tool.
      * @return An enum indicating the planner state
@@ -129,6 +136,26 @@ public:
     void setTravConfig(const traversability_generator3d::TraversabilityConfig& config);
     
     void setPlannerConfig(const PlannerConfig& config);
+
+    /** @return timers and counters of the last plan() call.
+     *          The timers are only filled if PlannerConfig::collectStatistics is set */
+    const PlannerStatistics& getStatistics() const;
+
+    /** @return the writer of the dumps requested by plan(). plan() only captures a snapshot of its input,
+     *          the file is written on the thread of the writer */
+    DumpWriter& getDumpWriter();
+
+    /** Blocks until all dumps requested by plan() have been written */
+    void flushDumps();
+
+    /** Writes the expanded traversability and obstacle map, see EnvironmentXYZTheta::saveExpandedMaps().
+     *  @throw std::runtime_error if no map was set */
+    void saveExpandedMaps(std::ostream& out) const;
+
+    /** Replaces the expanded maps by maps that have been saved for the current mls map. plan() only
+     *  expands the parts of the map that are missing, e.g. to replay only the search of a dump.
+     *  @throw std::runtime_error if no map was set or the maps do not fit to the mls map */
+    void loadExpandedMaps(std::istream& in);
     
     const maps::grid::TraversabilityMap3d<traversability_generator3d::TravGenNode*> &getTraversabilityMap() const;
 
@@ -138,6 +165,21 @@ public:
             const Eigen::Affine3d& ground2Body);
 
     private:
+    /** plan() without the collection of the statistics */
+    PLANNING_RESULT planInternal(const base::Time& maxTime, const base::samples::RigidBodyState& start_pose,
+                                 const base::samples::RigidBodyState& end_pose, std::vector<trajectory_follower::SubTrajectory>& resultTrajectory2D,
+                                 std::vector<trajectory_follower::SubTrajectory>& resultTrajectory3D, bool dumpOnError, bool dumpOnSuccess);
+
+    /** Queues a dump of the current planner input. Does not block on i/o, the dump is dropped if the queue is full */
+    void writeDump(const std::string& filePostfix, const base::Time& maxTime, const base::samples::RigidBodyState& startbody2Mls,
+                   const base::samples::RigidBodyState& endbody2Mls);
+
+    /** @return the statistics of the ARA* iterations of the last search */
+    std::vector<PlannerStats> getSearchStats() const;
+
+    /** Adds the ARA* iterations @p stats to the chrome trace */
+    void traceSearchIterations(const std::vector<PlannerStats>& stats, uint64_t searchBegin, uint64_t searchEnd) const;
+
     bool calculateGoal(const Eigen::Vector3d& start_translation, Eigen::Vector3d& goal_translation, const double yaw) noexcept;
     bool tryGoal(const Eigen::Vector3d& translation, const double yaw) noexcept;
 
@@ -20,5 +20,20 @@ struct PlannerConfig
     double epsilonSteps = 2.0;
     /** Number of threads to use during planning */
     unsigned numThreads = 1;
+    /** Use Lazy ARA* instead of ARA*. Successors are generated using the cheap check on the
+     *  traversability map only. The expensive checks on the obstacle map (and the path statistics)
+     *  are only done for edges that the search actually wants to use.
+     *  See SBPL documentation of LazyARAPlanner */
+    bool useLazyEvaluation = false;
+    /** Measure the time spent in the different planning phases, see Planner::getStatistics() */
+    bool collectStatistics = false;
+    /** Record a chrome trace event file of every plan() call, see ChromeTrace.
+     *  Can also be enabled by setting the environment variable UGV_NAV4D_CHROME_TRACE */
+    bool recordChromeTrace = false;
+    /** Only every n-th successor generation is recorded in the chrome trace */
+    unsigned chromeTraceSampleInterval = 16;
+    /** Store the expanded traversability and obstacle map in planner dumps. Replays can skip the
+     *  map expansion, but the maps are serialized on the planning thread when the dump is captured */
+    bool dumpExpandedMaps = false;
 };
 }
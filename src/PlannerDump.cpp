@@ -1,23 +1,369 @@
 #include "PlannerDump.hpp"
 #include "Planner.hpp"
+#include "MappedFile.hpp"
 #define WRITE(X) output.write(reinterpret_cast<const char*>(&X), sizeof X)
 #define READ(X)  input.read(reinterpret_cast<char*>(&X), sizeof X)
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
+#include <boost/crc.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <cstring>
 #include <fstream>
+#include <map>
+#include <sstream>
+#include <type_traits>
+#include <vector>
 #include <base-logging/Logging.hpp>
+#ifdef UGV_NAV4D_USE_ZSTD
+#include <zstd.h>
+#endif
 
-ugv_nav4d::PlannerDump::PlannerDump(const std::string& dumpName)
+namespace
+{
+
+const char dumpMagic[8] = {'U', 'G', 'V', '4', 'D', 'U', 'M', 'P'};
+const uint32_t dumpVersion = 2;
+const size_t headerSize = 16;
+const size_t sectionEntrySize = 40;
+
+enum SectionId : uint32_t
+{
+    CONFIG_SECTION = 1,
+    MLS_SECTION = 2,
+    MAPS_SECTION = 3,
+};
+
+enum RecordType : uint8_t
+{
+    DOUBLE_RECORD = 0,
+    INT_RECORD = 1,
+    BOOL_RECORD = 2,
+};
+
+/** Layout of PlannerConfig in dumps of the old format */
+struct LegacyPlannerConfig
+{
+    bool usePathStatistics;
+    bool searchUntilFirstSolution;
+    double initialEpsilon;
+    double epsilonSteps;
+    unsigned numThreads;
+};
+
+void putU32(std::string& out, uint32_t value)
+{
+    for(int i = 0; i < 4; ++i)
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+void putU64(std::string& out, uint64_t value)
+{
+    for(int i = 0; i < 8; ++i)
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+uint32_t getU32(const char *data)
+{
+    uint32_t value = 0;
+    for(int i = 0; i < 4; ++i)
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    return value;
+}
+
+uint64_t getU64(const char *data)
+{
+    uint64_t value = 0;
+    for(int i = 0; i < 8; ++i)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    return value;
+}
+
+uint32_t computeChecksum(const char *data, size_t size)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(data, size);
+    return crc.checksum();
+}
+
+uint64_t doubleToBits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return bits;
+}
+
+double bitsToDouble(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+/** Appends every visited parameter as named record to data */
+class RecordWriter
+{
+public:
+    std::string data;
+
+    template <class T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type operator()(const char *name, const T& value)
+    {
+        append(name, DOUBLE_RECORD, doubleToBits(value));
+    }
+
+    /** integers, bools and enums */
+    template <class T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type operator()(const char *name, const T& value)
+    {
+        append(name, std::is_same<T, bool>::value ? BOOL_RECORD : INT_RECORD, static_cast<uint64_t>(static_cast<int64_t>(value)));
+    }
+
+private:
+    void append(const char *name, RecordType type, uint64_t value)
+    {
+        const size_t nameLength = std::strlen(name);
+        data.push_back(static_cast<char>(nameLength));
+        data.append(name, nameLength);
+        data.push_back(static_cast<char>(type));
+        putU64(data, value);
+    }
+};
+
+/** Sets every visited parameter that is contained in the records */
+class RecordReader
+{
+public:
+    /** @throw std::runtime_error if the records are truncated */
+    RecordReader(const char *data, size_t size)
+    {
+        size_t pos = 0;
+        while(pos < size)
+        {
+            const size_t nameLength = static_cast<unsigned char>(data[pos]);
+            if(pos + 1 + nameLength + 9 > size)
+                throw std::runtime_error("PlannerDump: Truncated config record");
+            const std::string name(data + pos + 1, nameLength);
+            pos += 1 + nameLength;
+            records[name] = std::make_pair(static_cast<uint8_t>(data[pos]), getU64(data + pos + 1));
+            pos += 9;
+        }
+    }
+
+    template <class T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type operator()(const char *name, T& value) const
+    {
+        const Record *record = find(name);
+        if(record)
+            value = static_cast<T>(record->first == DOUBLE_RECORD ? bitsToDouble(record->second) : static_cast<int64_t>(record->second));
+    }
+
+    /** integers, bools and enums */
+    template <class T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type operator()(const char *name, T& value) const
+    {
+        const Record *record = find(name);
+        if(record)
+            value = static_cast<T>(record->first == DOUBLE_RECORD ? static_cast<int64_t>(bitsToDouble(record->second)) : static_cast<int64_t>(record->second));
+    }
+
+private:
+    /** type and value */
+    typedef std::pair<uint8_t, uint64_t> Record;
+
+    const Record *find(const char *name) const
+    {
+        const auto it = records.find(name);
+        if(it == records.end())
+        {
+            LOG_WARN_S << "PlannerDump: " << name << " is not contained in the dump, using default";
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    std::map<std::string, Record> records;
+};
+
+/** Calls @p visit for every parameter that is stored in a dump.
+ *  New parameters can be added at any place, old dumps will use the default value */
+template <class Visitor>
+void visitParameters(Visitor& visit, traversability_generator3d::TraversabilityConfig& trav,
+                     sbpl_spline_primitives::SplinePrimitivesConfig& spline, ugv_nav4d::Mobility& mobility,
+                     ugv_nav4d::PlannerConfig& planner, base::Pose& start, base::Pose& goal, double& maxTime)
+{
+    visit("trav.maxStepHeight", trav.maxStepHeight);
+    visit("trav.maxSlope", trav.maxSlope);
+    visit("trav.inclineLimittingMinSlope", trav.inclineLimittingMinSlope);
+    visit("trav.inclineLimittingLimit", trav.inclineLimittingLimit);
+    visit("trav.costFunctionDist", trav.costFunctionDist);
+    visit("trav.minTraversablePercentage", trav.minTraversablePercentage);
+    visit("trav.robotHeight", trav.robotHeight);
+    visit("trav.robotSizeX", trav.robotSizeX);
+    visit("trav.robotSizeY", trav.robotSizeY);
+    visit("trav.distToGround", trav.distToGround);
+    visit("trav.slopeMetricScale", trav.slopeMetricScale);
+    visit("trav.slopeMetric", trav.slopeMetric);
+    visit("trav.gridResolution", trav.gridResolution);
+    visit("trav.initialPatchVariance", trav.initialPatchVariance);
+    visit("trav.allowForwardDownhill", trav.allowForwardDownhill);
+    visit("trav.enableInclineLimitting", trav.enableInclineLimitting);
+
+    visit("spline.gridSize", spline.gridSize);
+    visit("spline.numAngles", spline.numAngles);
+    visit("spline.numEndAngles", spline.numEndAngles);
+    visit("spline.destinationCircleRadius", spline.destinationCircleRadius);
+    visit("spline.cellSkipFactor", spline.cellSkipFactor);
+    visit("spline.splineOrder", spline.splineOrder);
+    visit("spline.generateForwardMotions", spline.generateForwardMotions);
+    visit("spline.generateBackwardMotions", spline.generateBackwardMotions);
+    visit("spline.generateLateralMotions", spline.generateLateralMotions);
+    visit("spline.generatePointTurnMotions", spline.generatePointTurnMotions);
+
+    visit("mobility.translationSpeed", mobility.translationSpeed);
+    visit("mobility.rotationSpeed", mobility.rotationSpeed);
+    visit("mobility.minTurningRadius", mobility.minTurningRadius);
+    visit("mobility.spline_sampling_resolution", mobility.spline_sampling_resolution);
+    visit("mobility.remove_goal_offset", mobility.remove_goal_offset);
+    visit("mobility.multiplierForward", mobility.multiplierForward);
+    visit("mobility.multiplierBackward", mobility.multiplierBackward);
+    visit("mobility.multiplierLateral", mobility.multiplierLateral);
+    visit("mobility.multiplierForwardTurn", mobility.multiplierForwardTurn);
+    visit("mobility.multiplierBackwardTurn", mobility.multiplierBackwardTurn);
+    visit("mobility.multiplierPointTurn", mobility.multiplierPointTurn);
+    visit("mobility.multiplierLateralCurve", mobility.multiplierLateralCurve);
+    visit("mobility.searchRadius", mobility.searchRadius);
+    visit("mobility.searchProgressSteps", mobility.searchProgressSteps);
+    visit("mobility.maxMotionCurveLength", mobility.maxMotionCurveLength);
+
+    visit("planner.usePathStatistics", planner.usePathStatistics);
+    visit("planner.searchUntilFirstSolution", planner.searchUntilFirstSolution);
+    visit("planner.initialEpsilon", planner.initialEpsilon);
+    visit("planner.epsilonSteps", planner.epsilonSteps);
+    visit("planner.numThreads", planner.numThreads);
+    visit("planner.useLazyEvaluation", planner.useLazyEvaluation);
+    visit("planner.collectStatistics", planner.collectStatistics);
+    visit("planner.recordChromeTrace", planner.recordChromeTrace);
+    visit("planner.chromeTraceSampleInterval", planner.chromeTraceSampleInterval);
+    visit("planner.dumpExpandedMaps", planner.dumpExpandedMaps);
+
+    visit("start.position.x", start.position.x());
+    visit("start.position.y", start.position.y());
+    visit("start.position.z", start.position.z());
+    visit("start.orientation.w", start.orientation.w());
+    visit("start.orientation.x", start.orientation.x());
+    visit("start.orientation.y", start.orientation.y());
+    visit("start.orientation.z", start.orientation.z());
+    visit("goal.position.x", goal.position.x());
+    visit("goal.position.y", goal.position.y());
+    visit("goal.position.z", goal.position.z());
+    visit("goal.orientation.w", goal.orientation.w());
+    visit("goal.orientation.x", goal.orientation.x());
+    visit("goal.orientation.y", goal.orientation.y());
+    visit("goal.orientation.z", goal.orientation.z());
+    visit("maxTime", maxTime);
+}
+
+}
+
+ugv_nav4d::PlannerDump::Compression ugv_nav4d::PlannerDump::getDefaultCompression()
+{
+#ifdef UGV_NAV4D_USE_ZSTD
+    return Compression::ZSTD;
+#else
+    return Compression::NONE;
+#endif
+}
+
+ugv_nav4d::PlannerDump::PlannerDump(const std::string& dumpName) :
+    fileName(dumpName)
 {
     LOG_INFO_S << "Loading Dump " << dumpName;
-    
+
+    mappedFile = std::make_shared<MappedFile>(dumpName);
+    const char *data = mappedFile->getData();
+    const size_t size = mappedFile->getSize();
+
+    if(size < headerSize || std::memcmp(data, dumpMagic, sizeof dumpMagic) != 0)
+    {
+        mappedFile.reset();
+        loadLegacy(dumpName);
+        return;
+    }
+
+    const uint32_t version = getU32(data + 8);
+    if(version != dumpVersion)
+        throw std::runtime_error("PlannerDump: Unsupported dump version " + std::to_string(version) + " in " + dumpName);
+
+    const uint32_t numSections = getU32(data + 12);
+    if(headerSize + numSections * sectionEntrySize > size)
+        throw std::runtime_error("PlannerDump: Truncated section table in " + dumpName);
+
+    bool hasConfig = false;
+    for(uint32_t i = 0; i < numSections; ++i)
+    {
+        const char *entry = data + headerSize + i * sectionEntrySize;
+        const uint32_t id = getU32(entry);
+        const uint32_t compression = getU32(entry + 4);
+        const uint64_t offset = getU64(entry + 8);
+        const uint64_t storedSize = getU64(entry + 16);
+        const uint64_t rawSize = getU64(entry + 24);
+        const uint32_t checksum = getU32(entry + 32);
+
+        if(offset > size || storedSize > size - offset)
+            throw std::runtime_error("PlannerDump: Truncated section in " + dumpName);
+
+        if(id == CONFIG_SECTION)
+        {
+            if(computeChecksum(data + offset, storedSize) != checksum)
+                throw std::runtime_error("PlannerDump: Checksum mismatch of the config section in " + dumpName);
+            if(compression != static_cast<uint32_t>(Compression::NONE))
+                throw std::runtime_error("PlannerDump: Compressed config section in " + dumpName);
+
+            const RecordReader reader(data + offset, storedSize);
+            base::Pose startPose;
+            base::Pose goalPose;
+            double maxTimeD = 0;
+            visitParameters(reader, traversabilityConfig, splinePrimitiveConfig, mobility, plannerConfig, startPose, goalPose, maxTimeD);
+            start.setPose(startPose);
+            goal.setPose(goalPose);
+            maxTime = base::Time::fromSeconds(maxTimeD);
+            hasConfig = true;
+        }
+        else if(id == MLS_SECTION || id == MAPS_SECTION)
+        {
+            //decoded on demand
+            Section& section(id == MLS_SECTION ? mlsSection : mapsSection);
+            section.compression = static_cast<Compression>(compression);
+            section.offset = offset;
+            section.storedSize = storedSize;
+            section.rawSize = rawSize;
+            section.checksum = checksum;
+            section.present = true;
+        }
+        //sections of newer versions are skipped
+    }
+
+    if(!hasConfig || !mlsSection.present)
+        throw std::runtime_error("PlannerDump: Missing section in " + dumpName);
+}
+
+void ugv_nav4d::PlannerDump::loadLegacy(const std::string& dumpName)
+{
     std::ifstream input(dumpName, std::ios::binary | std::ios::in);
     
     READ(traversabilityConfig);
     READ(mobility);
     READ(splinePrimitiveConfig);
-    READ(plannerConfig);
+    LegacyPlannerConfig legacyConfig;
+    READ(legacyConfig);
+    plannerConfig = PlannerConfig();
+    plannerConfig.usePathStatistics = legacyConfig.usePathStatistics;
+    plannerConfig.searchUntilFirstSolution = legacyConfig.searchUntilFirstSolution;
+    plannerConfig.initialEpsilon = legacyConfig.initialEpsilon;
+    plannerConfig.epsilonSteps = legacyConfig.epsilonSteps;
+    plannerConfig.numThreads = legacyConfig.numThreads;
     base::Pose tmp;
     READ(tmp);
     start.setPose(tmp);
@@ -25,48 +371,211 @@ ugv_nav4d::PlannerDump::PlannerDump(const std::string& dumpName)
     goal.setPose(tmp);
     double maxTimed;
     READ(maxTimed);
+    maxTime = base::Time::fromSeconds(maxTimed);
 
+    mlsMap = std::make_shared<MLSBase>();
     boost::archive::binary_iarchive ia(input);
-    ia >> mlsMap;
+    ia >> *mlsMap;
 }
 
-ugv_nav4d::PlannerDump::PlannerDump(const ugv_nav4d::Planner& planner, const std::string& filePostfix, const base::Time& maxTimeA, const base::samples::RigidBodyState& startbody2Mls, const base::samples::RigidBodyState& endbody2Mls)
+std::pair<const char*, size_t> ugv_nav4d::PlannerDump::decodeSection(const Section& section, const char *sectionName, std::string& buffer) const
 {
-    const std::string targetFile = getUnusedFilename(filePostfix);
-    LOG_INFO_S << "Dumping planner state to: " << targetFile;
-    std::ofstream output(targetFile, std::ios::binary | std::ios::out|std::ios::trunc);
+    if(!mappedFile)
+        throw std::runtime_error(std::string("PlannerDump: The ") + sectionName + " section of a written dump is not kept, load " + fileName + " to access it");
 
-    WRITE(planner.traversabilityConfig);
-    WRITE(planner.mobility);
-    WRITE(planner.splinePrimitiveConfig);
-    WRITE(planner.plannerConfig);
-    base::Pose tmp = startbody2Mls.getPose();
-    WRITE(tmp);
-    tmp = endbody2Mls.getPose();
-    WRITE(tmp);
-    double maxTimeD = maxTimeA.toSeconds();
-    
-    WRITE(maxTimeD);
-    
-    boost::archive::binary_oarchive oa(output);
-    oa << planner.env->getMlsMap();
+    const char *stored = mappedFile->getData() + section.offset;
+    if(computeChecksum(stored, section.storedSize) != section.checksum)
+        throw std::runtime_error(std::string("PlannerDump: Checksum mismatch of the ") + sectionName + " section in " + fileName);
+
+    if(section.compression == Compression::ZSTD)
+    {
+#ifdef UGV_NAV4D_USE_ZSTD
+        buffer.resize(section.rawSize);
+        const size_t result = ZSTD_decompress(&buffer[0], buffer.size(), stored, section.storedSize);
+        if(ZSTD_isError(result) || result != section.rawSize)
+            throw std::runtime_error(std::string("PlannerDump: Cannot decompress the ") + sectionName + " section of " + fileName);
+        return std::make_pair(buffer.data(), buffer.size());
+#else
+        throw std::runtime_error("PlannerDump: " + fileName + " is compressed using zstd, but ugv_nav4d has been built without zstd");
+#endif
+    }
+    else if(section.compression != Compression::NONE)
+    {
+        throw std::runtime_error(std::string("PlannerDump: Unknown compression of the ") + sectionName + " section in " + fileName);
+    }
+
+    //uncompressed sections are read directly from the mapped file
+    return std::make_pair(stored, static_cast<size_t>(section.storedSize));
+}
+
+const ugv_nav4d::PlannerDump::MLSBase& ugv_nav4d::PlannerDump::getMlsMap() const
+{
+    if(mlsMap)
+        return *mlsMap;
+
+    std::string buffer;
+    const std::pair<const char*, size_t> payload = decodeSection(mlsSection, "mls", buffer);
+    boost::iostreams::stream<boost::iostreams::array_source> input(payload.first, payload.second);
+    std::shared_ptr<MLSBase> map = std::make_shared<MLSBase>();
+    boost::archive::binary_iarchive ia(input);
+    ia >> *map;
+    mlsMap = map;
+    return *mlsMap;
+}
+
+std::string ugv_nav4d::PlannerDump::getExpandedMaps() const
+{
+    if(!mapsSection.present)
+        throw std::runtime_error("PlannerDump: " + fileName + " does not contain the expanded maps");
+
+    std::string buffer;
+    const std::pair<const char*, size_t> payload = decodeSection(mapsSection, "maps", buffer);
+    if(payload.first == buffer.data())
+        return buffer;
+    return std::string(payload.first, payload.second);
+}
+
+ugv_nav4d::PlannerDump::Snapshot ugv_nav4d::PlannerDump::capture(const ugv_nav4d::Planner& planner, const std::string& filePostfix, const base::Time& maxTime,
+                                                                  const base::samples::RigidBodyState& startbody2Mls, const base::samples::RigidBodyState& endbody2Mls)
+{
+    Snapshot snapshot;
+    snapshot.traversabilityConfig = planner.traversabilityConfig;
+    snapshot.mobility = planner.mobility;
+    snapshot.splinePrimitiveConfig = planner.splinePrimitiveConfig;
+    snapshot.plannerConfig = planner.plannerConfig;
+    snapshot.start = startbody2Mls;
+    snapshot.goal = endbody2Mls;
+    snapshot.maxTime = maxTime;
+    snapshot.mlsMap = planner.env->getMlsMapPtr();
+    if(planner.plannerConfig.dumpExpandedMaps)
+    {
+        std::ostringstream maps(std::ios::binary | std::ios::out);
+        planner.env->saveExpandedMaps(maps);
+        snapshot.expandedMaps = std::make_shared<const std::string>(maps.str());
+    }
+    snapshot.filePostfix = filePostfix;
+    snapshot.captureTime = base::Time::now();
+    return snapshot;
+}
+
+ugv_nav4d::PlannerDump::PlannerDump(const ugv_nav4d::Planner& planner, const std::string& filePostfix, const base::Time& maxTimeA, const base::samples::RigidBodyState& startbody2Mls, const base::samples::RigidBodyState& endbody2Mls,
+                                    Compression compression) :
+    PlannerDump(capture(planner, filePostfix, maxTimeA, startbody2Mls, endbody2Mls), compression)
+{
+}
+
+/** @return @p raw compressed using @p compression */
+static std::string compressSection(std::string raw, ugv_nav4d::PlannerDump::Compression compression, const char *sectionName)
+{
+    if(compression == ugv_nav4d::PlannerDump::Compression::NONE)
+        return raw;
+#ifdef UGV_NAV4D_USE_ZSTD
+    //the fastest level, dumps are written on the robot
+    std::string compressed(ZSTD_compressBound(raw.size()), '\0');
+    const size_t result = ZSTD_compress(&compressed[0], compressed.size(), raw.data(), raw.size(), 1);
+    if(ZSTD_isError(result))
+        throw std::runtime_error(std::string("PlannerDump: Cannot compress the ") + sectionName + " section");
+    compressed.resize(result);
+    return compressed;
+#else
+    throw std::runtime_error("PlannerDump: ugv_nav4d has been built without zstd");
+#endif
+}
+
+ugv_nav4d::PlannerDump::PlannerDump(const Snapshot& snapshot, Compression compression)
+{
+    if(!snapshot.mlsMap)
+        throw std::runtime_error("PlannerDump: Cannot write a dump without mls map");
+
+    fileName = getUnusedFilename(snapshot.filePostfix, snapshot.captureTime);
+    LOG_INFO_S << "Dumping planner state to: " << fileName;
+
+    traversabilityConfig = snapshot.traversabilityConfig;
+    mobility = snapshot.mobility;
+    splinePrimitiveConfig = snapshot.splinePrimitiveConfig;
+    plannerConfig = snapshot.plannerConfig;
+    start = snapshot.start;
+    goal = snapshot.goal;
+    maxTime = snapshot.maxTime;
+
+    RecordWriter writer;
+    base::Pose startPose = start.getPose();
+    base::Pose goalPose = goal.getPose();
+    double maxTimeD = maxTime.toSeconds();
+    visitParameters(writer, traversabilityConfig, splinePrimitiveConfig, mobility, plannerConfig, startPose, goalPose, maxTimeD);
+
+    std::ostringstream archive(std::ios::binary | std::ios::out);
+    {
+        boost::archive::binary_oarchive oa(archive);
+        oa << *snapshot.mlsMap;
+    }
+    std::string mls = archive.str();
+
+    //id, compression and payload of every section, in file order
+    std::vector<std::pair<uint32_t, Compression>> sectionIds;
+    std::vector<std::string> payloads;
+    std::vector<uint64_t> rawSizes;
+    sectionIds.emplace_back(CONFIG_SECTION, Compression::NONE);
+    payloads.push_back(writer.data);
+    rawSizes.push_back(writer.data.size());
+    sectionIds.emplace_back(MLS_SECTION, compression);
+    rawSizes.push_back(mls.size());
+    payloads.push_back(compressSection(std::move(mls), compression, "mls"));
+    if(snapshot.expandedMaps)
+    {
+        sectionIds.emplace_back(MAPS_SECTION, compression);
+        payloads.push_back(compressSection(*snapshot.expandedMaps, compression, "maps"));
+        rawSizes.push_back(snapshot.expandedMaps->size());
+    }
+
+    std::string header(dumpMagic, sizeof dumpMagic);
+    putU32(header, dumpVersion);
+    putU32(header, static_cast<uint32_t>(payloads.size()));
+    uint64_t offset = headerSize + payloads.size() * sectionEntrySize;
+    for(size_t i = 0; i < payloads.size(); ++i)
+    {
+        Section section;
+        section.compression = sectionIds[i].second;
+        section.offset = offset;
+        section.storedSize = payloads[i].size();
+        section.rawSize = rawSizes[i];
+        section.checksum = computeChecksum(payloads[i].data(), payloads[i].size());
+        section.present = true;
+
+        putU32(header, sectionIds[i].first);
+        putU32(header, static_cast<uint32_t>(section.compression));
+        putU64(header, section.offset);
+        putU64(header, section.storedSize);
+        putU64(header, section.rawSize);
+        putU32(header, section.checksum);
+        putU32(header, 0);
+
+        if(sectionIds[i].first == MLS_SECTION)
+            mlsSection = section;
+        else if(sectionIds[i].first == MAPS_SECTION)
+            mapsSection = section;
+        offset += section.storedSize;
+    }
+
+    std::ofstream output(fileName, std::ios::binary | std::ios::out | std::ios::trunc);
+    output.write(header.data(), header.size());
+    for(const std::string& payload : payloads)
+        output.write(payload.data(), payload.size());
     output.flush();
     output.close();
+    if(!output)
+        throw std::runtime_error("PlannerDump: Cannot write " + fileName);
 }
 
-std::string ugv_nav4d::PlannerDump::getUnusedFilename(const std::string& filePostfix) const
+std::string ugv_nav4d::PlannerDump::getUnusedFilename(const std::string& filePostfix, const base::Time& captureTime) const
 {
-    std::string completeName;
-    bool firstTime = true;
-    do{        
-        completeName = "ugv4d_dump_" + base::Time::now().toString(base::Time::Seconds, "%Y-%m-%d_%H%M%S") + "_" + filePostfix + ".bin";
+    const std::string baseName = "ugv4d_dump_" + captureTime.toString(base::Time::Seconds, "%Y-%m-%d_%H%M%S") + "_" + filePostfix;
+    std::string completeName = baseName + ".bin";
+
+    //several dumps within one second get a counter instead of waiting for the next second
+    for(int counter = 1; boost::filesystem::exists(completeName); ++counter)
+        completeName = baseName + "_" + std::to_string(counter) + ".bin";
 
-        if(!firstTime)
-            usleep(10000);
-        
-        firstTime = false;
-    } while(boost::filesystem::exists(completeName));
-    
     return completeName;
 }
 
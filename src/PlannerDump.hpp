@@ -6,13 +6,72 @@
 #include "Mobility.hpp"
 #include <base/samples/RigidBodyState.hpp>
 #include "Planner.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
 
 namespace ugv_nav4d {
 
 class Planner;
-    
+class MappedFile;
+
+/** Saves and loads the input of a planning request.
+ *
+ *  File format (version 2, all integers little endian):
+ *  - header: magic "UGV4DUMP", uint32 version, uint32 number of sections
+ *  - section table: per section uint32 id, uint32 compression, uint64 offset, uint64 stored size,
+ *    uint64 raw size, uint32 crc32 of the stored bytes, uint32 reserved
+ *  - section payloads
+ *
+ *  The CONFIG section stores all parameters (configs, start, goal, max time) as named records, thus
+ *  parameters that are unknown to the reader are skipped and missing ones keep their default value.
+ *  The MLS section contains the boost binary archive of the mls map. The optional MAPS section contains the
+ *  expanded traversability and obstacle map (see Planner::saveExpandedMaps()). Both are optionally compressed using zstd.
+ *
+ *  Dumps are memory mapped when loading. The configs are decoded immediately, the mls map is decoded on
+ *  the first call of getMlsMap(). Dumps of the old format (raw structs followed by the archive) are still loaded.
+ */
 class PlannerDump
 {
+public:
+    enum class Compression : uint32_t
+    {
+        NONE = 0,
+        ZSTD = 1,
+    };
+
+    /** @return ZSTD if the library has been built with zstd support, NONE otherwise */
+    static Compression getDefaultCompression();
+
+    typedef traversability_generator3d::TraversabilityGenerator3d::MLGrid MLSBase;
+
+    /** The input of a planning request, captured without copying the mls map.
+     *  The planner replaces its map on every update instead of modifying it, thus the shared map
+     *  stays valid and unchanged while the snapshot is written on another thread. */
+    struct Snapshot
+    {
+        sbpl_spline_primitives::SplinePrimitivesConfig splinePrimitiveConfig;
+        Mobility mobility;
+        traversability_generator3d::TraversabilityConfig traversabilityConfig;
+        PlannerConfig plannerConfig;
+        base::samples::RigidBodyState start;
+        base::samples::RigidBodyState goal;
+        base::Time maxTime;
+        std::shared_ptr<const MLSBase> mlsMap;
+        /** output of Planner::saveExpandedMaps(), null if PlannerConfig::dumpExpandedMaps is not set */
+        std::shared_ptr<const std::string> expandedMaps;
+        std::string filePostfix;
+        /** used for the file name */
+        base::Time captureTime;
+    };
+
+    /** Captures the current input of @p planner. Cheap, only the configs are copied.
+     *  If PlannerConfig::dumpExpandedMaps is set the expanded maps are serialized as well */
+    static Snapshot capture(const ugv_nav4d::Planner& planner, const std::string& filePostfix, const base::Time& maxTime,
+                            const base::samples::RigidBodyState& startbody2Mls, const base::samples::RigidBodyState& endbody2Mls);
+
+private:
     sbpl_spline_primitives::SplinePrimitivesConfig splinePrimitiveConfig; 
     Mobility mobility;
     traversability_generator3d::TraversabilityConfig traversabilityConfig;
@@ -22,18 +81,56 @@ class PlannerDump
     base::samples::RigidBodyState goal;
     base::Time maxTime;
     
-    typedef traversability_generator3d::TraversabilityGenerator3d::MLGrid MLSBase;
-    std::string getUnusedFilename(const std::string& filePostfix) const;
+    /** @return ugv4d_dump_<captureTime>_<postfix>.bin, with a counter appended if the file exists */
+    std::string getUnusedFilename(const std::string& filePostfix, const base::Time& captureTime) const;
+
+    /** Old format: raw structs followed by the archive */
+    void loadLegacy(const std::string& dumpName);
+
+    /** location of a section in the mapped file */
+    struct Section
+    {
+        Compression compression = Compression::NONE;
+        uint64_t offset = 0;
+        uint64_t storedSize = 0;
+        uint64_t rawSize = 0;
+        uint32_t checksum = 0;
+        bool present = false;
+    };
+
+    /** @return the uncompressed payload of @p section. Points into the mapped file or into @p buffer
+     *  @throw std::runtime_error if the checksum is wrong or the section cannot be decompressed */
+    std::pair<const char*, size_t> decodeSection(const Section& section, const char *sectionName, std::string& buffer) const;
 
-    MLSBase mlsMap;
+    std::string fileName;
+    /** decoded by getMlsMap() */
+    mutable std::shared_ptr<MLSBase> mlsMap;
+    /** the loaded file and the location of the sections in it */
+    std::shared_ptr<MappedFile> mappedFile;
+    Section mlsSection;
+    Section mapsSection;
 public:
     
     /**
      * Constructor for loading
+     * @throw std::runtime_error if the file cannot be read or the checksum of the configs is wrong
      * */
     PlannerDump(const std::string &dumpName);
 
-    PlannerDump(const ugv_nav4d::Planner& planner, const std::string& filePostfix, const base::Time& maxTime, const base::samples::RigidBodyState& startbody2Mls, const base::samples::RigidBodyState& endbody2Mls);
+    /** Constructor for writing the current input of @p planner.
+     *  @throw std::runtime_error if the file cannot be written */
+    PlannerDump(const ugv_nav4d::Planner& planner, const std::string& filePostfix, const base::Time& maxTime, const base::samples::RigidBodyState& startbody2Mls, const base::samples::RigidBodyState& endbody2Mls,
+                Compression compression = getDefaultCompression());
+
+    /** Constructor for writing a captured snapshot, used by the DumpWriter.
+     *  @throw std::runtime_error if the file cannot be written */
+    PlannerDump(const Snapshot& snapshot, Compression compression = getDefaultCompression());
+
+    /** @return the name of the loaded or written file */
+    const std::string &getFileName() const
+    {
+        return fileName;
+    }
     
     const sbpl_spline_primitives::SplinePrimitivesConfig &getSplineConfig() const
     {
@@ -67,11 +164,22 @@ public:
     {
         return maxTime;
     }
-    const MLSBase &getMlsMap() const
+    /** Decodes the mls map on the first call. Not thread-safe.
+     *  @throw std::runtime_error if the checksum of the map is wrong or if this dump has been written
+     *         (the map is not kept after writing) */
+    const MLSBase &getMlsMap() const;
+
+    /** @return true if the dump contains the expanded maps, see PlannerConfig::dumpExpandedMaps */
+    bool hasExpandedMaps() const
     {
-        return mlsMap;
+        return mapsSection.present;
     }
 
+    /** @return the expanded maps, which can be loaded using Planner::loadExpandedMaps()
+     *  @throw std::runtime_error if the dump does not contain the maps, if the checksum is wrong
+     *         or if this dump has been written */
+    std::string getExpandedMaps() const;
+
 };
 
 }
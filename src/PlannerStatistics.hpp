@@ -0,0 +1,87 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+namespace ugv_nav4d{
+/**
+ * Timers and counters of one Planner::plan() call.
+ * The times are wall clock times in seconds and are only measured if PlannerConfig::collectStatistics
+ * is set. The counters are always kept.
+ */
+struct PlannerStatistics
+{
+    /** Expansion of the traversability and obstacle map */
+    double expandMapTime = 0;
+    double setStartTime = 0;
+    /** Search for a valid goal position, includes precomputeCostTime */
+    double setGoalTime = 0;
+    /** Computation of the heuristic. Part of setGoalTime */
+    double precomputeCostTime = 0;
+    /** ARA* search, includes getSuccsTime */
+    double searchTime = 0;
+    /** Successor generation and edge evaluation (GetSuccs(), GetLazySuccs() and GetTrueCost()). Part of searchTime */
+    double getSuccsTime = 0;
+    /** Conversion of the solution into trajectories */
+    double getTrajectoryTime = 0;
+    double totalTime = 0;
+
+    /** Calls of GetSuccs() and GetLazySuccs() */
+    size_t getSuccsCalls = 0;
+    /** Calls of GetTrueCost() (Lazy ARA* only) */
+    size_t getTrueCostCalls = 0;
+    /** Number of successors returned to the search */
+    size_t successorsGenerated = 0;
+
+    //rejected motions. Every motion of a state is evaluated at most once per search
+    /** A cell of the motion is not traversable on the traversability map */
+    size_t rejectedNotTraversable = 0;
+    /** A cell of the motion is not traversable on the obstacle map */
+    size_t rejectedObstacleMap = 0;
+    /** The motion violates the incline limits */
+    size_t rejectedInclineLimit = 0;
+    /** The robot collides with an obstacle (path statistics) */
+    size_t rejectedCollision = 0;
+
+    size_t statesCreated = 0;
+    size_t heuristicCalls = 0;
+    /** States expanded by the search */
+    size_t expands = 0;
+    /** Cost of the solution (see Motion::costScaleFactor), -1 if no solution was found */
+    int solutionCost = -1;
+
+    size_t obstacleNodeCacheHits = 0;
+    size_t obstacleNodeCacheMisses = 0;
+    size_t edgeCacheHits = 0;
+    size_t edgeCacheMisses = 0;
+    /** Robot poses of the path statistics (start and goal check) that have been checked with a
+     *  precomputed footprint mask, see RobotFootprint::findMask() */
+    size_t footprintMaskLookups = 0;
+    /** Robot poses of the path statistics without precomputed mask. All cells are checked geometrically */
+    size_t footprintGeometricChecks = 0;
+
+    /** Peak resident set size of the process in bytes */
+    size_t peakMemory = 0;
+};
+
+/** Adds the wall time of its lifetime (in seconds) to @p time. Does nothing if not enabled */
+class ScopedTimer
+{
+public:
+    ScopedTimer(bool enabled, double &time) : time(enabled ? &time : nullptr)
+    {
+        if(this->time)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedTimer()
+    {
+        if(time)
+            *time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    double *time;
+    std::chrono::steady_clock::time_point start;
+};
+
+}
@@ -1,6 +1,19 @@
 #include "PreComputedMotions.hpp"
+#include "MappedFile.hpp"
 #include <maps/grid/GridMap.hpp>
+#include <boost/crc.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <type_traits>
+#include <unistd.h>
 #include <base/Angle.hpp>
 #include <base-logging/Logging.hpp>
 
@@ -8,14 +21,199 @@ namespace ugv_nav4d
 {
 using namespace sbpl_spline_primitives;
 
+namespace
+{
+
+const char cacheMagic[8] = {'U', 'G', 'V', '4', 'D', 'M', 'O', 'T'};
+/** Has to be incremented whenever the computation of the motions or the file format changes */
+const uint32_t cacheVersion = 2;
+/** written in host byte order, caches of machines with a different byte order are ignored */
+const uint32_t byteOrderMark = 0x01020304;
+/** magic, version, byte order mark, key, number of angles, number of motions, crc32 of the payload */
+const size_t cacheHeaderSize = 8 + 4 + 4 + 8 + 4 + 4 + 4;
+/** Size of a motion in the payload without steps: 7 int32, 2 double, id, 2 step counts, primitive index, quarter turns */
+const size_t minCachedMotionSize = 7 * 4 + 2 * 8 + 8 + 2 * 4 + 8 + 4;
+
+std::mutex cacheDirectoryMutex;
+bool cacheDirectoryInitialized = false;
+std::string cacheDirectory;
+
+/** FNV-1a hash of the bit patterns of the added values */
+class KeyHash
+{
+public:
+    uint64_t value = 14695981039346656037ull;
+
+    template <class T>
+    void add(const T& v)
+    {
+        static_assert(std::is_arithmetic<T>::value, "only numbers are hashed");
+        const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&v);
+        for(size_t i = 0; i < sizeof v; ++i)
+        {
+            value ^= bytes[i];
+            value *= 1099511628211ull;
+        }
+    }
+};
+
+class CacheWriter
+{
+public:
+    std::string data;
+
+    template <class T>
+    void put(const T& v)
+    {
+        data.append(reinterpret_cast<const char*>(&v), sizeof v);
+    }
+
+    void putSteps(const std::vector<PoseWithCell>& steps)
+    {
+        put(static_cast<uint32_t>(steps.size()));
+        for(const PoseWithCell& pwc : steps)
+        {
+            putPose(pwc.pose);
+            put(static_cast<int32_t>(pwc.cell.x()));
+            put(static_cast<int32_t>(pwc.cell.y()));
+        }
+    }
+
+    void putPose(const base::Pose2D& pose)
+    {
+        put(pose.position.x());
+        put(pose.position.y());
+        put(pose.orientation);
+    }
+};
+
+/** Reads from a memory range (i.e. the mapped cache file) */
+class CacheReader
+{
+public:
+    CacheReader(const char *begin, const char *end) : pos(begin), end(end)
+    {
+    }
+
+    template <class T>
+    T get()
+    {
+        if(static_cast<size_t>(end - pos) < sizeof(T))
+            throw std::runtime_error("truncated file");
+        T v;
+        std::memcpy(&v, pos, sizeof v);
+        pos += sizeof v;
+        return v;
+    }
+
+    void getSteps(std::vector<PoseWithCell>& steps)
+    {
+        steps.resize(getCount(sizeof(double) * 3 + sizeof(int32_t) * 2));
+        for(PoseWithCell& pwc : steps)
+        {
+            pwc.pose = getPose();
+            pwc.cell.x() = get<int32_t>();
+            pwc.cell.y() = get<int32_t>();
+        }
+    }
+
+    base::Pose2D getPose()
+    {
+        base::Pose2D pose;
+        pose.position.x() = get<double>();
+        pose.position.y() = get<double>();
+        pose.orientation = get<double>();
+        return pose;
+    }
+
+    /** @return a number of elements of at least @p elementSize bytes, checked against the remaining size */
+    uint32_t getCount(size_t elementSize)
+    {
+        const uint32_t count = get<uint32_t>();
+        if(count > static_cast<size_t>(end - pos) / elementSize)
+            throw std::runtime_error("truncated file");
+        return count;
+    }
+
+    bool atEnd() const
+    {
+        return pos == end;
+    }
+
+private:
+    const char *pos;
+    const char *end;
+};
+
+uint32_t computeChecksum(const char *data, size_t size)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(data, size);
+    return crc.checksum();
+}
+
+//90 degree rotations are exact on the grid
+void rotateCell(maps::grid::Index& cell, int quarterTurns)
+{
+    for(int q = 0; q < quarterTurns; ++q)
+        cell = maps::grid::Index(-cell.y(), cell.x());
+}
+
+void rotatePose(base::Pose2D& pose, int quarterTurns)
+{
+    for(int q = 0; q < quarterTurns; ++q)
+        pose.position = base::Vector2d(-pose.position.y(), pose.position.x());
+    pose.orientation = base::Angle::fromRad(pose.orientation + quarterTurns * M_PI / 2.0).getRad();
+}
+
+}
+
+constexpr const char *PreComputedMotions::cacheDirectoryVariable;
+constexpr size_t Motion::noPrimitive;
 
 PreComputedMotions::PreComputedMotions(const SplinePrimitivesConfig& primitiveConfig,
                                        const Mobility& mobilityConfig):
     primitives(primitiveConfig),
-    mobilityConfig(mobilityConfig)
+    mobilityConfig(mobilityConfig),
+    travGridResolution(primitiveConfig.gridSize),
+    loadedFromCache(false),
+    useSymmetry(true)
+{
+}
+
+void PreComputedMotions::setCacheDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(cacheDirectoryMutex);
+    cacheDirectory = directory;
+    cacheDirectoryInitialized = true;
+}
+
+std::string PreComputedMotions::getCacheDirectory()
+{
+    std::lock_guard<std::mutex> lock(cacheDirectoryMutex);
+    if(!cacheDirectoryInitialized)
+    {
+        const char *envDirectory = std::getenv(cacheDirectoryVariable);
+        cacheDirectory = envDirectory ? envDirectory : "";
+        cacheDirectoryInitialized = true;
+    }
+    return cacheDirectory;
+}
+
+bool PreComputedMotions::isLoadedFromCache() const
 {
+    return loadedFromCache;
 }
 
+void PreComputedMotions::setUseSymmetry(bool enable)
+{
+    useSymmetry = enable;
+}
+
+bool PreComputedMotions::getUseSymmetry() const
+{
+    return useSymmetry;
+}
 
 void PreComputedMotions::computeMotions(double obstGridResolution, double travGridResolution)
 {
@@ -25,10 +223,303 @@ void PreComputedMotions::computeMotions(double obstGridResolution, double travGr
         throw std::runtime_error("PreComputedMotions::computeMotions: Error grid size and trav size do not match");
     }
 
-    readMotionPrimitives(primitives, mobilityConfig, obstGridResolution, travGridResolution);
+    this->travGridResolution = travGridResolution;
+    loadedFromCache = false;
+    const std::string directory = getCacheDirectory();
+    if(directory.empty())
+    {
+        readMotionPrimitives(primitives, mobilityConfig, obstGridResolution, travGridResolution);
+    }
+    else
+    {
+        const uint64_t key = computeCacheKey(obstGridResolution, travGridResolution);
+        std::ostringstream name;
+        name << "motions_" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+        const std::string fileName = (boost::filesystem::path(directory) / name.str()).string();
+
+        loadedFromCache = loadMotions(fileName, key);
+        if(!loadedFromCache)
+        {
+            readMotionPrimitives(primitives, mobilityConfig, obstGridResolution, travGridResolution);
+            saveMotions(fileName, key);
+        }
+    }
+}
+
+void PreComputedMotions::rebuildMotionTables()
+{
+    thetaToTrie.clear();
+    for(const std::pair<size_t, size_t>& range : thetaToMotion)
+    {
+        thetaToTrie.push_back(computeMotionTrie(MotionRange(idToMotion.data() + range.first, range.second - range.first)));
+    }
+
+    obstacleSteps.clear();
+    obstacleStepOffsets.assign(1, 0);
+    for(const Motion& motion : idToMotion)
+    {
+        for(const PoseWithCell& pwc : motion.intermediateStepsObstMap)
+        {
+            obstacleSteps.push_back(MotionStep{pwc.cell, pwc.pose.orientation});
+        }
+        obstacleStepOffsets.push_back(obstacleSteps.size());
+    }
+}
+
+uint64_t PreComputedMotions::computeCacheKey(double obstGridResolution, double travGridResolution) const
+{
+    KeyHash hash;
+    hash.add(cacheVersion);
+    hash.add(obstGridResolution);
+    hash.add(travGridResolution);
+    hash.add(Motion::costScaleFactor);
+    //derived motions may differ from sampled ones in cells that are hit exactly at their border
+    hash.add(useSymmetry);
+
+    const SplinePrimitivesConfig& config(primitives.getConfig());
+    hash.add(config.gridSize);
+    hash.add(config.numAngles);
+    hash.add(config.numEndAngles);
+    hash.add(config.destinationCircleRadius);
+    hash.add(config.cellSkipFactor);
+    hash.add(config.splineOrder);
+    hash.add(config.generateForwardMotions);
+    hash.add(config.generateBackwardMotions);
+    hash.add(config.generateLateralMotions);
+    hash.add(config.generatePointTurnMotions);
+
+    hash.add(mobilityConfig.translationSpeed);
+    hash.add(mobilityConfig.rotationSpeed);
+    hash.add(mobilityConfig.minTurningRadius);
+    hash.add(mobilityConfig.spline_sampling_resolution);
+    hash.add(mobilityConfig.multiplierForward);
+    hash.add(mobilityConfig.multiplierBackward);
+    hash.add(mobilityConfig.multiplierLateral);
+    hash.add(mobilityConfig.multiplierForwardTurn);
+    hash.add(mobilityConfig.multiplierBackwardTurn);
+    hash.add(mobilityConfig.multiplierPointTurn);
+    hash.add(mobilityConfig.multiplierLateralCurve);
+    hash.add(mobilityConfig.maxMotionCurveLength);
+    return hash.value;
+}
+
+bool PreComputedMotions::loadMotions(const std::string& fileName, uint64_t key)
+{
+    if(!boost::filesystem::exists(fileName))
+        return false;
+
+    const int numAngles = primitives.getConfig().numAngles;
+    std::vector<Motion> motions;
+    try
+    {
+        const MappedFile file(fileName);
+        if(file.getSize() < cacheHeaderSize || std::memcmp(file.getData(), cacheMagic, sizeof cacheMagic) != 0)
+            throw std::runtime_error("not a motion cache");
+
+        CacheReader header(file.getData() + sizeof cacheMagic, file.getData() + cacheHeaderSize);
+        if(header.get<uint32_t>() != cacheVersion || header.get<uint32_t>() != byteOrderMark)
+            throw std::runtime_error("incompatible version or byte order");
+        if(header.get<uint64_t>() != key || header.get<uint32_t>() != static_cast<uint32_t>(numAngles))
+            throw std::runtime_error("written for a different configuration");
+        const uint32_t numMotions = header.get<uint32_t>();
+        const uint32_t checksum = header.get<uint32_t>();
+
+        const char *payload = file.getData() + cacheHeaderSize;
+        const size_t payloadSize = file.getSize() - cacheHeaderSize;
+        //the header is not part of the checksum, check the count before allocating the motions
+        if(numMotions > payloadSize / minCachedMotionSize)
+            throw std::runtime_error("invalid number of motions");
+        if(computeChecksum(payload, payloadSize) != checksum)
+            throw std::runtime_error("checksum mismatch");
+
+        CacheReader reader(payload, payload + payloadSize);
+        motions.resize(numMotions, Motion(numAngles));
+        for(Motion& motion : motions)
+        {
+            motion.xDiff = reader.get<int32_t>();
+            motion.yDiff = reader.get<int32_t>();
+            motion.startTheta = DiscreteTheta(static_cast<int>(reader.get<int32_t>()), numAngles);
+            motion.endTheta = DiscreteTheta(static_cast<int>(reader.get<int32_t>()), numAngles);
+            motion.type = static_cast<Motion::Type>(reader.get<int32_t>());
+            motion.baseCost = reader.get<int32_t>();
+            motion.costMultiplier = reader.get<int32_t>();
+            motion.translationlDist = reader.get<double>();
+            motion.angularDist = reader.get<double>();
+            motion.id = reader.get<uint64_t>();
+            reader.getSteps(motion.intermediateStepsTravMap);
+            reader.getSteps(motion.intermediateStepsObstMap);
+            const uint64_t primitiveIndex = reader.get<uint64_t>();
+            motion.primitiveIndex = primitiveIndex;
+            motion.quarterTurns = reader.get<int32_t>();
+
+            //ids are the index, motions with the same start theta are stored contiguously (sorted by theta)
+            if(motion.id != static_cast<size_t>(&motion - motions.data()) ||
+               (motion.id > 0 && motion.startTheta.getTheta() < motions[motion.id - 1].startTheta.getTheta()) ||
+               motion.type < Motion::MOV_FORWARD || motion.type > Motion::MOV_LATERAL ||
+               motion.startTheta.getTheta() < 0 || motion.startTheta.getTheta() >= numAngles ||
+               motion.quarterTurns < 0 || motion.quarterTurns > 3 || (motion.quarterTurns != 0 && numAngles % 4 != 0))
+                throw std::runtime_error("invalid motion");
+        }
+        if(!reader.atEnd())
+            throw std::runtime_error("unexpected data at the end");
+    }
+    catch(const std::exception& ex)
+    {
+        //e.g. bad_alloc caused by a corrupt file, the motions are recomputed in any case
+        LOG_WARN_S << "PreComputedMotions: Ignoring motion cache " << fileName << ": " << ex.what();
+        return false;
+    }
+
+    //same layout as built by addMotion()
+    idToMotion = motions;
+    thetaToMotion.clear();
+    thetaToMotionKeys.clear();
+    for(const Motion& motion : idToMotion)
+    {
+        if((int)thetaToMotion.size() <= motion.startTheta.getTheta())
+        {
+            thetaToMotion.resize(motion.startTheta.getTheta() + 1, std::make_pair(motion.id, motion.id));
+            thetaToMotionKeys.resize(motion.startTheta.getTheta() + 1);
+        }
+        thetaToMotion[motion.startTheta.getTheta()].second = motion.id + 1;
+        thetaToMotionKeys[motion.startTheta.getTheta()].insert(getDuplicateKey(motion));
+    }
+    rebuildMotionTables();
+    LOG_INFO_S << "PreComputedMotions: Loaded " << idToMotion.size() << " motions from " << fileName;
+    return true;
+}
+
+void PreComputedMotions::saveMotions(const std::string& fileName, uint64_t key) const
+{
+    CacheWriter writer;
+    for(const Motion& motion : idToMotion)
+    {
+        writer.put(static_cast<int32_t>(motion.xDiff));
+        writer.put(static_cast<int32_t>(motion.yDiff));
+        writer.put(static_cast<int32_t>(motion.startTheta.getTheta()));
+        writer.put(static_cast<int32_t>(motion.endTheta.getTheta()));
+        writer.put(static_cast<int32_t>(motion.type));
+        writer.put(static_cast<int32_t>(motion.baseCost));
+        writer.put(static_cast<int32_t>(motion.costMultiplier));
+        writer.put(motion.translationlDist);
+        writer.put(motion.angularDist);
+        writer.put(static_cast<uint64_t>(motion.id));
+        writer.putSteps(motion.intermediateStepsTravMap);
+        writer.putSteps(motion.intermediateStepsObstMap);
+        writer.put(static_cast<uint64_t>(motion.primitiveIndex));
+        writer.put(static_cast<int32_t>(motion.quarterTurns));
+    }
+
+    CacheWriter header;
+    header.data.append(cacheMagic, sizeof cacheMagic);
+    header.put(cacheVersion);
+    header.put(byteOrderMark);
+    header.put(key);
+    header.put(static_cast<uint32_t>(primitives.getConfig().numAngles));
+    header.put(static_cast<uint32_t>(idToMotion.size()));
+    header.put(computeChecksum(writer.data.data(), writer.data.size()));
+
+    //other processes might load or write the same file. Write to a temporary file and rename it, which is atomic
+    const std::string tmpName = fileName + ".tmp" + std::to_string(getpid());
+    try
+    {
+        boost::filesystem::create_directories(boost::filesystem::path(fileName).parent_path());
+        {
+            std::ofstream output(tmpName, std::ios::binary | std::ios::out | std::ios::trunc);
+            output.write(header.data.data(), header.data.size());
+            output.write(writer.data.data(), writer.data.size());
+            output.close();
+            if(!output)
+                throw std::runtime_error("cannot write " + tmpName);
+        }
+        boost::filesystem::rename(tmpName, fileName);
+        LOG_INFO_S << "PreComputedMotions: Wrote motion cache " << fileName;
+    }
+    catch(const std::exception& ex)
+    {
+        LOG_WARN_S << "PreComputedMotions: Cannot write motion cache " << fileName << ": " << ex.what();
+        boost::system::error_code error;
+        boost::filesystem::remove(tmpName, error);
+    }
 }
 
-void PreComputedMotions::sampleOnResolution(double gridResolution,base::geometry::Spline2 spline, std::vector<PoseWithCell> &result, std::vector<CellWithPoses> &fullResult)
+std::vector<MotionTrieNode> PreComputedMotions::computeMotionTrie(const MotionRange& motions)
+{
+    typedef std::pair<int, int> CellKey;
+
+    //pointer free tree that is sorted into depth first order afterwards
+    struct BuildNode
+    {
+        maps::grid::Index cell;
+        std::map<CellKey, size_t> children;
+        std::vector<size_t> motions;
+    };
+    std::vector<BuildNode> buildNodes(1);
+    buildNodes[0].cell = maps::grid::Index(0, 0);
+
+    for(size_t i = 0; i < motions.size(); ++i)
+    {
+        size_t current = 0;
+        for(const PoseWithCell& pwc : motions[i].intermediateStepsTravMap)
+        {
+            const CellKey key(pwc.cell.x(), pwc.cell.y());
+            auto child = buildNodes[current].children.find(key);
+            if(child == buildNodes[current].children.end())
+            {
+                buildNodes[current].children[key] = buildNodes.size();
+                BuildNode node;
+                node.cell = pwc.cell;
+                buildNodes.push_back(node);
+                current = buildNodes.size() - 1;
+            }
+            else
+            {
+                current = child->second;
+            }
+        }
+        buildNodes[current].motions.push_back(i);
+    }
+
+    std::vector<MotionTrieNode> trie;
+    trie.reserve(buildNodes.size());
+
+    //(build node, parent in trie)
+    std::vector<std::pair<size_t, int>> stack(1, std::make_pair(0, -1));
+    //trie nodes whose subtree end is not known yet
+    std::vector<size_t> open;
+    while(!stack.empty())
+    {
+        const std::pair<size_t, int> current = stack.back();
+        stack.pop_back();
+
+        //all open nodes that are not ancestors of the current node are complete
+        while(!open.empty() && static_cast<int>(open.back()) != current.second)
+        {
+            trie[open.back()].subtreeEnd = trie.size();
+            open.pop_back();
+        }
+
+        const BuildNode& buildNode(buildNodes[current.first]);
+        MotionTrieNode node;
+        node.cell = buildNode.cell;
+        node.parent = current.second;
+        node.motions = buildNode.motions;
+        open.push_back(trie.size());
+        trie.push_back(node);
+
+        for(auto child = buildNode.children.rbegin(); child != buildNode.children.rend(); ++child)
+        {
+            stack.push_back(std::make_pair(child->second, static_cast<int>(trie.size() - 1)));
+        }
+    }
+    for(size_t node : open)
+    {
+        trie[node].subtreeEnd = trie.size();
+    }
+    return trie;
+}
+
+void PreComputedMotions::sampleOnResolution(double gridResolution,base::geometry::Spline2 spline, std::vector<PoseWithCell> &result, std::vector<CellWithPoses> &fullResult) const
 {
     maps::grid::GridMap<int> dummyGrid(maps::grid::Vector2ui(10, 10), base::Vector2d(gridResolution, gridResolution), 0);
 
@@ -96,136 +587,382 @@ void PreComputedMotions::readMotionPrimitives(const SbplSplineMotionPrimitives&
     const int numAngles = primGen.getConfig().numAngles;
     const double maxCurvature = calculateCurvatureFromRadius(mobilityConfig.minTurningRadius);
 
-    for(int angle = 0; angle < numAngles; ++angle)
+    //only the first quadrant needs to be sampled if the other ones are rotations of it
+    const bool symmetric = useSymmetry && isQuarterSymmetric(primGen);
+    const int numSampledAngles = symmetric ? numAngles / 4 : numAngles;
+    if(useSymmetry && !symmetric)
+    {
+        LOG_INFO_S << "PreComputedMotions: Sampling all " << numAngles << " angles, the primitives are not quarter symmetric"
+                   << (numAngles % 4 != 0 ? " (the number of angles is not divisible by four)" : "");
+    }
+
+    //the angles are independent, each one is sampled into its own buffer.
+    //The buffers are merged in angle order afterwards, thus the ids do not depend on the scheduling
+    std::vector<std::vector<Motion>> angleMotions(numAngles);
+    std::exception_ptr error;
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int angle = 0; angle < numSampledAngles; ++angle)
     {
-        for(const SplinePrimitive& prim : primGen.getPrimitiveForAngle(angle))
+        try
+        {
+            const std::vector<SplinePrimitive>& anglePrimitives(primGen.getPrimitiveForAngle(angle));
+            for(size_t primitiveIndex = 0; primitiveIndex < anglePrimitives.size(); ++primitiveIndex)
+            {
+                const SplinePrimitive& prim(anglePrimitives[primitiveIndex]);
+                //NOTE the const cast is only here because for some reason getCurvatureMax() is non-const (but shouldnt be)
+                if(prim.motionType != SplinePrimitive::SPLINE_POINT_TURN && //cannot call getCurvatureMax on point turns cause spl ne is not initalized
+                   const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() > maxCurvature)
+                   {
+                       continue;
+                   }
+
+                Motion motion(numAngles);
+
+                motion.xDiff = prim.endPosition[0];
+                motion.yDiff = prim.endPosition[1];
+                motion.endTheta =  DiscreteTheta(static_cast<int>(prim.endAngle), numAngles);
+                motion.startTheta = DiscreteTheta(static_cast<int>(prim.startAngle), numAngles);
+                motion.costMultiplier = 1; //is changed in the switch-case below
+                motion.primitiveIndex = primitiveIndex;
+
+                switch(prim.motionType)
+                {
+                    case SplinePrimitive::SPLINE_MOVE_FORWARD:
+                        motion.type = Motion::Type::MOV_FORWARD;
+                        if (const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() > -0.1 &&
+                            const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() < 0.1)
+                        {
+                            motion.costMultiplier = mobilityConfig.multiplierForward;
+                        }
+                        else
+                        {
+                            motion.costMultiplier = mobilityConfig.multiplierForwardTurn;
+                        }
+                        break;
+                    case SplinePrimitive::SPLINE_MOVE_BACKWARD:
+                        motion.type = Motion::Type::MOV_BACKWARD;
+                        if (const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() > -0.1 &&
+                            const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() < 0.1)
+                        {
+                            motion.costMultiplier = mobilityConfig.multiplierBackward;
+                        }
+                        else
+                        {
+                            motion.costMultiplier = mobilityConfig.multiplierBackwardTurn;
+                        }
+                        break;
+                    case SplinePrimitive::SPLINE_MOVE_LATERAL:
+                        motion.type = Motion::Type::MOV_LATERAL;
+                        if (const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() > -0.1 &&
+                            const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() < 0.1)
+                        {
+                            motion.costMultiplier = mobilityConfig.multiplierLateral;
+                        }
+                        else
+                        {
+                            motion.costMultiplier = mobilityConfig.multiplierLateralCurve;
+                        }
+                        break;
+                    case SplinePrimitive::SPLINE_POINT_TURN:
+                        motion.type = Motion::Type::MOV_POINTTURN;
+                        motion.costMultiplier = mobilityConfig.multiplierPointTurn;
+                        break;
+                    default:
+                        throw std::runtime_error("Got Unsupported movement");
+                }
+
+                //there are no intermediate steps for point turns
+                if(prim.motionType != SplinePrimitive::SPLINE_POINT_TURN)
+                {
+                    //the full samples are not stored, see getFullSplineSamples()
+                    std::vector<CellWithPoses> dummy;
+                    sampleOnResolution(travGridResolution, prim.spline, motion.intermediateStepsTravMap, dummy);
+                    dummy.clear();
+                    sampleOnResolution(obstGridResolution, prim.spline, motion.intermediateStepsObstMap, dummy);
+                }
+                computeSplinePrimCost(prim, mobilityConfig, motion);
+
+                if (motion.translationlDist > mobilityConfig.maxMotionCurveLength) //1.3 is slower but trajectories are curvy , 1.0 is faster with more linear trajectories
+                continue;
+
+                //orientations for backward motions need to be inverted
+                if(motion.type == Motion::Type::MOV_BACKWARD)
+                {
+                    for(PoseWithCell& pwc : motion.intermediateStepsTravMap)
+                        pwc.pose.orientation = base::Angle::fromRad(pwc.pose.orientation).flipped().getRad();
+                    for(PoseWithCell& pwc : motion.intermediateStepsObstMap)
+                        pwc.pose.orientation = base::Angle::fromRad(pwc.pose.orientation).flipped().getRad();
+                }
+
+                angleMotions[angle].push_back(motion);
+            }
+        }
+        catch(...)
         {
-            //NOTE the const cast is only here because for some reason getCurvatureMax() is non-const (but shouldnt be)
-            if(prim.motionType != SplinePrimitive::SPLINE_POINT_TURN && //cannot call getCurvatureMax on point turns cause spl ne is not initalized
-               const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() > maxCurvature)
-               {
-                   continue;
-               }
-
-            Motion motion(numAngles);
-
-            motion.xDiff = prim.endPosition[0];
-            motion.yDiff = prim.endPosition[1];
-            motion.endTheta =  DiscreteTheta(static_cast<int>(prim.endAngle), numAngles);
-            motion.startTheta = DiscreteTheta(static_cast<int>(prim.startAngle), numAngles);
-            motion.costMultiplier = 1; //is changed in the switch-case below
-
-            switch(prim.motionType)
+            //exceptions must not leave the parallel region
+            #pragma omp critical(readMotionPrimitivesError)
             {
-                case SplinePrimitive::SPLINE_MOVE_FORWARD:
-                    motion.type = Motion::Type::MOV_FORWARD;
-                    if (const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() > -0.1 &&
-                        const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() < 0.1)
-                    {
-                        motion.costMultiplier = mobilityConfig.multiplierForward;
-                    }
-                    else
-                    {
-                        motion.costMultiplier = mobilityConfig.multiplierForwardTurn;
-                    }
-                    break;
-                case SplinePrimitive::SPLINE_MOVE_BACKWARD:
-                    motion.type = Motion::Type::MOV_BACKWARD;
-                    if (const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() > -0.1 &&
-                        const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() < 0.1)
-                    {
-                        motion.costMultiplier = mobilityConfig.multiplierBackward;
-                    }
-                    else
-                    {
-                        motion.costMultiplier = mobilityConfig.multiplierBackwardTurn;
-                    }
-                    break;
-                case SplinePrimitive::SPLINE_MOVE_LATERAL:
-                    motion.type = Motion::Type::MOV_LATERAL;
-                    if (const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() > -0.1 &&
-                        const_cast<SplinePrimitive&>(prim).spline.getCurvatureMax() < 0.1)
-                    {
-                        motion.costMultiplier = mobilityConfig.multiplierLateral;
-                    }
-                    else
-                    {
-                        motion.costMultiplier = mobilityConfig.multiplierLateralCurve;
-                    }
-                    break;
-                case SplinePrimitive::SPLINE_POINT_TURN:
-                    motion.type = Motion::Type::MOV_POINTTURN;
-                    motion.costMultiplier = mobilityConfig.multiplierPointTurn;
-                    break;
-                default:
-                    throw std::runtime_error("Got Unsupported movement");
+                if(!error)
+                    error = std::current_exception();
             }
+        }
+    }
+
+    if(error)
+        std::rethrow_exception(error);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int angle = numSampledAngles; angle < numAngles; ++angle)
+    {
+        const std::vector<Motion>& source(angleMotions[angle % numSampledAngles]);
+        angleMotions[angle].reserve(source.size());
+        for(const Motion& motion : source)
+        {
+            angleMotions[angle].push_back(rotateQuarterTurns(motion, angle / numSampledAngles, numAngles));
+        }
+    }
+
+    for(const std::vector<Motion>& motions : angleMotions)
+    {
+        for(const Motion& motion : motions)
+        {
+            addMotion(motion, motion.startTheta);
+        }
+    }
+    rebuildMotionTables();
+}
 
-            //there are no intermediate steps for point turns
-            if(prim.motionType != SplinePrimitive::SPLINE_POINT_TURN)
+void PreComputedMotions::computeSweptFootprints(const RobotFootprint& footprint)
+{
+    for(Motion& motion : idToMotion)
+    {
+        computeSweptFootprint(footprint, motion);
+    }
+}
+
+void PreComputedMotions::computeSweptFootprint(const RobotFootprint& footprint, Motion& motion) const
+{
+    typedef std::pair<int, int> CellKey;
+    const double gridResolution = footprint.getGridResolution();
+
+    //union of the footprints of all poses
+    std::map<CellKey, RobotFootprint::Cell> covered;
+    for(const PoseWithCell& pwc : motion.intermediateStepsObstMap)
+    {
+        //the poses are relative to the center of the start cell
+        const base::Vector2d poseOffset(pwc.pose.position - base::Vector2d(pwc.cell.x() * gridResolution, pwc.cell.y() * gridResolution));
+        const RobotFootprint::Mask mask(footprint.computeMask(poseOffset, pwc.pose.orientation));
+        for(int y = -mask.getRadius(); y <= mask.getRadius(); ++y)
+        {
+            for(int x = -mask.getRadius(); x <= mask.getRadius(); ++x)
             {
-                sampleOnResolution(travGridResolution, prim.spline, motion.intermediateStepsTravMap, motion.fullSplineSamples);
-                std::vector<CellWithPoses> dummy;
-                sampleOnResolution(obstGridResolution, prim.spline, motion.intermediateStepsObstMap, dummy);
+                const RobotFootprint::Cell& cell(mask.at(maps::grid::Index(x, y)));
+                if(!cell.insideCorridor)
+                    continue;
+
+                RobotFootprint::Cell& merged(covered[CellKey(pwc.cell.x() + x, pwc.cell.y() + y)]);
+                merged.insideCorridor = true;
+                merged.insideRobot |= cell.insideRobot;
+                merged.boundaryDistance = std::min(merged.boundaryDistance, cell.boundaryDistance);
             }
-            computeSplinePrimCost(prim, mobilityConfig, motion);
+        }
+    }
+
+    //sort the cells in breadth first order starting at the intermediate steps. This way the node
+    //of a cell can be found by following the connection from the node of its parent cell.
+    std::vector<SweptCell>& swept(motion.sweptFootprint);
+    swept.clear();
+    std::map<CellKey, bool> visited;
+    auto addCell = [&] (const maps::grid::Index& idx, int parent, int step)
+    {
+        const CellKey key(idx.x(), idx.y());
+        if(visited[key])
+            return;
+        visited[key] = true;
+
+        SweptCell sc;
+        sc.cell = idx;
+        sc.parent = parent;
+        sc.step = step;
+        const RobotFootprint::Cell& cell(covered[key]);
+        sc.insideRobot = cell.insideRobot;
+        sc.boundaryDistance = cell.boundaryDistance;
+        swept.push_back(sc);
+    };
 
-            if (motion.translationlDist > mobilityConfig.maxMotionCurveLength) //1.3 is slower but trajectories are curvy , 1.0 is faster with more linear trajectories
-            continue;
+    for(size_t i = 0; i < motion.intermediateStepsObstMap.size(); ++i)
+    {
+        addCell(motion.intermediateStepsObstMap[i].cell, -1, i);
+    }
 
-            //orientations for backward motions need to be inverted
-            if(motion.type == Motion::Type::MOV_BACKWARD)
+    for(size_t i = 0; i < swept.size(); ++i)
+    {
+        const maps::grid::Index idx(swept[i].cell);
+        for(int y = -1; y <= 1; ++y)
+        {
+            for(int x = -1; x <= 1; ++x)
             {
-                for(PoseWithCell& pwc : motion.intermediateStepsTravMap)
-                    pwc.pose.orientation = base::Angle::fromRad(pwc.pose.orientation).flipped().getRad();
-                for(PoseWithCell& pwc : motion.intermediateStepsObstMap)
-                    pwc.pose.orientation = base::Angle::fromRad(pwc.pose.orientation).flipped().getRad();
+                const maps::grid::Index neighbor(idx + maps::grid::Index(x, y));
+                if(covered.count(CellKey(neighbor.x(), neighbor.y())))
+                    addCell(neighbor, i, -1);
             }
+        }
+    }
+}
+
+bool PreComputedMotions::isQuarterSymmetric(const SbplSplineMotionPrimitives& primGen)
+{
+    const int numAngles = primGen.getConfig().numAngles;
+    if(numAngles <= 0 || numAngles % 4 != 0)
+        return false;
+
+    const int quarter = numAngles / 4;
+    for(int angle = quarter; angle < numAngles; ++angle)
+    {
+        const std::vector<SplinePrimitive>& prims(primGen.getPrimitiveForAngle(angle));
+        const std::vector<SplinePrimitive>& source(primGen.getPrimitiveForAngle(angle % quarter));
+        if(prims.size() != source.size())
+            return false;
 
-            setMotionForTheta(motion, motion.startTheta);
+        const int quarterTurns = angle / quarter;
+        for(size_t i = 0; i < prims.size(); ++i)
+        {
+            Eigen::Vector2i end(static_cast<int>(source[i].endPosition[0]), static_cast<int>(source[i].endPosition[1]));
+            for(int q = 0; q < quarterTurns; ++q)
+                end = Eigen::Vector2i(-end.y(), end.x());
+
+            if(prims[i].motionType != source[i].motionType ||
+               static_cast<int>(prims[i].startAngle) != angle ||
+               static_cast<int>(prims[i].endAngle) != (static_cast<int>(source[i].endAngle) + quarterTurns * quarter) % numAngles ||
+               static_cast<int>(prims[i].endPosition[0]) != end.x() || static_cast<int>(prims[i].endPosition[1]) != end.y())
+            {
+                return false;
+            }
         }
     }
+    return true;
+}
+
+Motion PreComputedMotions::rotateQuarterTurns(const Motion& motion, int quarterTurns, int numAngles)
+{
+    Motion rotated(motion);
+    rotated.id = std::numeric_limits<size_t>::max();
+    rotated.startTheta = DiscreteTheta(motion.startTheta.getTheta() + quarterTurns * numAngles / 4, numAngles);
+    rotated.endTheta = DiscreteTheta(motion.endTheta.getTheta() + quarterTurns * numAngles / 4, numAngles);
+    rotated.quarterTurns = motion.quarterTurns + quarterTurns;
+
+    maps::grid::Index end(motion.xDiff, motion.yDiff);
+    rotateCell(end, quarterTurns);
+    rotated.xDiff = end.x();
+    rotated.yDiff = end.y();
+
+    for(PoseWithCell& pwc : rotated.intermediateStepsTravMap)
+    {
+        rotateCell(pwc.cell, quarterTurns);
+        rotatePose(pwc.pose, quarterTurns);
+    }
+    for(PoseWithCell& pwc : rotated.intermediateStepsObstMap)
+    {
+        rotateCell(pwc.cell, quarterTurns);
+        rotatePose(pwc.pose, quarterTurns);
+    }
+    //depends on the robot dimensions, computed by computeSweptFootprints()
+    rotated.sweptFootprint.clear();
+    return rotated;
+}
+
+uint64_t PreComputedMotions::getDuplicateKey(const Motion& motion)
+{
+    //16 bit per value, motions are far shorter than 2^15 cells
+    return (static_cast<uint64_t>(static_cast<uint16_t>(motion.xDiff)) << 48) |
+           (static_cast<uint64_t>(static_cast<uint16_t>(motion.yDiff)) << 32) |
+           (static_cast<uint64_t>(static_cast<uint16_t>(motion.endTheta.getTheta())) << 16) |
+           static_cast<uint64_t>(static_cast<uint16_t>(motion.type));
+}
+
+std::vector<CellWithPoses> PreComputedMotions::getFullSplineSamples(const Motion& motion) const
+{
+    std::vector<CellWithPoses> samples;
+    if(motion.type == Motion::Type::MOV_POINTTURN || motion.primitiveIndex == Motion::noPrimitive)
+        return samples;
+
+    //the primitive has been sampled for the unrotated start angle
+    const int numAngles = primitives.getConfig().numAngles;
+    const int angle = DiscreteTheta(motion.startTheta.getTheta() - motion.quarterTurns * numAngles / 4, numAngles).getTheta();
+    const std::vector<SplinePrimitive>& anglePrimitives(primitives.getPrimitiveForAngle(angle));
+    if(motion.primitiveIndex >= anglePrimitives.size())
+        throw std::runtime_error("PreComputedMotions::getFullSplineSamples: Motion " + std::to_string(motion.id) + " has an invalid primitive index");
+
+    std::vector<PoseWithCell> steps;
+    sampleOnResolution(travGridResolution, anglePrimitives[motion.primitiveIndex].spline, steps, samples);
+    if(motion.quarterTurns != 0)
+    {
+        for(CellWithPoses& cwp : samples)
+        {
+            rotateCell(cwp.cell, motion.quarterTurns);
+            for(base::Pose2D& pose : cwp.poses)
+                rotatePose(pose, motion.quarterTurns);
+        }
+    }
+    return samples;
 }
 
 void PreComputedMotions::setMotionForTheta(const Motion& motion, const DiscreteTheta& theta)
+{
+    if(addMotion(motion, theta))
+        rebuildMotionTables();
+}
+
+bool PreComputedMotions::addMotion(const Motion& motion, const DiscreteTheta& theta)
 {
     if((int)thetaToMotion.size() <= theta.getTheta())
     {
-        thetaToMotion.resize(theta.getTheta() + 1);
+        thetaToMotion.resize(theta.getTheta() + 1, std::make_pair(idToMotion.size(), idToMotion.size()));
+        thetaToMotionKeys.resize(theta.getTheta() + 1);
     }
 
 
     //check if a motion to this target destination already exist, if yes skip it.
-    for(const Motion& m : thetaToMotion[theta.getTheta()])
+    if(!thetaToMotionKeys[theta.getTheta()].insert(getDuplicateKey(motion)).second)
     {
-        if(m.xDiff == motion.xDiff && m.yDiff == motion.yDiff &&
-           m.endTheta == motion.endTheta && m.type == motion.type)
+        std::string type;
+        switch(motion.type)
         {
-            std::string type;
-            switch(m.type)
-            {
-                case Motion::Type::MOV_FORWARD:  type ="MOV_FORWARD" ; break;
-                case Motion::Type::MOV_BACKWARD: type ="MOV_BACKWARD" ; break;
-                case Motion::Type::MOV_POINTTURN:type ="MOV_POINTTURN" ; break;
-                case Motion::Type::MOV_LATERAL:  type ="MOV_LATERAL" ; break;
-                default:
-                    throw std::runtime_error("ERROR: motion without valid type: ");
+            case Motion::Type::MOV_FORWARD:  type ="MOV_FORWARD" ; break;
+            case Motion::Type::MOV_BACKWARD: type ="MOV_BACKWARD" ; break;
+            case Motion::Type::MOV_POINTTURN:type ="MOV_POINTTURN" ; break;
+            case Motion::Type::MOV_LATERAL:  type ="MOV_LATERAL" ; break;
+            default:
+                throw std::runtime_error("ERROR: motion without valid type: ");
 
-            }
-            LOG_WARN_S << "WARNING: motion already exists (skipping): " <<  m.xDiff << ", " << m.yDiff << ", " << m.endTheta << type;
-            //TODO add check if intermediate poses are similar
-            return;
         }
+        LOG_WARN_S << "WARNING: motion already exists (skipping): " <<  motion.xDiff << ", " << motion.yDiff << ", " << motion.endTheta << type;
+        //TODO add check if intermediate poses are similar
+        return false;
     }
 
+    //insert behind the other motions of theta. The motions are added in theta order by readMotionPrimitives(),
+    //thus this is usually the end and no motions need to be moved
+    const size_t index = thetaToMotion[theta.getTheta()].second;
     Motion copy = motion;
-    copy.id = idToMotion.size();
+    copy.id = index;
+    idToMotion.insert(idToMotion.begin() + index, copy);
+    for(size_t id = index + 1; id < idToMotion.size(); ++id)
+    {
+        idToMotion[id].id = id;
+    }
 
-    idToMotion.push_back(copy);
-    thetaToMotion[theta.getTheta()].push_back(copy);
+    ++thetaToMotion[theta.getTheta()].second;
+    for(size_t t = theta.getTheta() + 1; t < thetaToMotion.size(); ++t)
+    {
+        ++thetaToMotion[t].first;
+        ++thetaToMotion[t].second;
+    }
+    return true;
 }
 
-base::Pose2D PreComputedMotions::getPointClosestToCellMiddle(const CellWithPoses& cwp, const double gridResolution)
+base::Pose2D PreComputedMotions::getPointClosestToCellMiddle(const CellWithPoses& cwp, const double gridResolution) const
 {
     //dummyGrid is used to convert between grid indices and positions
     maps::grid::GridMap<int> dummyGrid(maps::grid::Vector2ui(10, 10), base::Vector2d(gridResolution, gridResolution), 0);
@@ -316,6 +1053,11 @@ const Motion& PreComputedMotions::getMotion(std::size_t id) const
     return idToMotion.at(id);
 }
 
+size_t PreComputedMotions::getNumMotions() const
+{
+    return idToMotion.size();
+}
+
 const SbplSplineMotionPrimitives& PreComputedMotions::getPrimitives() const
 {
     return primitives;
@@ -350,13 +1092,23 @@ double PreComputedMotions::calculateCurvatureFromRadius(const double r)
     return c;
 }
 
-const std::vector< Motion >& PreComputedMotions::getMotionForStartTheta(const DiscreteTheta& theta) const
+const std::vector<MotionTrieNode>& PreComputedMotions::getMotionTrieForStartTheta(const DiscreteTheta& theta) const
+{
+    if(theta.getTheta() >= (int)thetaToTrie.size())
+    {
+        throw std::runtime_error("Internal error, motion trie for requested theta ist not available. Input  theta:" + std::to_string(theta.getTheta()));
+    }
+    return thetaToTrie.at(theta.getTheta());
+}
+
+MotionRange PreComputedMotions::getMotionForStartTheta(const DiscreteTheta& theta) const
 {
     if(theta.getTheta() >= (int)thetaToMotion.size())
     {
         throw std::runtime_error("Internal error, motion for requested theta ist not available. Input  theta:" + std::to_string(theta.getTheta()));
     }
-    return thetaToMotion.at(theta.getTheta());
+    const std::pair<size_t, size_t>& range(thetaToMotion[theta.getTheta()]);
+    return MotionRange(idToMotion.data() + range.first, range.second - range.first);
 }
 
 
@@ -2,8 +2,13 @@
 
 #include "DiscreteTheta.hpp"
 #include "Mobility.hpp"
+#include "RobotFootprint.hpp"
+#include <cstdint>
 #include <limits>
 #include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 #include <base/Pose.hpp>
 #include <maps/grid/Index.hpp>
@@ -24,6 +29,38 @@ struct CellWithPoses
     std::vector<base::Pose2D> poses;
 };
 
+/** A cell that is covered by the robot or its cost corridor while following a motion */
+struct SweptCell
+{
+    /** Offset relative to the start cell of the motion */
+    maps::grid::Index cell;
+    /** Index of the (earlier) swept cell that this cell is connected to.
+     *  -1 if this cell is part of Motion::intermediateStepsObstMap */
+    int parent;
+    /** Index into Motion::intermediateStepsObstMap. Only valid if parent is -1 */
+    int step;
+    /** Covered by the robot at at least one pose of the motion */
+    bool insideRobot;
+    /** Minimum distance to the robot over all poses. Only meaningful if !insideRobot */
+    double boundaryDistance;
+};
+
+/** Node of the prefix tree of the traversability map cells of all motions with the same start theta.
+ *  The nodes are stored in depth first (pre-)order, thus a subtree is a contiguous range of nodes
+ *  and the parent of a node is always located before the node. Node 0 is the start cell. */
+struct MotionTrieNode
+{
+    /** Full offset to the start cell */
+    maps::grid::Index cell;
+    /** Index of the parent node. -1 for the start cell */
+    int parent;
+    /** Index of the first node after the subtree of this node */
+    size_t subtreeEnd;
+    /** Indices (into PreComputedMotions::getMotionForStartTheta()) of the motions whose
+     *  Motion::intermediateStepsTravMap ends in this node */
+    std::vector<size_t> motions;
+};
+
 
 class Motion
 {    
@@ -40,7 +77,11 @@ public:
         MOV_LATERAL,
     };
 
-    Motion(unsigned int numAngles = 0) : endTheta(0, numAngles),startTheta(0, numAngles), baseCost(0), id(std::numeric_limits<size_t>::max()) {};
+    /** Motion::primitiveIndex of motions that have not been created from a spline primitive */
+    static constexpr size_t noPrimitive = std::numeric_limits<size_t>::max();
+
+    Motion(unsigned int numAngles = 0) : endTheta(0, numAngles),startTheta(0, numAngles), baseCost(0), id(std::numeric_limits<size_t>::max()),
+                                         primitiveIndex(noPrimitive), quarterTurns(0) {};
     
     static int calculateCost(double translationalDist, double angularDist, double translationVelocity, double angularVelocity, double costMultiplier);
     
@@ -50,6 +91,21 @@ public:
     DiscreteTheta startTheta;
     
     Type type;
+
+    //the scalar fields are read for every motion during expansion, they are kept in front of the step vectors
+    int baseCost; //time the robot needs to follow the primivite scaled by some factors
+    int costMultiplier;//is used to scale the baseCost (can be used to punish certain motions)
+    double translationlDist; //translational length of the motion
+    double angularDist; //angular length of the motion
+    
+    size_t id;
+
+    /** Index of the spline primitive of this motion in SbplSplineMotionPrimitives::getPrimitiveForAngle() of the
+     *  start angle rotated back by quarterTurns. Used to sample the motion on demand, see
+     *  PreComputedMotions::getFullSplineSamples() */
+    size_t primitiveIndex;
+    /** Number of 90 degree rotations (counter clockwise) of the primitive, see PreComputedMotions::setUseSymmetry() */
+    int quarterTurns;
     
     /**the intermediate poses are not discrete.
      * They are relative to the starting cell.
@@ -64,34 +120,90 @@ public:
      * cell idx is computed from the center of the start cell + pose
     */
     std::vector<PoseWithCell> intermediateStepsObstMap;
-    
+
     /**
-     * This vector contains a full resolution
-     * sample of the motion primitive, together
-     * with the cell the poses are supposed to 
-     * be in. Poses are relative to (0/0), while
-     * the cellIndex is computed relative to the 
-     * center of the start cell.
+     * All obstacle map cells that are covered by the robot or by the cost
+     * corridor around it at any of the intermediateStepsObstMap poses. Each cell
+     * is contained once. The cells are sorted in breadth first order starting from
+     * the intermediate steps, i.e. the parent of a cell is always located before the cell.
+     * Empty for point turns.
      * */
-    std::vector<CellWithPoses> fullSplineSamples;
-    
-    int baseCost; //time the robot needs to follow the primivite scaled by some factors
-    int costMultiplier;//is used to scale the baseCost (can be used to punish certain motions)
-    double translationlDist; //translational length of the motion
-    double angularDist; //angular length of the motion
-    
-    size_t id;
-    
+    std::vector<SweptCell> sweptFootprint;
+};
+
+/** Read only view of a contiguous array */
+template <class T>
+class ArrayView
+{
+public:
+    ArrayView(const T *first, size_t count) : first(first), count(count)
+    {
+    }
+
+    const T *begin() const
+    {
+        return first;
+    }
+
+    const T *end() const
+    {
+        return first + count;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    const T &operator[](size_t i) const
+    {
+        return first[i];
+    }
+
+private:
+    const T *first;
+    size_t count;
+};
+
+/** The motions with the same start theta */
+typedef ArrayView<Motion> MotionRange;
+
+/** Step of Motion::intermediateStepsObstMap, without the position of the pose */
+struct MotionStep
+{
+    /** Full offset to the start cell */
+    maps::grid::Index cell;
+    double orientation;
 };
 
 class PreComputedMotions
 {
-    //indexed by discrete start theta
-    std::vector<std::vector<Motion> > thetaToMotion;
+    //all motions, indexed by id. The motions of one start theta are stored contiguously
     std::vector<Motion> idToMotion;
+    //indexed by discrete start theta, [begin, end) of the motions in idToMotion
+    std::vector<std::pair<size_t, size_t> > thetaToMotion;
+    //indexed by discrete start theta
+    std::vector<std::vector<MotionTrieNode> > thetaToTrie;
+    //indexed by discrete start theta, keys (getDuplicateKey()) of the motions in thetaToMotion
+    std::vector<std::unordered_set<uint64_t> > thetaToMotionKeys;
+    //the obstacle map steps of all motions in one array, the steps of motion id are [obstacleStepOffsets[id], obstacleStepOffsets[id + 1])
+    std::vector<MotionStep> obstacleSteps;
+    std::vector<size_t> obstacleStepOffsets;
     sbpl_spline_primitives::SbplSplineMotionPrimitives primitives;
     Mobility mobilityConfig;
+    //resolution of the full spline samples
+    double travGridResolution;
+    bool loadedFromCache;
+    bool useSymmetry;
 public:
+    /** Name of the environment variable that sets the default cache directory */
+    static constexpr const char *cacheDirectoryVariable = "UGV_NAV4D_MOTION_CACHE";
+
     /**Initialize using spline based primitives.
      * @param mobilityConfig Will be used to configure and filter the splines.
      *                       mobilityConfig.mMinTurningRadius will be used to
@@ -99,19 +211,70 @@ public:
     PreComputedMotions(const sbpl_spline_primitives::SplinePrimitivesConfig& primitiveConfig,
                        const Mobility& mobilityConfig);
     
-    void readMotionPrimitives(const sbpl_spline_primitives::SbplSplineMotionPrimitives& primGen,
-                              const Mobility& mobilityConfig,
-                              double obstGridResolution, double travGridResolution);
-    
+    /** Computes the motions of all primitives.
+     *  If a cache directory is set, the motions are loaded from the cache file of the current configuration.
+     *  If there is none, the motions are computed and written to the cache. */
     void computeMotions(double obstGridResolution, double travGridResolution);
+
+    /** Sets the directory of the motion cache for all following computeMotions() calls of this process.
+     *  The cache contains one file per configuration (primitive config, mobility and grid resolutions).
+     *  An empty string disables the cache. Defaults to the value of the environment variable UGV_NAV4D_MOTION_CACHE.
+     *  Thread-safe. */
+    static void setCacheDirectory(const std::string& directory);
+
+    static std::string getCacheDirectory();
+
+    /** @return true if the motions of the last computeMotions() call have been loaded from the cache */
+    bool isLoadedFromCache() const;
+
+    /** If enabled and the primitives of theta + numAngles/4 are the 90 degree rotations of the primitives of theta,
+     *  only the primitives of the first quadrant are sampled. The motions of the other angles are derived by
+     *  rotating the cells and poses, which is about four times faster. Enabled by default.
+     *  Has no effect if the number of angles is not divisible by four (e.g. 42), all angles are sampled in that case */
+    void setUseSymmetry(bool enable);
+
+    bool getUseSymmetry() const;
+
+    /** @return true if the number of angles is divisible by four and the primitives of every angle are the
+     *          rotations of the primitives of the corresponding angle in the first quadrant (in the same order) */
+    static bool isQuarterSymmetric(const sbpl_spline_primitives::SbplSplineMotionPrimitives& primGen);
+
+    /** Computes Motion::sweptFootprint for all motions.
+     *  Needs to be called after computeMotions() and whenever the robot dimensions change.
+     *  @param footprint Footprint of the robot in obstacle map resolution */
+    void computeSweptFootprints(const RobotFootprint& footprint);
     
+    /** Adds @p motion behind the motions of @p theta. Motions with the same end cell, end theta and type are skipped.
+     *  The ids of all following motions are shifted, the motion tries and obstacle steps are rebuilt */
     void setMotionForTheta(const Motion &motion, const DiscreteTheta &theta);
     
     void preComputeCost(Motion &motion);
     
-    const std::vector<Motion> &getMotionForStartTheta(const DiscreteTheta &theta) const;
+    /** @return the motions with start @p theta. Invalidated by setMotionForTheta() and computeMotions() */
+    MotionRange getMotionForStartTheta(const DiscreteTheta &theta) const;
+
+    /** @return cells and orientations of Motion::intermediateStepsObstMap of motion @p id.
+     *          Stored in one array for all motions, which is faster to walk during expansion */
+    ArrayView<MotionStep> getObstacleSteps(std::size_t id) const
+    {
+        return ArrayView<MotionStep>(obstacleSteps.data() + obstacleStepOffsets[id], obstacleStepOffsets[id + 1] - obstacleStepOffsets[id]);
+    }
     
     const Motion &getMotion(std::size_t id) const; 
+
+    /** @return the number of motions, i.e. the ids are in [0, getNumMotions()) */
+    std::size_t getNumMotions() const;
+
+    /** @return the prefix tree of the Motion::intermediateStepsTravMap cells of all motions with start @p theta.
+     *          Motions that share their first cells share the corresponding nodes */
+    const std::vector<MotionTrieNode> &getMotionTrieForStartTheta(const DiscreteTheta &theta) const;
+
+    /** @return a full resolution sample of the spline of @p motion (spline_sampling_resolution), together
+     *          with the traversability map cell the poses are supposed to be in. Poses are relative to (0/0),
+     *          while the cells are computed relative to the center of the start cell.
+     *          The samples are only needed for the final trajectory, thus they are not stored but sampled
+     *          from the primitive on every call. Empty for point turns and for motions without primitive. */
+    std::vector<CellWithPoses> getFullSplineSamples(const Motion &motion) const;
     
     const sbpl_spline_primitives::SbplSplineMotionPrimitives& getPrimitives() const;
     
@@ -119,9 +282,45 @@ public:
     static double calculateCurvatureFromRadius(const double r);
 private:
     
-    void sampleOnResolution(double gridResolution, base::geometry::Spline2 spline, std::vector< ugv_nav4d::PoseWithCell >& result, std::vector< ugv_nav4d::CellWithPoses >& fullResult);
+    /** Samples all primitives of @p primGen and adds the resulting motions.
+     *  The angles are sampled in parallel (OpenMP), the ids are the same as for a sequential run.
+     *  See setUseSymmetry() */
+    void readMotionPrimitives(const sbpl_spline_primitives::SbplSplineMotionPrimitives& primGen,
+                              const Mobility& mobilityConfig,
+                              double obstGridResolution, double travGridResolution);
+
+    /** Inserts @p motion like setMotionForTheta() without rebuilding the motion tries and obstacle steps
+     *  @return false if the motion is a duplicate */
+    bool addMotion(const Motion &motion, const DiscreteTheta &theta);
+
+    /** Builds the motion tries and the obstacle steps of all motions */
+    void rebuildMotionTables();
+
+    void sampleOnResolution(double gridResolution, base::geometry::Spline2 spline, std::vector< ugv_nav4d::PoseWithCell >& result, std::vector< ugv_nav4d::CellWithPoses >& fullResult) const;
+
+    /** @return @p motion rotated by @p quarterTurns times 90 degrees counter clockwise around its start cell */
+    static Motion rotateQuarterTurns(const Motion& motion, int quarterTurns, int numAngles);
+
+    /** @return key of the end cell, end theta and type of @p motion.
+     *  Two motions with the same start theta and key are duplicates */
+    static uint64_t getDuplicateKey(const Motion& motion);
+
+    /** @return hash of all parameters that influence the computed motions */
+    uint64_t computeCacheKey(double obstGridResolution, double travGridResolution) const;
+
+    /** Replaces the motions by the motions of the cache file @p fileName.
+     *  @return false if the file does not exist or is invalid, the motions are unchanged in that case */
+    bool loadMotions(const std::string& fileName, uint64_t key);
+
+    /** Writes the motions to the cache file @p fileName. Errors are only logged */
+    void saveMotions(const std::string& fileName, uint64_t key) const;
     
-    base::Pose2D getPointClosestToCellMiddle(const ugv_nav4d::CellWithPoses& cwp, const double gridResolution);
+    void computeSweptFootprint(const RobotFootprint& footprint, Motion& motion) const;
+
+    /** Builds the prefix tree of @p motions */
+    static std::vector<MotionTrieNode> computeMotionTrie(const MotionRange& motions);
+
+    base::Pose2D getPointClosestToCellMiddle(const ugv_nav4d::CellWithPoses& cwp, const double gridResolution) const;
     
     
     void computeSplinePrimCost(const sbpl_spline_primitives::SplinePrimitive& prim,
@@ -0,0 +1,132 @@
+#include "RobotFootprint.hpp"
+#include "DiscreteTheta.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace ugv_nav4d
+{
+
+RobotFootprint::RobotFootprint(const traversability_generator3d::TraversabilityConfig& config) :
+    gridResolution(config.gridResolution),
+    robotSizeX(config.robotSizeX),
+    robotSizeY(config.robotSizeY),
+    costFunctionDist(config.costFunctionDist),
+    numAngles(0),
+    subCellSteps(0)
+{
+    const Eigen::Vector2d halfRobotDimension(robotSizeX / 2.0, robotSizeY / 2.0);
+    const Eigen::Vector2d halfOuterBoxDimension(halfRobotDimension + Eigen::Vector2d::Constant(costFunctionDist));
+
+    robotBoundingBox = Eigen::AlignedBox<double, 2>(- halfRobotDimension, halfRobotDimension);
+    costFunctionBoundingBox = Eigen::AlignedBox<double, 2>(- halfOuterBoxDimension, halfOuterBoxDimension);
+
+    edgePositions = {
+        Eigen::Vector2d(- gridResolution / 2.0, - gridResolution / 2.0),
+        Eigen::Vector2d(- gridResolution / 2.0, gridResolution / 2.0),
+        Eigen::Vector2d(gridResolution / 2.0, gridResolution / 2.0),
+        Eigen::Vector2d(gridResolution / 2.0, - gridResolution / 2.0)
+    };
+}
+
+bool RobotFootprint::matches(const traversability_generator3d::TraversabilityConfig& config) const
+{
+    return config.gridResolution == gridResolution && config.robotSizeX == robotSizeX &&
+           config.robotSizeY == robotSizeY && config.costFunctionDist == costFunctionDist;
+}
+
+RobotFootprint::Cell RobotFootprint::classify(const base::Vector2d& poseOffset, const Eigen::Rotation2D<double>& yawInverse,
+                                              const maps::grid::Index& cellOffset) const
+{
+    Cell cell;
+    const Eigen::Vector2d cellCenter(cellOffset.x() * gridResolution, cellOffset.y() * gridResolution);
+
+    for(const Eigen::Vector2d &ep : edgePositions)
+    {
+        //translate to robot center and rotate inverse to orientation of robot
+        const Eigen::Vector2d tp = yawInverse * (cellCenter + ep - poseOffset);
+
+        if(costFunctionBoundingBox.contains(tp))
+        {
+            cell.insideCorridor = true;
+
+            if(robotBoundingBox.contains(tp))
+            {
+                cell.insideRobot = true;
+                cell.robotDistance = cellCenter.norm();
+            }
+            else
+            {
+                cell.boundaryDistance = std::min(cell.boundaryDistance, robotBoundingBox.exteriorDistance(tp));
+            }
+        }
+    }
+    return cell;
+}
+
+RobotFootprint::Mask RobotFootprint::computeMask(const base::Vector2d& poseOffset, double orientation) const
+{
+    const Eigen::Rotation2D<double> yawInverse(Eigen::Rotation2D<double>(orientation).inverse());
+
+    //no corner outside of this radius can be inside the corridor
+    const double maxDist = costFunctionBoundingBox.sizes().norm() / 2.0 + poseOffset.norm() + gridResolution;
+
+    Mask mask;
+    mask.radius = std::ceil(maxDist / gridResolution);
+    const int width = 2 * mask.radius + 1;
+    mask.cells.resize(width * width);
+    for(int y = -mask.radius; y <= mask.radius; ++y)
+    {
+        for(int x = -mask.radius; x <= mask.radius; ++x)
+        {
+            mask.cells[(y + mask.radius) * width + x + mask.radius] = classify(poseOffset, yawInverse, maps::grid::Index(x, y));
+        }
+    }
+    return mask;
+}
+
+void RobotFootprint::precompute(unsigned int numAngles, unsigned int subCellSteps)
+{
+    this->numAngles = numAngles;
+    this->subCellSteps = subCellSteps;
+    masks.clear();
+    masks.reserve(numAngles * subCellSteps * subCellSteps);
+
+    for(unsigned int theta = 0; theta < numAngles; ++theta)
+    {
+        const double orientation = DiscreteTheta(static_cast<int>(theta), numAngles).getRadian();
+        for(unsigned int sy = 0; sy < subCellSteps; ++sy)
+        {
+            for(unsigned int sx = 0; sx < subCellSteps; ++sx)
+            {
+                const base::Vector2d offset(((sx + 0.5) / subCellSteps - 0.5) * gridResolution,
+                                            ((sy + 0.5) / subCellSteps - 0.5) * gridResolution);
+                masks.push_back(computeMask(offset, orientation));
+            }
+        }
+    }
+}
+
+const RobotFootprint::Mask* RobotFootprint::findMask(const base::Vector2d& poseOffset, double orientation) const
+{
+    static const double eps = 1e-6;
+
+    if(masks.empty())
+        return nullptr;
+
+    //snap to the closest precomputed heading and sub-cell offset
+    const long theta = std::lround(orientation * numAngles / (2.0 * M_PI));
+
+    long sub[2];
+    for(int i = 0; i < 2; ++i)
+    {
+        if(std::abs(poseOffset[i]) > gridResolution / 2.0 + eps)
+            return nullptr;
+        const double s = (poseOffset[i] / gridResolution + 0.5) * subCellSteps - 0.5;
+        sub[i] = std::min(std::max(std::lround(s), 0l), static_cast<long>(subCellSteps) - 1);
+    }
+
+    const long normalizedTheta = ((theta % static_cast<long>(numAngles)) + numAngles) % numAngles;
+    return &masks[(normalizedTheta * subCellSteps + sub[1]) * subCellSteps + sub[0]];
+}
+
+}
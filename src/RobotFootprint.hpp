@@ -0,0 +1,120 @@
+#pragma once
+
+#include <traversability_generator3d/TraversabilityConfig.hpp>
+#include <maps/grid/Index.hpp>
+#include <base/Eigen.hpp>
+#include <Eigen/Geometry>
+#include <limits>
+#include <vector>
+
+namespace ugv_nav4d
+{
+
+/** Describes which grid cells are covered by the robot bounding box and by the
+ *  config.costFunctionDist wide cost corridor around it.
+ *
+ *  A cell is covered if at least one of its corners is inside the box. All positions are
+ *  relative to the center of the cell that the robot pose is located in (the pose cell).
+ *
+ *  Since the robot size and the discrete headings are fixed during planning, masks for all
+ *  discrete headings (and optionally several sub-cell offsets) can be precomputed. A collision
+ *  check then only needs to look up the offset of a cell in the mask instead of rotating the
+ *  corners of the cell into the robot frame. */
+class RobotFootprint
+{
+public:
+
+    /** Classification of one cell relative to a robot pose */
+    struct Cell
+    {
+        /** At least one corner is inside the cost corridor (this includes the robot box) */
+        bool insideCorridor = false;
+        /** At least one corner is inside the robot box */
+        bool insideRobot = false;
+        /** Distance between the centers of the pose cell and this cell. Only valid if insideRobot */
+        double robotDistance = std::numeric_limits<double>::max();
+        /** Minimum distance of the corners that are inside the corridor but outside of the robot box
+         *  to the robot box. max() if there is no such corner */
+        double boundaryDistance = std::numeric_limits<double>::max();
+    };
+
+    /** Classification of all cells around one robot pose */
+    class Mask
+    {
+        friend class RobotFootprint;
+        /** The mask covers (2 * radius + 1)^2 cells centered on the pose cell */
+        int radius = 0;
+        std::vector<Cell> cells;
+    public:
+        /** @param offset Cell offset relative to the pose cell */
+        const Cell& at(const maps::grid::Index& offset) const
+        {
+            static const Cell outside;
+            if(std::abs(offset.x()) > radius || std::abs(offset.y()) > radius)
+                return outside;
+            return cells[(offset.y() + radius) * (2 * radius + 1) + offset.x() + radius];
+        }
+
+        int getRadius() const
+        {
+            return radius;
+        }
+    };
+
+    RobotFootprint(const traversability_generator3d::TraversabilityConfig& config);
+
+    /** Precomputes masks for all @p numAngles discrete headings.
+     *  @param subCellSteps Number of sub-cell offsets per axis. 1 means that only poses in the
+     *                      center of a cell are precomputed */
+    void precompute(unsigned int numAngles, unsigned int subCellSteps = 1);
+
+    /** @return true if this footprint has been created for the robot size, corridor width and
+     *          grid resolution of @p config */
+    bool matches(const traversability_generator3d::TraversabilityConfig& config) const;
+
+    /** Classifies a single cell.
+     *  @param poseOffset Position of the robot relative to the center of the pose cell
+     *  @param yawInverse Inverse of the robot orientation
+     *  @param cellOffset Offset of the cell relative to the pose cell */
+    Cell classify(const base::Vector2d& poseOffset, const Eigen::Rotation2D<double>& yawInverse,
+                  const maps::grid::Index& cellOffset) const;
+
+    /** Computes the mask of a robot pose.
+     *  @param poseOffset Position of the robot relative to the center of the pose cell */
+    Mask computeMask(const base::Vector2d& poseOffset, double orientation) const;
+
+    /** @return the precomputed mask that is closest to the given pose, or nullptr if nothing has been
+     *          precomputed or the position is not inside the pose cell.
+     *          The pose is snapped to the nearest sub-cell offset and discrete heading, thus the mask
+     *          may be off by up to half a sub-cell step per axis and half an angle step. Poses in the
+     *          cell center with a discrete heading are exact if subCellSteps is odd */
+    const Mask* findMask(const base::Vector2d& poseOffset, double orientation) const;
+
+    /** @return radius of the circle around the robot center that contains the robot box and the cost corridor */
+    double getOuterRadius() const
+    {
+        return costFunctionBoundingBox.sizes().norm() / 2.0;
+    }
+
+    double getGridResolution() const
+    {
+        return gridResolution;
+    }
+
+private:
+    double gridResolution;
+    double robotSizeX;
+    double robotSizeY;
+    double costFunctionDist;
+
+    Eigen::AlignedBox<double, 2> robotBoundingBox;
+    Eigen::AlignedBox<double, 2> costFunctionBoundingBox;
+    std::vector<Eigen::Vector2d> edgePositions;
+
+    unsigned int numAngles;
+    unsigned int subCellSteps;
+    /** indexed by (theta * subCellSteps + subCellY) * subCellSteps + subCellX */
+    std::vector<Mask> masks;
+};
+
+}
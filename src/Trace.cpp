@@ -0,0 +1,102 @@
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <thread>
+
+namespace ugv_nav4d
+{
+
+static_assert((TraceBuffer::capacity & (TraceBuffer::capacity - 1)) == 0, "capacity needs to be a power of two");
+
+constexpr size_t TraceEvent::maxValues;
+constexpr size_t TraceBuffer::capacity;
+
+TraceBuffer& TraceBuffer::instance()
+{
+    static TraceBuffer buffer;
+    return buffer;
+}
+
+TraceBuffer::TraceBuffer() : nextIndex(0), slots(capacity)
+{
+    for(Slot& slot : slots)
+        slot.sequence.store(0, std::memory_order_relaxed);
+}
+
+void TraceBuffer::record(TraceEvent::Level level, const char* file, int line, const char* name,
+                         std::initializer_list<double> values)
+{
+    const uint64_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot(slots[index & (capacity - 1)]);
+
+    //invalidate the slot for readers while it is written
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    TraceEvent& event(slot.event);
+    event.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    event.level = level;
+    event.file = file;
+    event.line = line;
+    event.name = name;
+    event.threadId = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    event.numValues = static_cast<uint32_t>(std::min(values.size(), TraceEvent::maxValues));
+    std::copy_n(values.begin(), event.numValues, event.values.begin());
+
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+std::vector<TraceEvent> TraceBuffer::snapshot() const
+{
+    std::vector<TraceEvent> events;
+    const uint64_t end = nextIndex.load(std::memory_order_acquire);
+    const uint64_t begin = end > capacity ? end - capacity : 0;
+    events.reserve(end - begin);
+
+    for(uint64_t index = begin; index < end; ++index)
+    {
+        const Slot& slot(slots[index & (capacity - 1)]);
+        if(slot.sequence.load(std::memory_order_acquire) != index + 1)
+            continue;
+
+        const TraceEvent event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        //the slot has been reused while copying
+        if(slot.sequence.load(std::memory_order_relaxed) != index + 1)
+            continue;
+
+        events.push_back(event);
+    }
+    return events;
+}
+
+void TraceBuffer::dump(std::ostream& out) const
+{
+    static const char *levelNames[] = {"DEBUG", "INFO", "WARN"};
+    for(const TraceEvent& event : snapshot())
+    {
+        out << event.timestamp << " [" << levelNames[event.level] << "] [" << event.file << '@' << event.line
+            << "] [" << event.threadId << "] " << event.name;
+        for(uint32_t i = 0; i < event.numValues; ++i)
+        {
+            out << ' ' << event.values[i];
+        }
+        out << '\n';
+    }
+}
+
+void TraceBuffer::clear()
+{
+    for(Slot& slot : slots)
+        slot.sequence.store(0, std::memory_order_relaxed);
+    nextIndex.store(0, std::memory_order_release);
+}
+
+uint64_t TraceBuffer::getNumRecorded() const
+{
+    return nextIndex.load(std::memory_order_relaxed);
+}
+
+}
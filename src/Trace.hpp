@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <iosfwd>
+#include <vector>
+
+/** Trace levels. Trace statements below UGV_NAV4D_TRACE_LEVEL are removed at compile time */
+#define UGV_NAV4D_TRACE_LEVEL_DEBUG 0
+#define UGV_NAV4D_TRACE_LEVEL_INFO 1
+#define UGV_NAV4D_TRACE_LEVEL_WARN 2
+#define UGV_NAV4D_TRACE_LEVEL_OFF 3
+
+#ifndef UGV_NAV4D_TRACE_LEVEL
+    #ifdef NDEBUG
+        #define UGV_NAV4D_TRACE_LEVEL UGV_NAV4D_TRACE_LEVEL_OFF
+    #else
+        #define UGV_NAV4D_TRACE_LEVEL UGV_NAV4D_TRACE_LEVEL_INFO
+    #endif
+#endif
+
+/** Records a trace event with a static @p name and up to TraceEvent::maxValues numeric values, e.g.
+ *  UGV_NAV4D_TRACE(DEBUG, "motion cost", {cost, slopeFactor});
+ *  The condition is a compile time constant, thus disabled statements (including the evaluation of
+ *  their values) are removed by the compiler. */
+#define UGV_NAV4D_TRACE(level, ...) \
+    do { \
+        if(UGV_NAV4D_TRACE_LEVEL_##level >= UGV_NAV4D_TRACE_LEVEL) \
+            ugv_nav4d::TraceBuffer::instance().record(ugv_nav4d::TraceEvent::level, __FILE__, __LINE__, __VA_ARGS__); \
+    } while(0)
+
+namespace ugv_nav4d
+{
+
+/** One structured trace record. No formatting is done while recording */
+struct TraceEvent
+{
+    enum Level
+    {
+        DEBUG = UGV_NAV4D_TRACE_LEVEL_DEBUG,
+        INFO = UGV_NAV4D_TRACE_LEVEL_INFO,
+        WARN = UGV_NAV4D_TRACE_LEVEL_WARN,
+    };
+
+    static constexpr size_t maxValues = 6;
+
+    /** nanoseconds of std::chrono::steady_clock */
+    uint64_t timestamp;
+    Level level;
+    /** static strings, only the pointers are stored */
+    const char *file;
+    int line;
+    const char *name;
+    uint32_t threadId;
+    uint32_t numValues;
+    std::array<double, maxValues> values;
+};
+
+/** Process wide ring buffer of trace events.
+ *
+ *  Recording is lock-free and may be done from any number of threads. A writer reserves a slot by
+ *  incrementing an atomic counter and publishes the slot by setting its sequence number afterwards.
+ *  If the buffer is full, the oldest events are overwritten. Readers copy slots and discard slots
+ *  that have been overwritten while copying. Events may get lost if writers overtake each other
+ *  by a whole buffer length, size the capacity accordingly.
+ */
+class TraceBuffer
+{
+public:
+    /** Number of events that are kept. Power of two */
+    static constexpr size_t capacity = 1 << 14;
+
+    static TraceBuffer& instance();
+
+    void record(TraceEvent::Level level, const char *file, int line, const char *name,
+                std::initializer_list<double> values = {});
+
+    /** @return all events that are currently stored, oldest first.
+     *          May be called while other threads are recording */
+    std::vector<TraceEvent> snapshot() const;
+
+    /** Writes all stored events as text, one line per event */
+    void dump(std::ostream& out) const;
+
+    /** Drops all stored events. Must not be called while other threads are recording */
+    void clear();
+
+    /** Number of events that have been recorded since the last clear(), including overwritten ones */
+    uint64_t getNumRecorded() const;
+
+private:
+    TraceBuffer();
+    TraceBuffer(const TraceBuffer&) = delete;
+    TraceBuffer& operator=(const TraceBuffer&) = delete;
+
+    struct Slot
+    {
+        /** index + 1 of the event in the slot, 0 if empty or being written */
+        std::atomic<uint64_t> sequence;
+        TraceEvent event;
+    };
+
+    std::atomic<uint64_t> nextIndex;
+    std::vector<Slot> slots;
+};
+
+}
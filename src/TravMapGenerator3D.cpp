@@ -0,0 +1,678 @@
+#include "TravMapGenerator3D.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <unordered_map>
+#include <omp.h>
+#include <base-logging/Logging.hpp>
+
+using namespace maps::grid;
+using traversability_generator3d::TravGenNode;
+
+namespace ugv_nav4d
+{
+
+namespace
+{
+    typedef std::pair<int, int> TileIndex;
+
+    int floorDiv(int a, int b)
+    {
+        return (a >= 0) ? a / b : -((-a + b - 1) / b);
+    }
+
+    /** color of a tile in the 2x2 pattern. Tiles of the same color never touch */
+    int tileColor(const TileIndex& tile)
+    {
+        return (tile.first & 1) | ((tile.second & 1) << 1);
+    }
+
+    const char nodesMagic[8] = {'U', 'G', 'V', '4', 'D', 'T', 'R', 'V'};
+    /** version 1 stored the heights as float */
+    const uint32_t nodesVersion = 2;
+    /** written in host byte order, maps of machines with a different byte order are rejected */
+    const uint32_t byteOrderMark = 0x01020304;
+
+    template <class T>
+    void writeValue(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof value);
+    }
+
+    template <class T>
+    void writeArray(std::ostream& out, const std::vector<T>& values)
+    {
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    template <class T>
+    void readValue(std::istream& in, T& value)
+    {
+        if(!in.read(reinterpret_cast<char*>(&value), sizeof value))
+            throw std::runtime_error("TravMapGenerator3D::loadNodes: Truncated map");
+    }
+
+    template <class T>
+    void readArray(std::istream& in, std::vector<T>& values, size_t size)
+    {
+        values.resize(size);
+        if(size && !in.read(reinterpret_cast<char*>(values.data()), size * sizeof(T)))
+            throw std::runtime_error("TravMapGenerator3D::loadNodes: Truncated map");
+    }
+
+    /** @return true if @p type is one of the node types that the generators assign */
+    bool validType(uint8_t type)
+    {
+        switch(static_cast<TraversabilityNodeBase::TYPE>(type))
+        {
+            case TraversabilityNodeBase::OBSTACLE:
+            case TraversabilityNodeBase::TRAVERSABLE:
+            case TraversabilityNodeBase::UNKNOWN:
+            case TraversabilityNodeBase::HOLE:
+            case TraversabilityNodeBase::UNSET:
+            case TraversabilityNodeBase::FRONTIER:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /** @return true if @p offsets are ascending, start at 0 and end at @p size */
+    bool validOffsets(const std::vector<uint32_t>& offsets, size_t size)
+    {
+        return offsets.front() == 0 && offsets.back() == size && std::is_sorted(offsets.begin(), offsets.end());
+    }
+}
+
+TravMapGenerator3D::TravMapGenerator3D(const traversability_generator3d::TraversabilityConfig& config) :
+    TraversabilityGenerator3d(config), tileSize(32), trackNeighborTableNodes(false)
+{
+    for(std::atomic<std::atomic<bool>*>& chunk : expandedChunks)
+        chunk.store(nullptr, std::memory_order_relaxed);
+}
+
+TravMapGenerator3D::~TravMapGenerator3D()
+{
+    for(std::atomic<std::atomic<bool>*>& chunk : expandedChunks)
+        delete[] chunk.load(std::memory_order_relaxed);
+}
+
+bool TravMapGenerator3D::expandNode(TravGenNode* node)
+{
+    //same checks as the expansion of the base class, only the node creation is serialized
+    node->setExpanded();
+
+    if(node->getType() == TraversabilityNodeBase::UNKNOWN)
+    {
+        return false;
+    }
+
+    if(node->getType() == TraversabilityNodeBase::OBSTACLE)
+    {
+        addToGrowListThreadSafe(node);
+        return false;
+    }
+
+    if(node->getUserData().slope > config.maxSlope)
+    {
+        node->setType(TraversabilityNodeBase::OBSTACLE);
+        addToGrowListThreadSafe(node);
+        return false;
+    }
+
+    if(!checkForObstacles(node))
+    {
+        node->setType(TraversabilityNodeBase::OBSTACLE);
+        addToGrowListThreadSafe(node);
+        return false;
+    }
+
+    if(config.enableInclineLimitting)
+    {
+        if(!computeAllowedOrientations(node))
+        {
+            node->setType(TraversabilityNodeBase::OBSTACLE);
+            addToGrowListThreadSafe(node);
+            return false;
+        }
+    }
+
+    //add sourounding
+    addConnectedPatchesThreadSafe(node);
+
+    if(checkForFrontier(node))
+    {
+        node->setType(TraversabilityNodeBase::FRONTIER);
+        return false;
+    }
+
+    node->setType(TraversabilityNodeBase::TRAVERSABLE);
+
+    return true;
+}
+
+void TravMapGenerator3D::addConnectedPatchesThreadSafe(TravGenNode* node)
+{
+    std::lock_guard<std::mutex> lock(nodeCreationLock);
+    addConnectedPatches(node);
+}
+
+void TravMapGenerator3D::addToGrowListThreadSafe(TravGenNode* node)
+{
+    #pragma omp critical(obstacleNodesGrowList)
+    {
+        obstacleNodesGrowList.push_back(node);
+    }
+}
+
+void TravMapGenerator3D::setTileSize(int size)
+{
+    if(size < 2)
+        throw std::runtime_error("TravMapGenerator3D::setTileSize: tile size needs to be at least 2");
+    tileSize = size;
+}
+
+bool TravMapGenerator3D::expandAllParallel(const std::vector<Eigen::Vector3d>& positions)
+{
+    auto tileOf = [this] (const Index& idx)
+    {
+        return TileIndex(floorDiv(idx.x(), tileSize), floorDiv(idx.y(), tileSize));
+    };
+
+    //unexpanded nodes, sorted by the tile that they belong to
+    std::map<TileIndex, std::vector<TravGenNode*>> pending;
+    for(const Eigen::Vector3d& pos : positions)
+    {
+        TravGenNode *startNode = generateStartNode(pos);
+        if(startNode && !startNode->isExpanded())
+            pending[tileOf(startNode->getIndex())].push_back(startNode);
+    }
+
+    //the expansion starts at the start nodes only, if they are expanded everything reachable is
+    if(pending.empty())
+        return false;
+
+    if(omp_get_max_threads() <= 1)
+    {
+        expandAll(positions);
+        //same ids as the parallel expansion
+        renumberNodes();
+        rebuildNeighborTables();
+        return true;
+    }
+
+    size_t numExpanded = 0;
+    while(!pending.empty())
+    {
+        for(int color = 0; color < 4; ++color)
+        {
+            std::vector<std::pair<TileIndex, std::vector<TravGenNode*>>> work;
+            for(auto it = pending.begin(); it != pending.end();)
+            {
+                if(tileColor(it->first) == color)
+                {
+                    work.emplace_back(it->first, std::move(it->second));
+                    it = pending.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            if(work.empty())
+                continue;
+
+            //nodes that have been discovered outside of the tile that discovered them
+            std::vector<std::vector<TravGenNode*>> handOver(work.size());
+
+            #pragma omp parallel for schedule(dynamic, 1) reduction(+:numExpanded)
+            for(size_t i = 0; i < work.size(); ++i)
+            {
+                const TileIndex tile = work[i].first;
+                std::deque<TravGenNode*> candidates(work[i].second.begin(), work[i].second.end());
+                while(!candidates.empty())
+                {
+                    TravGenNode *node = candidates.front();
+                    candidates.pop_front();
+
+                    if(node->isExpanded())
+                        continue;
+
+                    ++numExpanded;
+                    if(!expandNode(node))
+                        continue;
+
+                    for(TraversabilityNodeBase *n : node->getConnections())
+                    {
+                        if(n->isExpanded())
+                            continue;
+
+                        TravGenNode *neighbor = static_cast<TravGenNode*>(n);
+                        if(tileOf(neighbor->getIndex()) == tile)
+                            candidates.push_back(neighbor);
+                        else
+                            handOver[i].push_back(neighbor);
+                    }
+                }
+            }
+
+            for(const std::vector<TravGenNode*>& nodes : handOver)
+            {
+                for(TravGenNode *node : nodes)
+                {
+                    pending[tileOf(node->getIndex())].push_back(node);
+                }
+            }
+        }
+    }
+
+    //node ids depend on the order of the concurrent expansion
+    renumberNodes();
+
+    //all reachable nodes are expanded at this point. The sequential expansion returns right away but
+    //does any post processing that the generator does after expanding
+    expandAll(positions);
+    rebuildNeighborTables();
+
+    LOG_INFO_S << "TravMapGenerator3D: expanded " << numExpanded << " nodes using " << omp_get_max_threads() << " threads";
+    return true;
+}
+
+size_t TravMapGenerator3D::getLockStripe(const Index& idx) const
+{
+    return (static_cast<size_t>(idx.x()) * 73856093u ^ static_cast<size_t>(idx.y()) * 19349663u) % numLockStripes;
+}
+
+void TravMapGenerator3D::beginConcurrentExpansion()
+{
+    //node creation is serialized by addConnectedPatchesThreadSafe(), nothing to prepare
+}
+
+void TravMapGenerator3D::endConcurrentExpansion()
+{
+    updateNeighborTables();
+}
+
+bool TravMapGenerator3D::isExpansionFinished(const TravGenNode* node) const
+{
+    const size_t id = node->getUserData().id;
+    if(id / expandedChunkSize >= maxExpandedChunks)
+        return false;
+    const std::atomic<bool> *chunk = expandedChunks[id / expandedChunkSize].load(std::memory_order_acquire);
+    return chunk && chunk[id % expandedChunkSize].load(std::memory_order_acquire);
+}
+
+void TravMapGenerator3D::setExpansionFinished(const TravGenNode* node)
+{
+    const size_t id = node->getUserData().id;
+    if(id / expandedChunkSize >= maxExpandedChunks)
+        return;
+
+    std::atomic<std::atomic<bool>*>& slot(expandedChunks[id / expandedChunkSize]);
+    std::atomic<bool> *chunk = slot.load(std::memory_order_acquire);
+    if(!chunk)
+    {
+        std::atomic<bool> *newChunk = new std::atomic<bool>[expandedChunkSize];
+        for(size_t i = 0; i < expandedChunkSize; ++i)
+            newChunk[i].store(false, std::memory_order_relaxed);
+        //another thread might have allocated the chunk in the meantime
+        if(slot.compare_exchange_strong(chunk, newChunk, std::memory_order_acq_rel))
+            chunk = newChunk;
+        else
+            delete[] newChunk;
+    }
+    chunk[id % expandedChunkSize].store(true, std::memory_order_release);
+}
+
+void TravMapGenerator3D::resetExpansionFlags()
+{
+    for(std::atomic<std::atomic<bool>*>& slot : expandedChunks)
+    {
+        std::atomic<bool> *chunk = slot.load(std::memory_order_relaxed);
+        if(!chunk)
+            continue;
+        for(size_t i = 0; i < expandedChunkSize; ++i)
+            chunk[i].store(false, std::memory_order_relaxed);
+    }
+
+    for(const LevelList<TravGenNode *> &l : trMap)
+    {
+        for(const TravGenNode *n : l)
+        {
+            if(n->isExpanded())
+                setExpansionFinished(n);
+        }
+    }
+}
+
+bool TravMapGenerator3D::expandNodeThreadSafe(TravGenNode* node)
+{
+    if(isExpansionFinished(node))
+    {
+        return true;
+    }
+
+    //expandNode() modifies the node and its 8-neighborhood. Lock all stripes that belong to that area
+    //in ascending order to avoid dead locks. The checks of expandNode() run concurrently for nodes
+    //that are not close to each other, only the node creation inside of it takes a global lock
+    std::array<size_t, 9> stripes;
+    size_t numStripes = 0;
+    for(int y = -1; y <= 1; ++y)
+    {
+        for(int x = -1; x <= 1; ++x)
+        {
+            const Index cell(node->getIndex() + Index(x, y));
+            if(!trMap.inGrid(cell))
+                continue;
+            stripes[numStripes++] = getLockStripe(cell);
+        }
+    }
+    std::sort(stripes.begin(), stripes.begin() + numStripes);
+    numStripes = std::unique(stripes.begin(), stripes.begin() + numStripes) - stripes.begin();
+
+    std::array<std::unique_lock<std::mutex>, 9> locks;
+    for(size_t i = 0; i < numStripes; ++i)
+    {
+        locks[i] = std::unique_lock<std::mutex>(expansionLocks[stripes[i]]);
+    }
+
+    if(node->isExpanded())
+    {
+        //somebody else expanded the node while we were waiting for the lock or it has been
+        //expanded by expandNode() directly
+        setExpansionFinished(node);
+        return true;
+    }
+
+    const bool result = expandNode(node);
+    setExpansionFinished(node);
+
+    addNeighborTableNode(node);
+
+    return result;
+}
+
+void TravMapGenerator3D::addNeighborTableNode(TravGenNode* node)
+{
+    //the tables are rebuilt from scratch anyway
+    if(!trackNeighborTableNodes)
+        return;
+
+    #pragma omp critical(newNeighborTableNodes)
+    {
+        newNeighborTableNodes.push_back(node);
+    }
+}
+
+void TravMapGenerator3D::computeNeighborTable(TravGenNode* node)
+{
+    const size_t id = node->getUserData().id;
+    if(id >= neighborTables.size())
+        neighborTables.resize(id + 1);
+
+    NeighborTable& table(neighborTables[id]);
+    table.nodes.fill(nullptr);
+    for(TraversabilityNodeBase *connected : node->getConnections())
+    {
+        //getConnectedNode() returns the first connection to a cell
+        const int direction = getNeighborDirection(connected->getIndex() - node->getIndex());
+        if(direction >= 0 && !table.nodes[direction])
+            table.nodes[direction] = static_cast<TravGenNode*>(connected);
+    }
+    table.numConnections = node->getConnections().size();
+}
+
+void TravMapGenerator3D::rebuildNeighborTables()
+{
+    neighborTables.assign(getNumNodes(), NeighborTable());
+    newNeighborTableNodes.clear();
+    trackNeighborTableNodes = true;
+
+    for(LevelList<TravGenNode *> &l : trMap)
+    {
+        for(TravGenNode *n : l)
+        {
+            computeNeighborTable(n);
+        }
+    }
+}
+
+void TravMapGenerator3D::updateNeighborTables()
+{
+    for(TravGenNode *n : newNeighborTableNodes)
+    {
+        computeNeighborTable(n);
+        //the expansion connects the neighbors to the node as well
+        for(TraversabilityNodeBase *connected : n->getConnections())
+        {
+            computeNeighborTable(static_cast<TravGenNode*>(connected));
+        }
+    }
+    newNeighborTableNodes.clear();
+}
+
+void TravMapGenerator3D::clearNeighborTables()
+{
+    neighborTables.clear();
+    newNeighborTableNodes.clear();
+    trackNeighborTableNodes = false;
+}
+
+void TravMapGenerator3D::clearNodeTables()
+{
+    clearNeighborTables();
+    resetExpansionFlags();
+}
+
+void TravMapGenerator3D::saveNodes(std::ostream& out) const
+{
+    std::unordered_map<const TraversabilityNodeBase*, uint32_t> nodeIds;
+    std::vector<const TravGenNode*> nodes;
+    for(const LevelList<TravGenNode *> &l : trMap)
+    {
+        for(const TravGenNode *n : l)
+        {
+            nodeIds[n] = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(n);
+        }
+    }
+
+    const size_t numNodes = nodes.size();
+    std::vector<int32_t> cellX(numNodes), cellY(numNodes);
+    std::vector<uint8_t> types(numNodes), expanded(numNodes);
+    std::vector<double> heights(numNodes), slopes(numNodes), slopeDirectionAtan2(numNodes), slopeDirections(3 * numNodes), planes(4 * numNodes);
+    std::vector<uint32_t> orientationOffsets(1, 0), connectionOffsets(1, 0);
+    std::vector<double> orientations;
+    std::vector<uint32_t> connections;
+
+    for(size_t i = 0; i < numNodes; ++i)
+    {
+        const TravGenNode *n = nodes[i];
+        const traversability_generator3d::TravGenNodeData& data(n->getUserData());
+        cellX[i] = n->getIndex().x();
+        cellY[i] = n->getIndex().y();
+        heights[i] = n->getHeight();
+        types[i] = static_cast<uint8_t>(n->getType());
+        expanded[i] = n->isExpanded();
+        slopes[i] = data.slope;
+        slopeDirectionAtan2[i] = data.slopeDirectionAtan2;
+        Eigen::Vector3d::Map(&slopeDirections[3 * i]) = data.slopeDirection;
+        Eigen::Vector4d::Map(&planes[4 * i]) = data.plane.coeffs();
+
+        for(const base::AngleSegment& segment : data.allowedOrientations)
+        {
+            orientations.push_back(segment.getStart().getRad());
+            orientations.push_back(segment.getWidth());
+        }
+        orientationOffsets.push_back(static_cast<uint32_t>(orientations.size() / 2));
+
+        for(const TraversabilityNodeBase *connected : n->getConnections())
+        {
+            const auto it = nodeIds.find(connected);
+            if(it == nodeIds.end())
+                throw std::runtime_error("TravMapGenerator3D::saveNodes: Node is connected to a node outside of the map");
+            connections.push_back(it->second);
+        }
+        connectionOffsets.push_back(static_cast<uint32_t>(connections.size()));
+    }
+
+    out.write(nodesMagic, sizeof nodesMagic);
+    writeValue(out, nodesVersion);
+    writeValue(out, byteOrderMark);
+    writeValue(out, static_cast<int32_t>(trMap.getNumCells().x()));
+    writeValue(out, static_cast<int32_t>(trMap.getNumCells().y()));
+    writeValue(out, trMap.getResolution().x());
+    writeValue(out, trMap.getResolution().y());
+    writeValue(out, static_cast<uint32_t>(numNodes));
+    writeValue(out, static_cast<uint32_t>(orientations.size() / 2));
+    writeValue(out, static_cast<uint32_t>(connections.size()));
+
+    writeArray(out, cellX);
+    writeArray(out, cellY);
+    writeArray(out, heights);
+    writeArray(out, types);
+    writeArray(out, expanded);
+    writeArray(out, slopes);
+    writeArray(out, slopeDirectionAtan2);
+    writeArray(out, slopeDirections);
+    writeArray(out, planes);
+    writeArray(out, orientationOffsets);
+    writeArray(out, orientations);
+    writeArray(out, connectionOffsets);
+    writeArray(out, connections);
+
+    if(!out)
+        throw std::runtime_error("TravMapGenerator3D::saveNodes: Cannot write map");
+}
+
+void TravMapGenerator3D::loadNodes(std::istream& in)
+{
+    char magic[sizeof nodesMagic];
+    if(!in.read(magic, sizeof magic) || std::memcmp(magic, nodesMagic, sizeof magic) != 0)
+        throw std::runtime_error("TravMapGenerator3D::loadNodes: Not a traversability map");
+
+    uint32_t version, bom;
+    readValue(in, version);
+    readValue(in, bom);
+    if(version != nodesVersion && version != 1)
+        throw std::runtime_error("TravMapGenerator3D::loadNodes: Unsupported version " + std::to_string(version));
+    if(bom != byteOrderMark)
+        throw std::runtime_error("TravMapGenerator3D::loadNodes: The map has been saved on a machine with a different byte order");
+
+    int32_t numCellsX, numCellsY;
+    double resolutionX, resolutionY;
+    uint32_t numNodes, numOrientations, numConnections;
+    readValue(in, numCellsX);
+    readValue(in, numCellsY);
+    readValue(in, resolutionX);
+    readValue(in, resolutionY);
+    readValue(in, numNodes);
+    readValue(in, numOrientations);
+    readValue(in, numConnections);
+
+    if(numCellsX != trMap.getNumCells().x() || numCellsY != trMap.getNumCells().y() ||
+       std::abs(resolutionX - trMap.getResolution().x()) > 1e-9 || std::abs(resolutionY - trMap.getResolution().y()) > 1e-9)
+        throw std::runtime_error("TravMapGenerator3D::loadNodes: The map has been generated for a different mls map");
+
+    std::vector<int32_t> cellX, cellY;
+    std::vector<uint8_t> types, expanded;
+    std::vector<double> heights, slopes, slopeDirectionAtan2, slopeDirections, planes, orientations;
+    std::vector<uint32_t> orientationOffsets, connectionOffsets, connections;
+    readArray(in, cellX, numNodes);
+    readArray(in, cellY, numNodes);
+    if(version == 1)
+    {
+        std::vector<float> floatHeights;
+        readArray(in, floatHeights, numNodes);
+        heights.assign(floatHeights.begin(), floatHeights.end());
+    }
+    else
+    {
+        readArray(in, heights, numNodes);
+    }
+    readArray(in, types, numNodes);
+    readArray(in, expanded, numNodes);
+    readArray(in, slopes, numNodes);
+    readArray(in, slopeDirectionAtan2, numNodes);
+    readArray(in, slopeDirections, 3 * size_t(numNodes));
+    readArray(in, planes, 4 * size_t(numNodes));
+    readArray(in, orientationOffsets, size_t(numNodes) + 1);
+    readArray(in, orientations, 2 * size_t(numOrientations));
+    readArray(in, connectionOffsets, size_t(numNodes) + 1);
+    readArray(in, connections, numConnections);
+
+    //validate everything before the current map is replaced
+    if(!validOffsets(orientationOffsets, numOrientations) || !validOffsets(connectionOffsets, numConnections))
+        throw std::runtime_error("TravMapGenerator3D::loadNodes: Invalid offsets");
+    for(uint32_t id : connections)
+    {
+        if(id >= numNodes)
+            throw std::runtime_error("TravMapGenerator3D::loadNodes: Invalid connection");
+    }
+    for(size_t i = 0; i < numNodes; ++i)
+    {
+        if(!trMap.inGrid(Index(cellX[i], cellY[i])))
+            throw std::runtime_error("TravMapGenerator3D::loadNodes: Node outside of the map");
+        if(!validType(types[i]))
+            throw std::runtime_error("TravMapGenerator3D::loadNodes: Invalid node type " + std::to_string(types[i]));
+    }
+
+    clearTrMap();
+    obstacleNodesGrowList.clear();
+
+    std::vector<TravGenNode*> nodes(numNodes);
+    for(size_t i = 0; i < numNodes; ++i)
+    {
+        const Index idx(cellX[i], cellY[i]);
+        TravGenNode *n = new TravGenNode(heights[i], idx);
+        traversability_generator3d::TravGenNodeData& data(n->getUserData());
+        data.id = i;
+        data.slope = slopes[i];
+        data.slopeDirectionAtan2 = slopeDirectionAtan2[i];
+        data.slopeDirection = Eigen::Vector3d::Map(&slopeDirections[3 * i]);
+        data.plane.coeffs() = Eigen::Vector4d::Map(&planes[4 * i]);
+        for(uint32_t s = orientationOffsets[i]; s < orientationOffsets[i + 1]; ++s)
+        {
+            data.allowedOrientations.push_back(base::AngleSegment(base::Angle::fromRad(orientations[2 * s]), orientations[2 * s + 1]));
+        }
+        n->setType(static_cast<TraversabilityNodeBase::TYPE>(types[i]));
+        if(expanded[i])
+            n->setExpanded();
+
+        trMap.at(idx).insert(n);
+        nodes[i] = n;
+    }
+
+    for(size_t i = 0; i < numNodes; ++i)
+    {
+        for(uint32_t c = connectionOffsets[i]; c < connectionOffsets[i + 1]; ++c)
+        {
+            nodes[i]->addConnection(nodes[connections[c]]);
+        }
+    }
+
+    currentNodeId = numNodes;
+    resetExpansionFlags();
+    rebuildNeighborTables();
+}
+
+void TravMapGenerator3D::renumberNodes()
+{
+    int id = 0;
+    for(LevelList<TravGenNode *> &l : trMap)
+    {
+        for(TravGenNode *n : l)
+        {
+            n->getUserData().id = id++;
+        }
+    }
+    currentNodeId = id;
+    resetExpansionFlags();
+}
+
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include <traversability_generator3d/TraversabilityGenerator3d.hpp>
+#include <array>
+#include <atomic>
+#include <iosfwd>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace ugv_nav4d
+{
+    /** Traversability map generator that is able to expand the map using several threads.
+     *
+     *  The parallel expansion partitions the grid into square tiles of tileSize x tileSize cells.
+     *  Tiles are colored in a 2x2 pattern. Tiles of the same color never touch, thus the cells
+     *  that are modified when expanding nodes of one tile (the node itself and its 8-neighborhood)
+     *  never overlap with the cells modified by another tile of the same color. All tiles of one
+     *  color are expanded concurrently. Nodes that are discovered in a neighboring tile are handed
+     *  over to that tile and expanded when its color is processed. This is repeated until no
+     *  unexpanded nodes are left.
+     *
+     *  The resulting map contains the same nodes, types and connections as the sequential expansion.
+     *  Only the node ids differ, they are renumbered deterministically after the expansion.
+     *
+     *  The base class creates nodes using a counter that is not thread-safe. expandNode() of this class
+     *  therefore does the checks of the base class expansion concurrently and only creates the neighboring
+     *  nodes (addConnectedPatches(), including the plane fit of new nodes) under one lock. Subclasses that
+     *  override expandNode() have to create nodes using addConnectedPatchesThreadSafe() as well.
+     *
+     *  Lazy expansion during planning is done using expandNodeThreadSafe(). Instead of one global
+     *  lock, a fixed set of striped locks keyed by grid index is used. An expansion locks the stripes
+     *  of the 3x3 neighborhood of the node, thus only expansions of nodes that are close to each
+     *  other are serialized. Expansions of other nodes only wait for each other while they create
+     *  nodes, see expandNode(). Nodes whose expansion has finished are recognized without any lock
+     *  using a table of atomic flags indexed by node id.
+     *
+     *  An expanded map can be saved using saveNodes() and restored using loadNodes(), which is much
+     *  faster than expanding it again from the mls map.
+     *
+     *  Motions walk the map cell by cell. Instead of searching the connection list of a node for every
+     *  step, getConnectedNeighbor() looks the next node up in a table that maps the 8 neighboring cells
+     *  of a node to the connected nodes. The tables are maintained along with the expansion.
+     */
+    class TravMapGenerator3D : public traversability_generator3d::TraversabilityGenerator3d
+    {
+    public:
+        TravMapGenerator3D(const traversability_generator3d::TraversabilityConfig &config);
+        virtual ~TravMapGenerator3D();
+
+        /** Same as the expansion of the base class. Only the creation of the neighboring nodes is serialized */
+        virtual bool expandNode(traversability_generator3d::TravGenNode *node) override;
+
+        /** Expands the map starting from all given @p positions.
+         *  Same result as expandAll(positions) but uses all available OpenMP threads.
+         *  Falls back to the sequential expandAll() if only one thread is available.
+         *  If nodes have been expanded, the nodes are renumbered and the neighbor tables are rebuilt.
+         *  @return true if any node has been expanded. Nothing changes otherwise */
+        bool expandAllParallel(const std::vector<Eigen::Vector3d>& positions);
+
+        /** Size (in cells) of the tiles used during parallel expansion. Needs to be at least 2. */
+        void setTileSize(int size);
+
+        /** Has to be called (from a single thread) before expandNodeThreadSafe() is used concurrently */
+        void beginConcurrentExpansion();
+
+        /** Has to be called (from a single thread) after all concurrent calls to expandNodeThreadSafe() are done.
+         *  Updates the neighbor tables of the nodes that have been expanded. */
+        void endConcurrentExpansion();
+
+        /** Expands @p node if it needs expansion.
+         *  May be called concurrently for different nodes. Returns without locking if the
+         *  expansion of the node has finished before.
+         *  @return True if the node was already expanded or if the expansion succeeded */
+        bool expandNodeThreadSafe(traversability_generator3d::TravGenNode *node);
+
+        /** Writes all nodes of the map (type, height, slope, plane, allowed orientations, expansion state and
+         *  connections) in a compact indexed format. Nodes are written as arrays in grid order, connections
+         *  as indices into these arrays. Numbers are written in host byte order. Not thread-safe. */
+        void saveNodes(std::ostream& out) const;
+
+        /** Replaces all nodes of the map by nodes written by saveNodes(). Nodes are numbered in grid order.
+         *  The map has to be generated for the same mls map (same size and resolution).
+         *  @throw std::runtime_error if the data is invalid or does not fit to the map. The map is unchanged in that case */
+        void loadNodes(std::istream& in);
+
+        /** @return the node that @p node is connected to in cell @p idx or nullptr, same as node->getConnectedNode(idx).
+         *          A single lookup if @p idx is a neighboring cell and the neighbor table of the node is up to date,
+         *          otherwise the connection list is searched. Thread-safe. */
+        traversability_generator3d::TravGenNode* getConnectedNeighbor(traversability_generator3d::TravGenNode* node, const maps::grid::Index& idx) const
+        {
+            const size_t id = node->getUserData().id;
+            const int direction = getNeighborDirection(idx - node->getIndex());
+            if(direction >= 0 && id < neighborTables.size() && neighborTables[id].numConnections == node->getConnections().size())
+                return neighborTables[id].nodes[direction];
+            return node->getConnectedNode(idx);
+        }
+
+        /** Computes the neighbor tables of all nodes.
+         *  Called by expandAllParallel() and loadNodes(). Not thread-safe. */
+        void rebuildNeighborTables();
+
+        /** Computes the neighbor tables of the nodes that have been expanded by expandNodeThreadSafe()
+         *  since the last update and of the nodes connected to them. Not thread-safe. */
+        void updateNeighborTables();
+
+        /** Forgets all neighbor tables */
+        void clearNeighborTables();
+
+        /** Forgets the neighbor tables and the expansion flags of expandNodeThreadSafe(). Has to be called
+         *  if the map is cleared or replaced by other means than loadNodes(), e.g. by setMLSGrid() or clearTrMap().
+         *  Not thread-safe. */
+        void clearNodeTables();
+
+    protected:
+        /** addConnectedPatches() of the base class. Serialized, because it creates nodes. */
+        void addConnectedPatchesThreadSafe(traversability_generator3d::TravGenNode *node);
+
+        /** Adds @p node to the obstacle grow list of the base class. Thread-safe. */
+        void addToGrowListThreadSafe(traversability_generator3d::TravGenNode *node);
+
+        /** Gives every node in the map a new unique id. Ids are assigned in grid order and are
+         *  in the range [0, getNumNodes()). Not thread-safe. */
+        void renumberNodes();
+
+    private:
+        static constexpr size_t numLockStripes = 256;
+        static constexpr size_t expandedChunkSize = 1 << 16;
+        /** nodes with larger ids are always expanded using the locks */
+        static constexpr size_t maxExpandedChunks = 1 << 12;
+
+        size_t getLockStripe(const maps::grid::Index& idx) const;
+
+        /** The nodes that a node is connected to in its 8 neighboring cells */
+        struct NeighborTable
+        {
+            /** nullptr if there is no connection to the cell */
+            std::array<traversability_generator3d::TravGenNode*, 8> nodes;
+            /** size of the connection list when the table has been computed. The table
+             *  is outdated if the node has been connected to other nodes since then */
+            size_t numConnections;
+
+            NeighborTable() : numConnections(std::numeric_limits<size_t>::max())
+            {
+                nodes.fill(nullptr);
+            }
+        };
+
+        /** @return the index of the neighboring cell at offset @p diff in NeighborTable::nodes or -1 if it is no neighbor */
+        static int getNeighborDirection(const maps::grid::Index& diff)
+        {
+            if(diff.x() < -1 || diff.x() > 1 || diff.y() < -1 || diff.y() > 1)
+                return -1;
+            //row major 3x3 block without the center
+            const int cell = (diff.y() + 1) * 3 + diff.x() + 1;
+            return cell < 4 ? cell : (cell == 4 ? -1 : cell - 1);
+        }
+
+        void computeNeighborTable(traversability_generator3d::TravGenNode* node);
+
+        /** Remembers @p node for the next updateNeighborTables() if the tables have been built. Thread-safe. */
+        void addNeighborTableNode(traversability_generator3d::TravGenNode* node);
+
+        /** @return true if the expansion of @p node has finished. Lock-free */
+        bool isExpansionFinished(const traversability_generator3d::TravGenNode* node) const;
+
+        /** Publishes that the expansion of @p node has finished. Thread-safe */
+        void setExpansionFinished(const traversability_generator3d::TravGenNode* node);
+
+        /** Sets the expansion flags of all nodes to their expansion state, e.g. after the ids changed. Not thread-safe */
+        void resetExpansionFlags();
+
+        int tileSize;
+
+        std::array<std::mutex, numLockStripes> expansionLocks;
+
+        /** Serializes the node creation of the base class, it uses a counter that is not thread-safe */
+        std::mutex nodeCreationLock;
+
+        /** Indexed by node id, true if the expansion has finished. expandNode() marks a node as expanded
+         *  before it is done, thus TraversabilityNodeBase::isExpanded() cannot be trusted while nodes are
+         *  expanded concurrently. Allocated in chunks of expandedChunkSize flags that are never moved. */
+        std::array<std::atomic<std::atomic<bool>*>, maxExpandedChunks> expandedChunks;
+
+        /** indexed by node id. Only modified while no expansion is running */
+        std::vector<NeighborTable> neighborTables;
+        /** false until the tables have been built */
+        bool trackNeighborTableNodes;
+        /** nodes that have been expanded since the last update of the tables */
+        std::vector<traversability_generator3d::TravGenNode*> newNeighborTableNodes;
+    };
+}
@@ -0,0 +1,625 @@
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "ugv_nav4d/Planner.hpp"
+#include "ugv_nav4d/EnvironmentXYZTheta.hpp"
+#include "ugv_nav4d/ObstacleMapGenerator3D.hpp"
+#include <traversability_generator3d/TraversabilityConfig.hpp>
+#include <sbpl/utils/mdpconfig.h>
+#include <maps/grid/MLSMap.hpp>
+#include <omp.h>
+
+#include <pcl/io/ply_io.h>
+#include <pcl/common/common.h>
+#include <pcl/common/transforms.h>
+
+/** Benchmarks of the planning pipeline on the maps in test_data.
+ *
+ *  Every benchmark is run once per map (the first argument is the index into benchmarkMaps),
+ *  except for BM_ComputeMotions and BM_DiscreteTheta which do not need a map
+ *  and BM_HeadingMask which always uses ramp.
+ *  The results are written to ugv_nav4d_benchmark.json unless --benchmark_out is given.
+ *  The location of the maps can be changed using the environment variable UGV_NAV4D_TEST_DATA_DIR.
+ */
+
+using namespace ugv_nav4d;
+
+namespace
+{
+
+/** A map of test_data and the start and goal of the search on it.
+ *  The maps are moved to the origin when loaded */
+struct BenchmarkMap
+{
+    std::string name;
+    Eigen::Vector3d start;
+    Eigen::Vector3d goal;
+};
+
+/** The start and goal of test_area and Plane1Mio are the ones of test_ugv_nav4d.
+ *  TODO verify the start and goal of parking_deck, ramp and test_area2. checkMap() skips the
+ *  benchmarks of a map with an error if there is no solution */
+const std::vector<BenchmarkMap> benchmarkMaps = {
+    {"parking_deck", Eigen::Vector3d(2.3, 4.1, 0.0), Eigen::Vector3d(6.1, 4.2, 0.0)},
+    {"ramp", Eigen::Vector3d(2.3, 4.1, 0.0), Eigen::Vector3d(6.1, 4.2, 0.0)},
+    {"test_area", Eigen::Vector3d(2.3, 4.1, 0.0), Eigen::Vector3d(6.1, 4.2, 0.0)},
+    {"test_area2", Eigen::Vector3d(2.3, 4.1, 0.0), Eigen::Vector3d(6.1, 4.2, 0.0)},
+    {"Plane1Mio", Eigen::Vector3d(2.3, 4.1, 0.0), Eigen::Vector3d(6.1, 4.2, 0.0)}
+};
+
+/** Planning time of checkMap() and BM_Plan in seconds */
+const double maxPlanningTime = 5;
+
+/** Number of states that are expanded by BM_GetSuccs */
+const size_t numSuccessorExpansions = 1000;
+
+/** Same configuration as test_ugv_nav4d */
+struct Configs
+{
+    sbpl_spline_primitives::SplinePrimitivesConfig splinePrimitiveConfig;
+    Mobility mobility;
+    traversability_generator3d::TraversabilityConfig traversabilityConfig;
+    PlannerConfig plannerConfig;
+
+    Configs()
+    {
+        splinePrimitiveConfig.gridSize=0.3;
+        splinePrimitiveConfig.numAngles=42;
+        splinePrimitiveConfig.numEndAngles=21;
+        splinePrimitiveConfig.destinationCircleRadius=10;
+        splinePrimitiveConfig.cellSkipFactor=3;
+        splinePrimitiveConfig.splineOrder=4.0;
+
+        mobility.translationSpeed=0.5;
+        mobility.rotationSpeed=0.5;
+        mobility.minTurningRadius=1;
+        mobility.spline_sampling_resolution=0.05;
+        mobility.remove_goal_offset=true;
+        mobility.multiplierForward=1;
+        mobility.multiplierBackward=3;
+        mobility.multiplierPointTurn=3;
+        mobility.multiplierLateral=4;
+        mobility.multiplierForwardTurn=2;
+        mobility.multiplierBackwardTurn=4;
+        mobility.multiplierLateralCurve=4;
+        mobility.searchRadius=0.0;
+        mobility.searchProgressSteps=0.1;
+        mobility.maxMotionCurveLength=100;
+
+        traversabilityConfig.maxStepHeight=0.25;
+        traversabilityConfig.maxSlope=0.45;
+        traversabilityConfig.inclineLimittingMinSlope=0.2;
+        traversabilityConfig.inclineLimittingLimit=0.1;
+        traversabilityConfig.costFunctionDist=0.0;
+        traversabilityConfig.minTraversablePercentage=0.4;
+        traversabilityConfig.robotHeight=1.2;
+        traversabilityConfig.robotSizeX=1.35;
+        traversabilityConfig.robotSizeY=0.85;
+        traversabilityConfig.distToGround=0.0;
+        traversabilityConfig.slopeMetricScale=1.0;
+        traversabilityConfig.slopeMetric=traversability_generator3d::NONE;
+        traversabilityConfig.gridResolution=0.3;
+        traversabilityConfig.initialPatchVariance=0.0001;
+        traversabilityConfig.allowForwardDownhill=true;
+        traversabilityConfig.enableInclineLimitting=false;
+
+        plannerConfig.searchUntilFirstSolution=false;
+        plannerConfig.initialEpsilon=64;
+        plannerConfig.epsilonSteps=2;
+        plannerConfig.numThreads=8;
+    }
+};
+
+std::string getMapPath(const std::string& name)
+{
+    const char *dir = std::getenv("UGV_NAV4D_TEST_DATA_DIR");
+    return std::string(dir ? dir : UGV_NAV4D_TEST_DATA_DIR) + "/" + name + ".ply";
+}
+
+/** @return the point cloud of map @p index moved to the origin, nullptr if it cannot be loaded.
+ *          Loaded clouds are kept for the following benchmarks */
+pcl::PointCloud<pcl::PointXYZ>::ConstPtr getPointCloud(size_t index)
+{
+    static std::map<size_t, pcl::PointCloud<pcl::PointXYZ>::Ptr> clouds;
+    auto it = clouds.find(index);
+    if(it != clouds.end())
+        return it->second;
+
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>());
+    pcl::PLYReader plyReader;
+    if(plyReader.read(getMapPath(benchmarkMaps[index].name), *cloud) < 0)
+        cloud.reset();
+
+    if(cloud)
+    {
+        pcl::PointXYZ mi, ma;
+        pcl::getMinMax3D(*cloud, mi, ma);
+        Eigen::Affine3f pclTf = Eigen::Affine3f::Identity();
+        pclTf.translation() << -mi.x, -mi.y, -mi.z;
+        pcl::transformPointCloud(*cloud, *cloud, pclTf);
+    }
+    clouds[index] = cloud;
+    return cloud;
+}
+
+/** Same conversion as test_ugv_nav4d */
+maps::grid::MLSMapSloped convertToMls(const pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+    pcl::PointXYZ mi, ma;
+    pcl::getMinMax3D(cloud, mi, ma);
+
+    const double mls_res = 0.3;
+    const maps::grid::Vector2ui numCells(ma.x / mls_res + 1, ma.y / mls_res + 1);
+    maps::grid::MLSConfig cfg;
+    cfg.gapSize = 0.1;
+    cfg.thickness = 0.1;
+    cfg.useColor = false;
+    maps::grid::MLSMapSloped mlsMap(numCells, maps::grid::Vector2d(mls_res, mls_res), cfg);
+    mlsMap.mergePointCloud(cloud, base::Transform3d::Identity());
+    return mlsMap;
+}
+
+/** @return the mls map of map @p index, nullptr if it cannot be loaded */
+std::shared_ptr<EnvironmentXYZTheta::MLGrid> getMlsGrid(size_t index)
+{
+    static std::map<size_t, std::shared_ptr<EnvironmentXYZTheta::MLGrid>> grids;
+    auto it = grids.find(index);
+    if(it != grids.end())
+        return it->second;
+
+    std::shared_ptr<EnvironmentXYZTheta::MLGrid> grid;
+    pcl::PointCloud<pcl::PointXYZ>::ConstPtr cloud = getPointCloud(index);
+    if(cloud)
+        grid = std::make_shared<EnvironmentXYZTheta::MLGrid>(convertToMls(*cloud));
+    grids[index] = grid;
+    return grid;
+}
+
+base::samples::RigidBodyState toRigidBodyState(const Eigen::Vector3d& position)
+{
+    base::samples::RigidBodyState rbs;
+    rbs.position = position;
+    rbs.orientation = Eigen::Quaterniond::Identity();
+    return rbs;
+}
+
+/** Plans once from the start to the goal of map @p index, the result is kept for the following benchmarks.
+ *  Skips the benchmark and prints an error if the map cannot be loaded or there is no solution,
+ *  timing failed searches is pointless */
+bool checkMap(benchmark::State& state, size_t index)
+{
+    static std::map<size_t, std::string> errors;
+    auto it = errors.find(index);
+    if(it == errors.end())
+    {
+        const BenchmarkMap& map(benchmarkMaps[index]);
+        std::string error;
+        std::shared_ptr<EnvironmentXYZTheta::MLGrid> grid = getMlsGrid(index);
+        if(!grid)
+        {
+            error = "Cannot load " + getMapPath(map.name);
+        }
+        else
+        {
+            const Configs configs;
+            Planner planner(configs.splinePrimitiveConfig, configs.traversabilityConfig, configs.mobility, configs.plannerConfig);
+            planner.updateMap(*grid);
+            std::vector<trajectory_follower::SubTrajectory> trajectory2D;
+            std::vector<trajectory_follower::SubTrajectory> trajectory3D;
+            const Planner::PLANNING_RESULT result = planner.plan(base::Time::fromSeconds(maxPlanningTime), toRigidBodyState(map.start),
+                                                                 toRigidBodyState(map.goal), trajectory2D, trajectory3D);
+            if(result != Planner::FOUND_SOLUTION)
+            {
+                std::ostringstream stream;
+                stream << "No solution from " << map.start.transpose() << " to " << map.goal.transpose() << " on " << map.name
+                       << " (result " << result << "), fix the start and goal in benchmarkMaps";
+                error = stream.str();
+            }
+        }
+        if(!error.empty())
+            std::cerr << "ERROR: " << error << std::endl;
+        it = errors.emplace(index, error).first;
+    }
+
+    if(!it->second.empty())
+    {
+        state.SkipWithError(it->second.c_str());
+        return false;
+    }
+    return true;
+}
+
+/** Creates an environment on map @p index. Skips the benchmark if checkMap() fails */
+std::unique_ptr<EnvironmentXYZTheta> createEnvironment(benchmark::State& state, const Configs& configs)
+{
+    const size_t index = state.range(0);
+    state.SetLabel(benchmarkMaps[index].name);
+    if(!checkMap(state, index))
+        return nullptr;
+    return std::unique_ptr<EnvironmentXYZTheta>(new EnvironmentXYZTheta(getMlsGrid(index), configs.traversabilityConfig,
+                                                                        configs.splinePrimitiveConfig, configs.mobility));
+}
+
+/** Sets start and goal on an expanded environment. Skips the benchmark on failure */
+bool setStartAndGoal(benchmark::State& state, EnvironmentXYZTheta& env)
+{
+    const BenchmarkMap& map(benchmarkMaps[state.range(0)]);
+    try
+    {
+        env.setStart(map.start, 0);
+        env.setGoal(map.goal, 0);
+    }
+    catch(const std::exception& ex)
+    {
+        state.SkipWithError((std::string("Invalid start or goal: ") + ex.what()).c_str());
+        return false;
+    }
+    return true;
+}
+
+void BM_MapConversion(benchmark::State& state)
+{
+    const size_t index = state.range(0);
+    state.SetLabel(benchmarkMaps[index].name);
+    pcl::PointCloud<pcl::PointXYZ>::ConstPtr cloud = getPointCloud(index);
+    if(!cloud)
+    {
+        state.SkipWithError(("Cannot load " + getMapPath(benchmarkMaps[index].name)).c_str());
+        return;
+    }
+
+    for(auto _ : state)
+    {
+        EnvironmentXYZTheta::MLGrid grid(convertToMls(*cloud));
+        benchmark::DoNotOptimize(grid);
+    }
+    state.SetItemsProcessed(state.iterations() * cloud->size());
+    state.counters["points"] = cloud->size();
+}
+
+void BM_MapExpansion(benchmark::State& state)
+{
+    const Configs configs;
+    std::unique_ptr<EnvironmentXYZTheta> env = createEnvironment(state, configs);
+    if(!env)
+        return;
+    std::shared_ptr<EnvironmentXYZTheta::MLGrid> grid = getMlsGrid(state.range(0));
+    const BenchmarkMap& map(benchmarkMaps[state.range(0)]);
+
+    omp_set_num_threads(configs.plannerConfig.numThreads);
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        //resets the traversability and obstacle map
+        env->updateMap(grid);
+        state.ResumeTiming();
+
+        env->expandMap({map.start});
+    }
+    state.counters["travNodes"] = env->getTravGen().getNumNodes();
+    state.counters["obstacleNodes"] = env->getObstacleGen().getNumNodes();
+}
+
+/** Expansion of the traversability map alone. Arguments: map index, number of threads */
+void BM_TravMapExpansion(benchmark::State& state)
+{
+    const Configs configs;
+    const size_t index = state.range(0);
+    state.SetLabel(benchmarkMaps[index].name);
+    if(!checkMap(state, index))
+        return;
+    std::shared_ptr<EnvironmentXYZTheta::MLGrid> grid = getMlsGrid(index);
+
+    omp_set_num_threads(state.range(1));
+    size_t numNodes = 0;
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        std::unique_ptr<TravMapGenerator3D> travGen(new TravMapGenerator3D(configs.traversabilityConfig));
+        travGen->setMLSGrid(grid);
+        state.ResumeTiming();
+
+        travGen->expandAllParallel({benchmarkMaps[index].start});
+        numNodes = travGen->getNumNodes();
+
+        state.PauseTiming();
+        travGen.reset();
+        state.ResumeTiming();
+    }
+    state.counters["travNodes"] = numNodes;
+    state.counters["threads"] = state.range(1);
+}
+
+/** All maps with 1, 2, 4 and 8 threads */
+void mapsAndThreads(benchmark::internal::Benchmark* benchmark)
+{
+    for(size_t i = 0; i < benchmarkMaps.size(); ++i)
+    {
+        for(int threads : {1, 2, 4, 8})
+            benchmark->Args({static_cast<int>(i), threads});
+    }
+}
+
+void BM_Heuristic(benchmark::State& state)
+{
+    const Configs configs;
+    std::unique_ptr<EnvironmentXYZTheta> env = createEnvironment(state, configs);
+    if(!env)
+        return;
+
+    const BenchmarkMap& map(benchmarkMaps[state.range(0)]);
+    omp_set_num_threads(configs.plannerConfig.numThreads);
+    env->expandMap({map.start});
+
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        env->clear();
+        try
+        {
+            env->setStart(map.start, 0);
+        }
+        catch(const std::exception& ex)
+        {
+            state.SkipWithError((std::string("Invalid start: ") + ex.what()).c_str());
+            break;
+        }
+        state.ResumeTiming();
+
+        //computes the dijkstra heuristic from the goal
+        try
+        {
+            env->setGoal(map.goal, 0);
+        }
+        catch(const std::exception& ex)
+        {
+            state.SkipWithError((std::string("Invalid goal: ") + ex.what()).c_str());
+            break;
+        }
+    }
+}
+
+void BM_GetSuccs(benchmark::State& state)
+{
+    const Configs configs;
+    std::unique_ptr<EnvironmentXYZTheta> env = createEnvironment(state, configs);
+    if(!env)
+        return;
+
+    omp_set_num_threads(configs.plannerConfig.numThreads);
+    env->expandMap({benchmarkMaps[state.range(0)].start});
+
+    size_t expansions = 0;
+    size_t successors = 0;
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        //drops the edge cache, every iteration evaluates the same motions again
+        env->clear();
+        if(!setStartAndGoal(state, *env))
+            break;
+        MDPConfig mdpConfig;
+        env->InitializeMDPCfg(&mdpConfig);
+        state.ResumeTiming();
+
+        //breadth first expansion of the state space
+        std::deque<int> open = {mdpConfig.startstateid};
+        std::unordered_set<int> visited = {mdpConfig.startstateid};
+        std::vector<int> succs;
+        std::vector<int> costs;
+        size_t expanded = 0;
+        while(!open.empty() && expanded < numSuccessorExpansions)
+        {
+            const int stateID = open.front();
+            open.pop_front();
+            env->GetSuccs(stateID, &succs, &costs);
+            ++expanded;
+            successors += succs.size();
+            for(int succ : succs)
+            {
+                if(visited.insert(succ).second)
+                    open.push_back(succ);
+            }
+        }
+        expansions += expanded;
+    }
+    state.SetItemsProcessed(expansions);
+    state.counters["successors"] = benchmark::Counter(successors, benchmark::Counter::kAvgIterations);
+}
+
+void BM_Plan(benchmark::State& state)
+{
+    const Configs configs;
+    const size_t index = state.range(0);
+    state.SetLabel(benchmarkMaps[index].name);
+    if(!checkMap(state, index))
+        return;
+
+    Planner planner(configs.splinePrimitiveConfig, configs.traversabilityConfig, configs.mobility, configs.plannerConfig);
+    planner.updateMap(*getMlsGrid(index));
+
+    const base::samples::RigidBodyState startState(toRigidBodyState(benchmarkMaps[index].start));
+    const base::samples::RigidBodyState endState(toRigidBodyState(benchmarkMaps[index].goal));
+    std::vector<trajectory_follower::SubTrajectory> trajectory2D;
+    std::vector<trajectory_follower::SubTrajectory> trajectory3D;
+    size_t expands = 0;
+    for(auto _ : state)
+    {
+        const Planner::PLANNING_RESULT result = planner.plan(base::Time::fromSeconds(maxPlanningTime), startState, endState,
+                                                             trajectory2D, trajectory3D);
+        if(result != Planner::FOUND_SOLUTION)
+        {
+            state.SkipWithError(("Planning failed on " + benchmarkMaps[index].name + " (result " + std::to_string(result) + ")").c_str());
+            break;
+        }
+        expands += planner.getStatistics().expands;
+    }
+    state.counters["expands"] = benchmark::Counter(expands, benchmark::Counter::kAvgIterations);
+}
+
+/** Startup cost of the motion primitives. Arguments: number of angles, number of threads */
+void BM_ComputeMotions(benchmark::State& state)
+{
+    Configs configs;
+    configs.splinePrimitiveConfig.numAngles = state.range(0);
+    configs.splinePrimitiveConfig.numEndAngles = state.range(0) / 2;
+    const double res = configs.traversabilityConfig.gridResolution;
+
+    //the thread timings can only be compared if every thread has its own core
+    const int threads = state.range(1);
+    const int cores = omp_get_num_procs();
+    if(threads > cores)
+        state.SetLabel("only " + std::to_string(cores) + " cores");
+
+    //measure the computation, not the cache
+    PreComputedMotions::setCacheDirectory("");
+    omp_set_num_threads(threads);
+    size_t numMotions = 0;
+    bool symmetric = false;
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        PreComputedMotions motions(configs.splinePrimitiveConfig, configs.mobility);
+        state.ResumeTiming();
+
+        motions.computeMotions(res, res);
+        numMotions = motions.getNumMotions();
+        symmetric = motions.getUseSymmetry() && PreComputedMotions::isQuarterSymmetric(motions.getPrimitives());
+    }
+    state.counters["motions"] = numMotions;
+    state.counters["threads"] = threads;
+    state.counters["cores"] = cores;
+    //only a quarter of the angles has been sampled
+    state.counters["symmetric"] = symmetric;
+}
+
+/** Incline limited heading check on ramp, the map with the most restricted headings.
+ *  Argument: 0 checks the allowed angle segments of the nodes, 1 the heading masks */
+void BM_HeadingMask(benchmark::State& state)
+{
+    Configs configs;
+    configs.traversabilityConfig.enableInclineLimitting = true;
+    const size_t index = 1;
+    const bool useMask = state.range(0);
+    state.SetLabel(benchmarkMaps[index].name + (useMask ? " HeadingMask" : " AngleSegments"));
+    if(!checkMap(state, index))
+        return;
+    std::shared_ptr<EnvironmentXYZTheta::MLGrid> grid = getMlsGrid(index);
+
+    ObstacleMapGenerator3D obsGen(configs.traversabilityConfig);
+    obsGen.setMLSGrid(grid);
+    omp_set_num_threads(configs.plannerConfig.numThreads);
+    obsGen.expandAllParallel({benchmarkMaps[index].start});
+    obsGen.rebuildHeadingMasks();
+
+    std::vector<const traversability_generator3d::TravGenNode*> nodes;
+    for(const auto& l : obsGen.getTraversabilityMap())
+    {
+        for(const traversability_generator3d::TravGenNode* n : l)
+        {
+            if(n->getType() == maps::grid::TraversabilityNodeBase::TRAVERSABLE)
+                nodes.push_back(n);
+        }
+    }
+    std::vector<double> headings;
+    for(int i = 0; i < configs.splinePrimitiveConfig.numAngles; ++i)
+        headings.push_back(DiscreteTheta(i, configs.splinePrimitiveConfig.numAngles).getRadian());
+
+    for(auto _ : state)
+    {
+        size_t allowed = 0;
+        for(const traversability_generator3d::TravGenNode* n : nodes)
+        {
+            for(double heading : headings)
+            {
+                if(useMask)
+                {
+                    allowed += obsGen.isHeadingAllowed(n, heading);
+                    continue;
+                }
+                for(const base::AngleSegment& segment : n->getUserData().allowedOrientations)
+                {
+                    if(segment.isInside(base::Angle::fromRad(heading)))
+                    {
+                        ++allowed;
+                        break;
+                    }
+                }
+            }
+        }
+        benchmark::DoNotOptimize(allowed);
+    }
+    state.SetItemsProcessed(state.iterations() * nodes.size() * headings.size());
+    state.counters["nodes"] = nodes.size();
+}
+
+/** Heading arithmetic of the heuristic and the successor generation. Argument: number of angles */
+void BM_DiscreteTheta(benchmark::State& state)
+{
+    const int numAngles = state.range(0);
+    std::vector<DiscreteTheta> thetas;
+    for(int i = 0; i < numAngles; ++i)
+        thetas.emplace_back(i, numAngles);
+
+    for(auto _ : state)
+    {
+        int sum = 0;
+        for(const DiscreteTheta& a : thetas)
+        {
+            for(const DiscreteTheta& b : thetas)
+            {
+                sum += a.shortestDist(b).getTheta() + (a + b).getTheta();
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * numAngles * numAngles);
+}
+
+}
+
+BENCHMARK(BM_DiscreteTheta)->Arg(16)->Arg(42)->Arg(64);
+BENCHMARK(BM_ComputeMotions)->Args({16, 1})->Args({16, 8})->Args({32, 1})->Args({32, 8})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_MapConversion)->DenseRange(0, benchmarkMaps.size() - 1)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_MapExpansion)->DenseRange(0, benchmarkMaps.size() - 1)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_TravMapExpansion)->Apply(mapsAndThreads)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_Heuristic)->DenseRange(0, benchmarkMaps.size() - 1)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_GetSuccs)->DenseRange(0, benchmarkMaps.size() - 1)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_Plan)->DenseRange(0, benchmarkMaps.size() - 1)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_HeadingMask)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char** argv)
+{
+    //write json results unless the output is configured on the command line
+    std::vector<char*> args(argv, argv + argc);
+    std::string out = "--benchmark_out=ugv_nav4d_benchmark.json";
+    std::string format = "--benchmark_out_format=json";
+    bool hasOut = false;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strncmp(argv[i], "--benchmark_out=", 16) == 0)
+            hasOut = true;
+    }
+    if(!hasOut)
+    {
+        args.push_back(&out[0]);
+        args.push_back(&format[0]);
+    }
+    int numArgs = static_cast<int>(args.size());
+
+    benchmark::Initialize(&numArgs, args.data());
+    if(benchmark::ReportUnrecognizedArguments(numArgs, args.data()))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
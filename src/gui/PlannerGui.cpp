@@ -7,6 +7,7 @@
 #include <QSlider>
 #include <QComboBox>
 #include <QHBoxLayout>
+#include <sstream>
 #include <thread>
 #include <vizkit3d/Vizkit3DWidget.hpp>
 #include <ugv_nav4d/PreComputedMotions.hpp>
@@ -46,6 +47,11 @@ PlannerGui::PlannerGui(const std::string& dumpName): QObject()
     goalViz.updateData(dump.getGoal());
 
     planner->updateMap(dump.getMlsMap());
+    if(dump.hasExpandedMaps())
+    {
+        std::istringstream maps(dump.getExpandedMaps());
+        planner->loadExpandedMaps(maps);
+    }
     
     startPlanThread();
 }
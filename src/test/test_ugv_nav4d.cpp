@@ -1,12 +1,32 @@
+#include <algorithm>
 #include <fstream>
+#include <functional>
 #include <cstdlib>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
 
 #include "gtest/gtest.h"
 
 #include "ugv_nav4d/DiscreteTheta.hpp"
 #include "ugv_nav4d/Planner.hpp"
+#include "ugv_nav4d/PlannerDump.hpp"
+#include "ugv_nav4d/DumpWriter.hpp"
+#include "ugv_nav4d/TravMapGenerator3D.hpp"
+#include "ugv_nav4d/RobotFootprint.hpp"
+#include "ugv_nav4d/PreComputedMotions.hpp"
+#include "ugv_nav4d/ObstacleDistanceField.hpp"
+#include "ugv_nav4d/ObstacleMapGenerator3D.hpp"
+#include "ugv_nav4d/Trace.hpp"
+#include "ugv_nav4d/ChromeTrace.hpp"
 #include <traversability_generator3d/TraversabilityConfig.hpp>
+#include <sbpl/utils/mdpconfig.h>
 #include <maps/grid/MLSMap.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <base/Angle.hpp>
+#include <omp.h>
 
 #include <pcl/io/ply_io.h>
 #include <pcl/common/common.h>
@@ -16,6 +36,41 @@ using namespace ugv_nav4d;
 
 std::string filePath;
 
+/** Directory in the temp path that is removed with its content at the end of the test.
+ *  Tests of code that writes to the current directory can change into it. */
+class TempDirectory {
+public:
+  explicit TempDirectory(bool changeInto = false)
+    : path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ugv_nav4d_test_%%%%%%%%"))
+  {
+    boost::filesystem::create_directories(path);
+    if(changeInto)
+    {
+      previousPath = boost::filesystem::current_path();
+      boost::filesystem::current_path(path);
+    }
+  }
+
+  ~TempDirectory()
+  {
+    if(!previousPath.empty())
+      boost::filesystem::current_path(previousPath);
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(path, ec);
+  }
+
+  /** @return @p name inside of the directory */
+  std::string file(const std::string& name) const
+  {
+    return (path / name).string();
+  }
+
+  const boost::filesystem::path path;
+
+private:
+  boost::filesystem::path previousPath;
+};
+
 class PlannerTest : public testing::Test {
 protected:
 
@@ -24,7 +79,18 @@ protected:
   void loadMlsMap(const std::string& path);
   std::string getResult(const Planner::PLANNING_RESULT& result);
 
-  Planner* planner;
+  /** Creates #planner with the current configuration and the loaded map */
+  void createPlanner();
+  /** Plans with @p p from #startPosition to #goalPosition within 5 seconds */
+  Planner::PLANNING_RESULT planToGoal(Planner& p, std::vector<trajectory_follower::SubTrajectory>& trajectory2D);
+  std::shared_ptr<EnvironmentXYZTheta::MLGrid> getMlsGrid() const;
+  static base::samples::RigidBodyState getPose(const Eigen::Vector3d& position, double yaw = 0.0);
+
+  /** Start and goal that are reachable on the test map */
+  const Eigen::Vector3d startPosition = Eigen::Vector3d(2.3, 4.1, 0.0);
+  const Eigen::Vector3d goalPosition = Eigen::Vector3d(6.1, 4.2, 0.0);
+
+  Planner* planner = nullptr;
   maps::grid::MLSMapSloped mlsMap;
   PlannerConfig plannerConfig;
   Mobility mobility;
@@ -129,6 +195,30 @@ void PlannerTest::loadMlsMap(const std::string& path){
   map_loaded = false;
 }
 
+void PlannerTest::createPlanner(){
+  planner = new Planner(splinePrimitiveConfig,
+                        traversabilityConfig,
+                        mobility,
+                        plannerConfig);
+  planner->updateMap(mlsMap);
+}
+
+Planner::PLANNING_RESULT PlannerTest::planToGoal(Planner& p, std::vector<trajectory_follower::SubTrajectory>& trajectory2D){
+  std::vector<trajectory_follower::SubTrajectory> trajectory3D;
+  return p.plan(base::Time::fromSeconds(5), getPose(startPosition), getPose(goalPosition), trajectory2D, trajectory3D);
+}
+
+std::shared_ptr<EnvironmentXYZTheta::MLGrid> PlannerTest::getMlsGrid() const{
+  return std::make_shared<EnvironmentXYZTheta::MLGrid>(mlsMap);
+}
+
+base::samples::RigidBodyState PlannerTest::getPose(const Eigen::Vector3d& position, double yaw){
+  base::samples::RigidBodyState pose;
+  pose.position = position;
+  pose.orientation = Eigen::Quaterniond(Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()));
+  return pose;
+}
+
 std::string PlannerTest::getResult(const Planner::PLANNING_RESULT& result){
 
   std::string result_str;
@@ -317,7 +407,1193 @@ TEST_F(PlannerTest, check_planner_success) {
   EXPECT_EQ(result, Planner::FOUND_SOLUTION);
 }
 
+TEST_F(PlannerTest, check_planner_success_slope_metrics) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  //every metric uses a different motion evaluation kernel
+  const std::vector<traversability_generator3d::SlopeMetric> metrics = {traversability_generator3d::NONE, traversability_generator3d::AVG_SLOPE,
+                                                                        traversability_generator3d::MAX_SLOPE, traversability_generator3d::TRIANGLE_SLOPE};
+  for(traversability_generator3d::SlopeMetric metric : metrics)
+  {
+    for(bool inclineLimitting : {false, true})
+    {
+      traversabilityConfig.slopeMetric = metric;
+      traversabilityConfig.enableInclineLimitting = inclineLimitting;
+
+      Planner metricPlanner(splinePrimitiveConfig, traversabilityConfig, mobility, plannerConfig);
+      metricPlanner.updateMap(mlsMap);
+      metricPlanner.enablePathStatistics(true);
+
+      std::vector<trajectory_follower::SubTrajectory> trajectory2D;
+      EXPECT_EQ(planToGoal(metricPlanner, trajectory2D), Planner::FOUND_SOLUTION)
+        << "slope metric " << metric << ", incline limitting " << inclineLimitting;
+    }
+  }
+}
+
+TEST_F(PlannerTest, check_planner_success_lazy_evaluation) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  plannerConfig.useLazyEvaluation = true;
+  createPlanner();
+  planner->enablePathStatistics(true);
+
+  std::vector<trajectory_follower::SubTrajectory> trajectory2D;
+  EXPECT_EQ(planToGoal(*planner, trajectory2D), Planner::FOUND_SOLUTION);
+  EXPECT_FALSE(trajectory2D.empty());
+}
+
+TEST_F(PlannerTest, check_planner_statistics) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  plannerConfig.collectStatistics = true;
+  createPlanner();
+  planner->enablePathStatistics(true);
+
+  std::vector<trajectory_follower::SubTrajectory> trajectory2D;
+  EXPECT_EQ(planToGoal(*planner, trajectory2D), Planner::FOUND_SOLUTION);
+
+  const PlannerStatistics& stats = planner->getStatistics();
+  EXPECT_GT(stats.getSuccsCalls, 0u);
+  EXPECT_GT(stats.heuristicCalls, 0u);
+  EXPECT_GT(stats.statesCreated, 0u);
+  EXPECT_GT(stats.successorsGenerated, 0u);
+  EXPECT_GT(stats.searchTime, 0.0);
+  EXPECT_GE(stats.totalTime, stats.searchTime);
+  EXPECT_GT(stats.peakMemory, 0u);
+  //the start and goal poses are checked with the precomputed footprint masks
+  EXPECT_GT(stats.footprintMaskLookups, 0u);
+  EXPECT_EQ(stats.footprintGeometricChecks, 0u);
+}
+
+TEST_F(PlannerTest, check_chrome_trace) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  const TempDirectory tempDir;
+  const std::string traceFile = tempDir.file("trace.json");
+  setenv(ChromeTrace::environmentVariable, traceFile.c_str(), 1);
+
+  plannerConfig.numThreads = 4;
+  plannerConfig.chromeTraceSampleInterval = 1;
+  createPlanner();
+
+  std::vector<trajectory_follower::SubTrajectory> trajectory2D;
+  const Planner::PLANNING_RESULT result = planToGoal(*planner, trajectory2D);
+  unsetenv(ChromeTrace::environmentVariable);
+  EXPECT_EQ(result, Planner::FOUND_SOLUTION);
+  EXPECT_FALSE(ChromeTrace::instance().isRecording());
+
+  std::map<std::string, size_t> spans;
+  for(const ChromeTraceEvent& event : ChromeTrace::instance().getEvents())
+  {
+    EXPECT_LE(event.begin, event.end);
+    ++spans[event.name];
+  }
+  EXPECT_EQ(spans["plan"], 1u);
+  EXPECT_EQ(spans["expandMap"], 1u);
+  EXPECT_EQ(spans["search"], 1u);
+  EXPECT_GT(spans["ARA* iteration"], 0u);
+  EXPECT_GT(spans["GetSuccs"], 0u);
+  EXPECT_GT(spans["evaluateEdge"], 0u);
+
+  std::ifstream input(traceFile);
+  ASSERT_TRUE(input.good());
+  const std::string json((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+  EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0u);
+  EXPECT_NE(json.find("\"name\":\"GetSuccs\""), std::string::npos);
+}
+
+TEST_F(PlannerTest, check_planner_dump) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  plannerConfig.useLazyEvaluation = true;
+  traversabilityConfig.slopeMetric = traversability_generator3d::AVG_SLOPE;
+  createPlanner();
+
+  //the dumps are written to the current directory
+  const TempDirectory tempDir(true);
+  const base::samples::RigidBodyState startState = getPose(startPosition + Eigen::Vector3d(0.0, 0.0, 0.2), 0.5);
+  const base::samples::RigidBodyState endState = getPose(goalPosition);
+
+  for(PlannerDump::Compression compression : {PlannerDump::Compression::NONE, PlannerDump::getDefaultCompression()})
+  {
+    const std::string fileName = PlannerDump(*planner, "test", base::Time::fromSeconds(3), startState, endState, compression).getFileName();
+
+    const PlannerDump dump(fileName);
+    EXPECT_EQ(dump.getPlannerConfig().useLazyEvaluation, true);
+    EXPECT_EQ(dump.getPlannerConfig().numThreads, plannerConfig.numThreads);
+    EXPECT_EQ(dump.getTravConfig().slopeMetric, traversability_generator3d::AVG_SLOPE);
+    EXPECT_EQ(dump.getTravConfig().robotSizeX, traversabilityConfig.robotSizeX);
+    EXPECT_EQ(dump.getSplineConfig().numAngles, splinePrimitiveConfig.numAngles);
+    EXPECT_EQ(dump.getMobilityConf().multiplierLateral, mobility.multiplierLateral);
+    EXPECT_EQ(dump.getMaxTime().toSeconds(), 3.0);
+    EXPECT_TRUE(dump.getStart().position.isApprox(startState.position));
+    EXPECT_TRUE(dump.getStart().orientation.isApprox(startState.orientation));
+    EXPECT_TRUE(dump.getGoal().position.isApprox(endState.position));
+
+    const auto& map = dump.getMlsMap();
+    EXPECT_EQ(map.getNumCells(), mlsMap.getNumCells());
+    EXPECT_EQ(map.getResolution(), mlsMap.getResolution());
+
+    //a damaged map is detected when it is decoded
+    {
+      std::fstream file(fileName, std::ios::in | std::ios::out | std::ios::binary);
+      file.seekg(-10, std::ios::end);
+      const char byte = file.get();
+      file.seekp(-10, std::ios::end);
+      file.put(~byte);
+    }
+    const PlannerDump damaged(fileName);
+    EXPECT_EQ(damaged.getPlannerConfig().useLazyEvaluation, true);
+    EXPECT_THROW(damaged.getMlsMap(), std::runtime_error);
+  }
+}
+
+TEST_F(PlannerTest, check_async_dump_writer) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  createPlanner();
+
+  //the dumps are written to the current directory
+  const TempDirectory tempDir(true);
+  const base::samples::RigidBodyState startState = getPose(startPosition + Eigen::Vector3d(0.0, 0.0, 0.2));
+  const base::samples::RigidBodyState endState = startState;
+
+  const int numDumps = 3;
+  {
+    DumpWriter writer(1, DumpWriter::DROP_NEWEST);
+    for(int i = 0; i < numDumps; ++i)
+      writer.push(PlannerDump::capture(*planner, "async_test", base::Time::fromSeconds(i), startState, endState));
+
+    //the map of the snapshot is shared, updating the planner does not change the queued dumps
+    planner->updateMap(mlsMap);
+    writer.flush();
+    EXPECT_EQ(writer.getNumWritten() + writer.getNumDropped(), static_cast<uint64_t>(numDumps));
+    EXPECT_GE(writer.getNumWritten(), 1u);
+    EXPECT_EQ(writer.getNumFailed(), 0u);
+
+    const PlannerDump dump(writer.getLastFileName());
+    EXPECT_EQ(dump.getMlsMap().getNumCells(), mlsMap.getNumCells());
+    EXPECT_TRUE(dump.getStart().position.isApprox(startState.position));
+  }
+
+  //dumps captured within the same second must not overwrite each other
+  int numFiles = 0;
+  for(boost::filesystem::directory_iterator it("."), end; it != end; ++it)
+  {
+    const std::string name = it->path().filename().string();
+    if(name.find("ugv4d_dump_") == 0 && name.find("_async_test") != std::string::npos)
+      ++numFiles;
+  }
+  EXPECT_GE(numFiles, 1);
+  EXPECT_LE(numFiles, numDumps);
+}
+
+TEST_F(PlannerTest, check_expanded_map_serialization) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  std::shared_ptr<EnvironmentXYZTheta::MLGrid> mlsPtr = getMlsGrid();
+  EnvironmentXYZTheta env(mlsPtr, traversabilityConfig, splinePrimitiveConfig, mobility);
+  env.expandMap({startPosition});
+  ASSERT_GT(env.getTravGen().getNumNodes(), 0);
+
+  std::stringstream saved(std::ios::in | std::ios::out | std::ios::binary);
+  env.saveExpandedMaps(saved);
+
+  EnvironmentXYZTheta loadedEnv(mlsPtr, traversabilityConfig, splinePrimitiveConfig, mobility);
+  loadedEnv.loadExpandedMaps(saved);
+  EXPECT_EQ(loadedEnv.getTravGen().getNumNodes(), env.getTravGen().getNumNodes());
+  EXPECT_EQ(loadedEnv.getObstacleGen().getNumNodes(), env.getObstacleGen().getNumNodes());
+
+  //types, heights, expansion states and connections survive the round trip
+  auto expectSameNodes = [] (traversability_generator3d::TraversabilityGenerator3d& original,
+                             traversability_generator3d::TraversabilityGenerator3d& loaded)
+  {
+    const auto& originalMap = original.getTraversabilityMap();
+    const auto& loadedMap = loaded.getTraversabilityMap();
+    ASSERT_EQ(originalMap.getNumCells(), loadedMap.getNumCells());
+    for(int y = 0; y < originalMap.getNumCells().y(); ++y)
+    {
+      for(int x = 0; x < originalMap.getNumCells().x(); ++x)
+      {
+        const auto& originalList = originalMap.at(x, y);
+        const auto& loadedList = loadedMap.at(x, y);
+        ASSERT_EQ(originalList.size(), loadedList.size());
+        auto loadedIt = loadedList.begin();
+        for(const traversability_generator3d::TravGenNode* n : originalList)
+        {
+          const traversability_generator3d::TravGenNode* l = *loadedIt++;
+          EXPECT_EQ(n->getHeight(), l->getHeight());
+          EXPECT_EQ(n->getType(), l->getType());
+          EXPECT_EQ(n->isExpanded(), l->isExpanded());
+          EXPECT_EQ(n->getUserData().slope, l->getUserData().slope);
+          ASSERT_EQ(n->getConnections().size(), l->getConnections().size());
+          for(size_t c = 0; c < n->getConnections().size(); ++c)
+          {
+            EXPECT_EQ(n->getConnections()[c]->getIndex(), l->getConnections()[c]->getIndex());
+            EXPECT_EQ(n->getConnections()[c]->getHeight(), l->getConnections()[c]->getHeight());
+          }
+        }
+      }
+    }
+  };
+  expectSameNodes(env.getTravGen(), loadedEnv.getTravGen());
+  expectSameNodes(env.getObstacleGen(), loadedEnv.getObstacleGen());
+
+  //invalid node types are rejected. The type of the first node follows the header and the
+  //cell indices and heights of all nodes
+  const size_t numTravNodes = env.getTravGen().getNumNodes();
+  const size_t headerSize = 8 + 2 * 4 + 2 * 4 + 2 * 8 + 3 * 4;
+  std::string invalidTypeData = saved.str();
+  invalidTypeData[headerSize + numTravNodes * (2 * 4 + 8)] = 100;
+  std::istringstream invalidType(invalidTypeData);
+  TravMapGenerator3D invalidGen(traversabilityConfig);
+  invalidGen.setMLSGrid(mlsPtr);
+  EXPECT_THROW(invalidGen.loadNodes(invalidType), std::runtime_error);
+
+  //the loaded map is already expanded, the planner can search on it right away
+  loadedEnv.setStart(startPosition, 0.0);
+  loadedEnv.setGoal(goalPosition, 0.0);
+  MDPConfig mdpCfg;
+  ASSERT_TRUE(loadedEnv.InitializeMDPCfg(&mdpCfg));
+  std::vector<int> succs, costs;
+  loadedEnv.GetSuccs(mdpCfg.startstateid, &succs, &costs);
+  EXPECT_FALSE(succs.empty());
+
+  //truncated data is rejected and does not change the map
+  const std::string truncatedData = saved.str().substr(0, 32);
+  std::istringstream truncated(truncatedData);
+  EXPECT_THROW(env.loadExpandedMaps(truncated), std::runtime_error);
+  EXPECT_EQ(env.getTravGen().getNumNodes(), loadedEnv.getTravGen().getNumNodes());
+}
+
+TEST_F(PlannerTest, check_edge_cache) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  EnvironmentXYZTheta env(getMlsGrid(), traversabilityConfig, splinePrimitiveConfig, mobility);
+  env.enablePathStatistics(true);
+
+  env.expandMap({startPosition, goalPosition});
+  env.setStart(startPosition, 0.0);
+  env.setGoal(goalPosition, 0.0);
+
+  MDPConfig mdpCfg;
+  ASSERT_TRUE(env.InitializeMDPCfg(&mdpCfg));
+
+  std::vector<int> succs, costs, cachedSuccs, cachedCosts;
+  std::vector<size_t> motionIds, cachedMotionIds;
+  env.GetSuccs(mdpCfg.startstateid, &succs, &costs, motionIds);
+  const size_t misses = env.getEdgeCacheMisses();
+  EXPECT_GT(misses, 0u);
+  EXPECT_EQ(env.getEdgeCacheHits(), 0u);
+
+  //the second expansion of the same state has to be answered from the cache with the same result
+  env.GetSuccs(mdpCfg.startstateid, &cachedSuccs, &cachedCosts, cachedMotionIds);
+  EXPECT_EQ(env.getEdgeCacheMisses(), misses);
+  EXPECT_EQ(env.getEdgeCacheHits(), misses);
+
+  std::map<size_t, std::pair<int, int>> expected, cached;
+  for(size_t i = 0; i < motionIds.size(); ++i)
+    expected[motionIds[i]] = std::make_pair(succs[i], costs[i]);
+  for(size_t i = 0; i < cachedMotionIds.size(); ++i)
+    cached[cachedMotionIds[i]] = std::make_pair(cachedSuccs[i], cachedCosts[i]);
+  EXPECT_EQ(expected, cached);
+
+  //changing the collision check has to invalidate the cache
+  env.enablePathStatistics(false);
+  EXPECT_EQ(env.getEdgeCacheHits(), 0u);
+  EXPECT_EQ(env.getEdgeCacheMisses(), 0u);
+}
+
+TEST_F(PlannerTest, check_parallel_map_expansion) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  std::shared_ptr<TravMapGenerator3D::MLGrid> mlsPtr = getMlsGrid();
+  const std::vector<Eigen::Vector3d> positions = {startPosition};
+
+  //the expansion of the base class
+  traversability_generator3d::TraversabilityGenerator3d reference(traversabilityConfig);
+  reference.setMLSGrid(mlsPtr);
+  reference.expandAll(positions);
+
+  const int maxThreads = omp_get_max_threads();
+  TravMapGenerator3D sequential(traversabilityConfig);
+  sequential.setMLSGrid(mlsPtr);
+  omp_set_num_threads(1);
+  EXPECT_TRUE(sequential.expandAllParallel(positions));
+
+  TravMapGenerator3D parallel(traversabilityConfig);
+  parallel.setMLSGrid(mlsPtr);
+  parallel.setTileSize(4);
+  omp_set_num_threads(4);
+  EXPECT_TRUE(parallel.expandAllParallel(positions));
+  //everything reachable is expanded already
+  EXPECT_FALSE(parallel.expandAllParallel(positions));
+  omp_set_num_threads(maxThreads);
+
+  //ids are only comparable between generators that renumber the nodes
+  auto expectSameNodes = [] (traversability_generator3d::TraversabilityGenerator3d& expected,
+                             traversability_generator3d::TraversabilityGenerator3d& actual, bool compareIds)
+  {
+    EXPECT_EQ(expected.getNumNodes(), actual.getNumNodes());
+    const auto& expMap = expected.getTraversabilityMap();
+    const auto& actMap = actual.getTraversabilityMap();
+    ASSERT_EQ(expMap.getNumCells(), actMap.getNumCells());
+    for(size_t y = 0; y < expMap.getNumCells().y(); ++y)
+    {
+      for(size_t x = 0; x < expMap.getNumCells().x(); ++x)
+      {
+        const auto& expList = expMap.at(x, y);
+        const auto& actList = actMap.at(x, y);
+        ASSERT_EQ(expList.size(), actList.size());
+        auto actIt = actList.begin();
+        for(const traversability_generator3d::TravGenNode* expNode : expList)
+        {
+          const traversability_generator3d::TravGenNode* actNode = *actIt;
+          EXPECT_NEAR(expNode->getHeight(), actNode->getHeight(), 1e-6);
+          EXPECT_EQ(expNode->getType(), actNode->getType());
+          EXPECT_EQ(expNode->isExpanded(), actNode->isExpanded());
+          EXPECT_EQ(expNode->getConnections().size(), actNode->getConnections().size());
+          EXPECT_LT(actNode->getUserData().id, actual.getNumNodes());
+          if(compareIds)
+          {
+            EXPECT_EQ(expNode->getUserData().id, actNode->getUserData().id);
+          }
+          ++actIt;
+        }
+      }
+    }
+  };
+
+  expectSameNodes(reference, sequential, false);
+  expectSameNodes(sequential, parallel, true);
+}
+
+TEST_F(PlannerTest, check_neighbor_tables) {
+
+  EXPECT_EQ(map_loaded, true);
+
+  std::shared_ptr<TravMapGenerator3D::MLGrid> mlsPtr = getMlsGrid();
+  const Eigen::Vector3d position = startPosition;
+
+  auto expectSameConnections = [] (TravMapGenerator3D& generator)
+  {
+    size_t numNodes = 0;
+    for(const auto& l : generator.getTraversabilityMap())
+    {
+      for(traversability_generator3d::TravGenNode* n : l)
+      {
+        for(int y = -2; y <= 2; ++y)
+        {
+          for(int x = -2; x <= 2; ++x)
+          {
+            const maps::grid::Index idx(n->getIndex() + maps::grid::Index(x, y));
+            EXPECT_EQ(n->getConnectedNode(idx), generator.getConnectedNeighbor(n, idx));
+          }
+        }
+        ++numNodes;
+      }
+    }
+    return numNodes;
+  };
+
+  //tables of the whole map
+  TravMapGenerator3D expanded(traversabilityConfig);
+  expanded.setMLSGrid(mlsPtr);
+  expanded.expandAllParallel({position});
+  EXPECT_GT(expectSameConnections(expanded), 0u);
+
+  //tables that are updated during concurrent lazy expansion
+  TravMapGenerator3D lazy(traversabilityConfig);
+  lazy.setMLSGrid(mlsPtr);
+  lazy.rebuildNeighborTables();
+  traversability_generator3d::TravGenNode* startNode = lazy.generateStartNode(position);
+  ASSERT_NE(startNode, nullptr);
+  std::vector<traversability_generator3d::TravGenNode*> candidates = {startNode};
+  for(int round = 0; round < 3; ++round)
+  {
+    std::vector<traversability_generator3d::TravGenNode*> next;
+    lazy.beginConcurrentExpansion();
+    #pragma omp parallel for schedule(dynamic)
+    for(size_t i = 0; i < candidates.size(); ++i)
+    {
+      traversability_generator3d::TravGenNode* n = candidates[i];
+      if(!lazy.expandNodeThreadSafe(n))
+        continue;
+      #pragma omp critical(check_neighbor_tables)
+      {
+        for(maps::grid::TraversabilityNodeBase* connected : n->getConnections())
+          next.push_back(static_cast<traversability_generator3d::TravGenNode*>(connected));
+      }
+    }
+    lazy.endConcurrentExpansion();
+    EXPECT_GT(expectSameConnections(lazy), 0u);
+    candidates.swap(next);
+  }
+}
+
+//the timing is measured by BM_HeadingMask
+TEST_F(PlannerTest, check_heading_masks) {
+
+  EXPECT_EQ(map_loaded, true);
+  traversabilityConfig.enableInclineLimitting = true;
+
+  ObstacleMapGenerator3D obsGen(traversabilityConfig);
+  obsGen.setMLSGrid(getMlsGrid());
+  obsGen.expandAllParallel({startPosition});
+  obsGen.rebuildHeadingMasks();
+
+  //a sample of the traversable nodes
+  const size_t maxNodes = 500;
+  std::vector<const traversability_generator3d::TravGenNode*> traversable;
+  for(const auto& l : obsGen.getTraversabilityMap())
+  {
+    for(const traversability_generator3d::TravGenNode* n : l)
+    {
+      if(n->getType() == maps::grid::TraversabilityNodeBase::TRAVERSABLE)
+        traversable.push_back(n);
+    }
+  }
+  ASSERT_FALSE(traversable.empty());
+  std::vector<const traversability_generator3d::TravGenNode*> nodes;
+  const size_t nodeStep = (traversable.size() + maxNodes - 1) / maxNodes;
+  for(size_t i = 0; i < traversable.size(); i += nodeStep)
+    nodes.push_back(traversable[i]);
+
+  //the headings that are checked during planning
+  PreComputedMotions motions(splinePrimitiveConfig, mobility);
+  motions.computeMotions(traversabilityConfig.gridResolution, traversabilityConfig.gridResolution);
+  std::vector<double> headings;
+  for(int t = 0; t < splinePrimitiveConfig.numAngles; ++t)
+  {
+    for(const Motion& motion : motions.getMotionForStartTheta(DiscreteTheta(t, splinePrimitiveConfig.numAngles)))
+    {
+      for(const PoseWithCell& pwc : motion.intermediateStepsObstMap)
+        headings.push_back(pwc.pose.orientation);
+    }
+  }
+  std::sort(headings.begin(), headings.end());
+  headings.erase(std::unique(headings.begin(), headings.end()), headings.end());
+
+  std::vector<char> expected;
+  expected.reserve(nodes.size() * headings.size());
+  for(const traversability_generator3d::TravGenNode* n : nodes)
+  {
+    for(double heading : headings)
+    {
+      bool inside = false;
+      for(const base::AngleSegment& segment : n->getUserData().allowedOrientations)
+      {
+        if(segment.isInside(base::Angle::fromRad(heading)))
+        {
+          inside = true;
+          break;
+        }
+      }
+      expected.push_back(inside);
+    }
+  }
+  std::vector<char> actual;
+  actual.reserve(expected.size());
+  for(const traversability_generator3d::TravGenNode* n : nodes)
+  {
+    for(double heading : headings)
+      actual.push_back(obsGen.isHeadingAllowed(n, heading));
+  }
+
+  EXPECT_EQ(expected, actual);
+}
+
+TEST_F(PlannerTest, check_swept_footprint) {
+  traversabilityConfig.costFunctionDist = 0.3;
+
+  PreComputedMotions motions(splinePrimitiveConfig, mobility);
+  motions.computeMotions(traversabilityConfig.gridResolution, traversabilityConfig.gridResolution);
+  RobotFootprint footprint(traversabilityConfig);
+  motions.computeSweptFootprints(footprint);
+
+  for(int t = 0; t < splinePrimitiveConfig.numAngles; ++t)
+  {
+    for(const Motion& motion : motions.getMotionForStartTheta(DiscreteTheta(t, splinePrimitiveConfig.numAngles)))
+    {
+      EXPECT_EQ(motion.sweptFootprint.size(), motions.getMotion(motion.id).sweptFootprint.size());
+      if(motion.type == Motion::MOV_POINTTURN)
+      {
+        EXPECT_TRUE(motion.sweptFootprint.empty());
+        continue;
+      }
+
+      //every cell that the robot covers at any pose has to be marked as robot cell exactly once
+      std::map<std::pair<int, int>, bool> expected;
+      for(const PoseWithCell& pwc : motion.intermediateStepsObstMap)
+      {
+        const base::Vector2d poseOffset(pwc.pose.position - base::Vector2d(pwc.cell.x(), pwc.cell.y()) * traversabilityConfig.gridResolution);
+        const Eigen::Rotation2D<double> yawInverse(Eigen::Rotation2D<double>(pwc.pose.orientation).inverse());
+        for(int y = -10; y <= 10; ++y)
+        {
+          for(int x = -10; x <= 10; ++x)
+          {
+            if(footprint.classify(poseOffset, yawInverse, maps::grid::Index(x, y)).insideRobot)
+              expected[std::make_pair(pwc.cell.x() + x, pwc.cell.y() + y)] = true;
+          }
+        }
+      }
+
+      std::map<std::pair<int, int>, bool> swept;
+      for(size_t i = 0; i < motion.sweptFootprint.size(); ++i)
+      {
+        const SweptCell& cell = motion.sweptFootprint[i];
+        const std::pair<int, int> key(cell.cell.x(), cell.cell.y());
+        EXPECT_EQ(swept.count(key), 0u);
+        swept[key] = cell.insideRobot;
+        EXPECT_LT(cell.parent, static_cast<int>(i));
+        if(cell.parent >= 0)
+        {
+          const maps::grid::Index diff(cell.cell - motion.sweptFootprint[cell.parent].cell);
+          EXPECT_LE(std::abs(diff.x()), 1);
+          EXPECT_LE(std::abs(diff.y()), 1);
+        }
+      }
+
+      for(const auto& e : expected)
+      {
+        ASSERT_EQ(swept.count(e.first), 1u);
+        EXPECT_TRUE(swept[e.first]);
+      }
+    }
+  }
+}
+
+TEST_F(PlannerTest, check_motion_trie) {
+
+  PreComputedMotions motions(splinePrimitiveConfig, mobility);
+  motions.computeMotions(traversabilityConfig.gridResolution, traversabilityConfig.gridResolution);
+
+  for(int t = 0; t < splinePrimitiveConfig.numAngles; ++t)
+  {
+    const DiscreteTheta theta(t, splinePrimitiveConfig.numAngles);
+    const MotionRange thetaMotions = motions.getMotionForStartTheta(theta);
+    const std::vector<MotionTrieNode>& trie = motions.getMotionTrieForStartTheta(theta);
+    ASSERT_FALSE(trie.empty());
+    EXPECT_EQ(trie[0].parent, -1);
+    EXPECT_EQ(trie[0].subtreeEnd, trie.size());
+
+    std::vector<int> found(thetaMotions.size(), 0);
+    for(size_t i = 0; i < trie.size(); ++i)
+    {
+      if(i > 0)
+      {
+        //depth first order, every node is inside of the subtree of its parent
+        ASSERT_GE(trie[i].parent, 0);
+        const size_t parent = trie[i].parent;
+        EXPECT_LT(parent, i);
+        EXPECT_LE(trie[i].subtreeEnd, trie[parent].subtreeEnd);
+      }
+      EXPECT_GT(trie[i].subtreeEnd, i);
+
+      for(size_t m : trie[i].motions)
+      {
+        ASSERT_LT(m, thetaMotions.size());
+        ++found[m];
+
+        //the path from the root to the node has to be the cell sequence of the motion
+        std::vector<maps::grid::Index> path;
+        for(int n = i; n > 0; n = trie[n].parent)
+          path.insert(path.begin(), trie[n].cell);
+        const std::vector<PoseWithCell>& steps = thetaMotions[m].intermediateStepsTravMap;
+        ASSERT_EQ(path.size(), steps.size());
+        for(size_t s = 0; s < steps.size(); ++s)
+          EXPECT_EQ(path[s], steps[s].cell);
+      }
+    }
+
+    for(int count : found)
+      EXPECT_EQ(count, 1);
+  }
+}
+
+TEST_F(PlannerTest, check_motion_store) {
+  PreComputedMotions::setCacheDirectory("");
+
+  PreComputedMotions motions(splinePrimitiveConfig, mobility);
+  motions.computeMotions(traversabilityConfig.gridResolution, traversabilityConfig.gridResolution);
+
+  //every motion is stored once, the motions of a theta are a range of the id ordered store
+  //and the obstacle steps and tries match the motions
+  auto checkStore = [&] ()
+  {
+    size_t numMotions = 0;
+    for(int t = 0; t < splinePrimitiveConfig.numAngles; ++t)
+    {
+      const DiscreteTheta theta(t, splinePrimitiveConfig.numAngles);
+      const MotionRange thetaMotions = motions.getMotionForStartTheta(theta);
+      for(const Motion& motion : thetaMotions)
+      {
+        EXPECT_EQ(&motion, &motions.getMotion(motion.id));
+        EXPECT_EQ(motion.startTheta.getTheta(), t);
+
+        const ArrayView<MotionStep> steps = motions.getObstacleSteps(motion.id);
+        ASSERT_EQ(steps.size(), motion.intermediateStepsObstMap.size());
+        for(size_t s = 0; s < steps.size(); ++s)
+        {
+          EXPECT_EQ(steps[s].cell, motion.intermediateStepsObstMap[s].cell);
+          EXPECT_EQ(steps[s].orientation, motion.intermediateStepsObstMap[s].pose.orientation);
+        }
+      }
+
+      size_t numLeaves = 0;
+      for(const MotionTrieNode& node : motions.getMotionTrieForStartTheta(theta))
+      {
+        for(size_t index : node.motions)
+        {
+          EXPECT_LT(index, thetaMotions.size());
+          ++numLeaves;
+        }
+      }
+      EXPECT_EQ(numLeaves, thetaMotions.size());
+      numMotions += thetaMotions.size();
+    }
+    EXPECT_EQ(numMotions, motions.getNumMotions());
+  };
+  checkStore();
+
+  //the full samples are sampled on demand, they cover the same cells as the trav map steps
+  for(size_t id = 0; id < motions.getNumMotions(); ++id)
+  {
+    const Motion& motion = motions.getMotion(id);
+    const std::vector<CellWithPoses> samples = motions.getFullSplineSamples(motion);
+    if(motion.type == Motion::Type::MOV_POINTTURN)
+    {
+      EXPECT_TRUE(samples.empty());
+      continue;
+    }
+    ASSERT_EQ(samples.size(), motion.intermediateStepsTravMap.size());
+    for(size_t s = 0; s < samples.size(); ++s)
+      EXPECT_EQ(samples[s].cell, motion.intermediateStepsTravMap[s].cell);
+  }
+
+  //adding a motion to the first theta moves the following motions
+  const DiscreteTheta first(0, splinePrimitiveConfig.numAngles);
+  const size_t firstSize = motions.getMotionForStartTheta(first).size();
+  Motion extra = motions.getMotionForStartTheta(first)[0];
+  extra.xDiff += 1000;
+  extra.intermediateStepsObstMap.push_back(extra.intermediateStepsObstMap.back());
+  motions.setMotionForTheta(extra, first);
+  ASSERT_EQ(motions.getMotionForStartTheta(first).size(), firstSize + 1);
+  EXPECT_EQ(motions.getMotionForStartTheta(first)[firstSize].xDiff, extra.xDiff);
+  for(size_t id = 0; id < motions.getNumMotions(); ++id)
+    EXPECT_EQ(motions.getMotion(id).id, id);
+  EXPECT_EQ(motions.getMotionForStartTheta(DiscreteTheta(1, splinePrimitiveConfig.numAngles))[0].id, firstSize + 1);
+  EXPECT_EQ(motions.getObstacleSteps(firstSize).size(), extra.intermediateStepsObstMap.size());
+  checkStore();
+}
+
+TEST_F(PlannerTest, check_motion_symmetry) {
+  PreComputedMotions::setCacheDirectory("");
+  const double res = traversabilityConfig.gridResolution;
+
+  //the default 42 angles are not divisible by four
+  sbpl_spline_primitives::SplinePrimitivesConfig config = splinePrimitiveConfig;
+  config.numAngles = 16;
+  config.numEndAngles = 8;
+
+  PreComputedMotions explicitMotions(config, mobility);
+  explicitMotions.setUseSymmetry(false);
+  explicitMotions.computeMotions(res, res);
+
+  PreComputedMotions derivedMotions(config, mobility);
+  ASSERT_TRUE(derivedMotions.getUseSymmetry());
+  EXPECT_TRUE(PreComputedMotions::isQuarterSymmetric(derivedMotions.getPrimitives()));
+  derivedMotions.computeMotions(res, res);
+
+  //the derived motions are exact rotations of the motions of the first quadrant (in the same order)
+  const int quarter = config.numAngles / 4;
+  auto expectRotated = [] (const std::vector<PoseWithCell>& source, const std::vector<PoseWithCell>& rotated, int quarterTurns)
+  {
+    ASSERT_EQ(source.size(), rotated.size());
+    for(size_t s = 0; s < source.size(); ++s)
+    {
+      maps::grid::Index cell = source[s].cell;
+      base::Vector2d position = source[s].pose.position;
+      for(int q = 0; q < quarterTurns; ++q)
+      {
+        cell = maps::grid::Index(-cell.y(), cell.x());
+        position = base::Vector2d(-position.y(), position.x());
+      }
+      EXPECT_EQ(rotated[s].cell, cell);
+      EXPECT_EQ(rotated[s].pose.position, position);
+      EXPECT_EQ(rotated[s].pose.orientation, base::Angle::fromRad(source[s].pose.orientation + quarterTurns * M_PI / 2.0).getRad());
+    }
+  };
+  for(int t = quarter; t < config.numAngles; ++t)
+  {
+    const int quarterTurns = t / quarter;
+    const MotionRange sources = derivedMotions.getMotionForStartTheta(DiscreteTheta(t % quarter, config.numAngles));
+    const MotionRange rotated = derivedMotions.getMotionForStartTheta(DiscreteTheta(t, config.numAngles));
+    ASSERT_EQ(sources.size(), rotated.size());
+    for(size_t i = 0; i < sources.size(); ++i)
+    {
+      const Motion& a = sources[i];
+      const Motion& b = rotated[i];
+      maps::grid::Index end(a.xDiff, a.yDiff);
+      for(int q = 0; q < quarterTurns; ++q)
+        end = maps::grid::Index(-end.y(), end.x());
+      EXPECT_EQ(b.xDiff, end.x());
+      EXPECT_EQ(b.yDiff, end.y());
+      EXPECT_EQ(b.endTheta.getTheta(), (a.endTheta.getTheta() + quarterTurns * quarter) % config.numAngles);
+      EXPECT_EQ(b.type, a.type);
+      EXPECT_EQ(b.baseCost, a.baseCost);
+      EXPECT_EQ(b.primitiveIndex, a.primitiveIndex);
+      EXPECT_EQ(b.quarterTurns, quarterTurns);
+      expectRotated(a.intermediateStepsTravMap, b.intermediateStepsTravMap, quarterTurns);
+      expectRotated(a.intermediateStepsObstMap, b.intermediateStepsObstMap, quarterTurns);
+    }
+  }
+
+  //and describe the same motions as the explicitly sampled primitives. The intermediate poses are not
+  //compared, samples that are exactly on a cell border may end up in a different cell due to rounding
+  ASSERT_EQ(derivedMotions.getNumMotions(), explicitMotions.getNumMotions());
+  for(size_t id = 0; id < explicitMotions.getNumMotions(); ++id)
+  {
+    const Motion& a = explicitMotions.getMotion(id);
+    const Motion& b = derivedMotions.getMotion(id);
+    EXPECT_EQ(a.xDiff, b.xDiff);
+    EXPECT_EQ(a.yDiff, b.yDiff);
+    EXPECT_EQ(a.startTheta, b.startTheta);
+    EXPECT_EQ(a.endTheta, b.endTheta);
+    EXPECT_EQ(a.type, b.type);
+    EXPECT_EQ(a.primitiveIndex, b.primitiveIndex);
+  }
+}
+
+TEST_F(PlannerTest, check_motion_cache) {
+  const TempDirectory tempDir;
+  const boost::filesystem::path& cacheDir = tempDir.path;
+  PreComputedMotions::setCacheDirectory(cacheDir.string());
+  const double res = traversabilityConfig.gridResolution;
+
+  PreComputedMotions computed(splinePrimitiveConfig, mobility);
+  computed.computeMotions(res, res);
+  EXPECT_FALSE(computed.isLoadedFromCache());
+
+  PreComputedMotions cached(splinePrimitiveConfig, mobility);
+  cached.computeMotions(res, res);
+  EXPECT_TRUE(cached.isLoadedFromCache());
+
+  ASSERT_EQ(cached.getNumMotions(), computed.getNumMotions());
+  for(size_t id = 0; id < computed.getNumMotions(); ++id)
+  {
+    const Motion& a = computed.getMotion(id);
+    const Motion& b = cached.getMotion(id);
+    EXPECT_EQ(a.xDiff, b.xDiff);
+    EXPECT_EQ(a.yDiff, b.yDiff);
+    EXPECT_EQ(a.startTheta, b.startTheta);
+    EXPECT_EQ(a.endTheta, b.endTheta);
+    EXPECT_EQ(a.type, b.type);
+    EXPECT_EQ(a.baseCost, b.baseCost);
+    EXPECT_EQ(a.primitiveIndex, b.primitiveIndex);
+    EXPECT_EQ(a.quarterTurns, b.quarterTurns);
+    EXPECT_EQ(cached.getFullSplineSamples(b).size(), computed.getFullSplineSamples(a).size());
+    ASSERT_EQ(a.intermediateStepsObstMap.size(), b.intermediateStepsObstMap.size());
+    for(size_t s = 0; s < a.intermediateStepsObstMap.size(); ++s)
+    {
+      EXPECT_EQ(a.intermediateStepsObstMap[s].cell, b.intermediateStepsObstMap[s].cell);
+      EXPECT_EQ(a.intermediateStepsObstMap[s].pose.orientation, b.intermediateStepsObstMap[s].pose.orientation);
+    }
+  }
+  for(int t = 0; t < splinePrimitiveConfig.numAngles; ++t)
+  {
+    const DiscreteTheta theta(t, splinePrimitiveConfig.numAngles);
+    EXPECT_EQ(cached.getMotionForStartTheta(theta).size(), computed.getMotionForStartTheta(theta).size());
+    EXPECT_EQ(cached.getMotionTrieForStartTheta(theta).size(), computed.getMotionTrieForStartTheta(theta).size());
+  }
+
+  //a different configuration uses a different cache file
+  Mobility otherMobility = mobility;
+  otherMobility.multiplierPointTurn += 1;
+  PreComputedMotions other(splinePrimitiveConfig, otherMobility);
+  other.computeMotions(res, res);
+  EXPECT_FALSE(other.isLoadedFromCache());
+
+  //corrupt files are recomputed (and rewritten)
+  auto corruptCache = [&cacheDir] (const std::function<void (const std::string&)>& corrupt)
+  {
+    for(boost::filesystem::directory_iterator it(cacheDir); it != boost::filesystem::directory_iterator(); ++it)
+      corrupt(it->path().string());
+  };
+  //number of motions in the header, which is not covered by the checksum
+  corruptCache([] (const std::string& file)
+  {
+    std::fstream stream(file, std::ios::in | std::ios::out | std::ios::binary);
+    stream.seekp(28);
+    const uint32_t numMotions = std::numeric_limits<uint32_t>::max();
+    stream.write(reinterpret_cast<const char*>(&numMotions), sizeof numMotions);
+  });
+  PreComputedMotions corruptHeader(splinePrimitiveConfig, mobility);
+  corruptHeader.computeMotions(res, res);
+  EXPECT_FALSE(corruptHeader.isLoadedFromCache());
+  EXPECT_EQ(corruptHeader.getNumMotions(), computed.getNumMotions());
+
+  corruptCache([] (const std::string& file) { boost::filesystem::resize_file(file, 40); });
+  PreComputedMotions truncated(splinePrimitiveConfig, mobility);
+  truncated.computeMotions(res, res);
+  EXPECT_FALSE(truncated.isLoadedFromCache());
+  EXPECT_EQ(truncated.getNumMotions(), computed.getNumMotions());
+
+  PreComputedMotions::setCacheDirectory("");
+}
+
+TEST_F(PlannerTest, check_parallel_motion_computation) {
+  PreComputedMotions::setCacheDirectory("");
+  const double res = traversabilityConfig.gridResolution;
+
+  const int maxThreads = omp_get_max_threads();
+  PreComputedMotions sequential(splinePrimitiveConfig, mobility);
+  omp_set_num_threads(1);
+  sequential.computeMotions(res, res);
+
+  PreComputedMotions parallel(splinePrimitiveConfig, mobility);
+  omp_set_num_threads(4);
+  parallel.computeMotions(res, res);
+  omp_set_num_threads(maxThreads);
+
+  //the ids do not depend on the number of threads
+  ASSERT_EQ(sequential.getNumMotions(), parallel.getNumMotions());
+  for(size_t id = 0; id < sequential.getNumMotions(); ++id)
+  {
+    const Motion& a = sequential.getMotion(id);
+    const Motion& b = parallel.getMotion(id);
+    EXPECT_EQ(b.id, id);
+    EXPECT_EQ(a.xDiff, b.xDiff);
+    EXPECT_EQ(a.yDiff, b.yDiff);
+    EXPECT_EQ(a.startTheta, b.startTheta);
+    EXPECT_EQ(a.endTheta, b.endTheta);
+    EXPECT_EQ(a.type, b.type);
+    EXPECT_EQ(a.baseCost, b.baseCost);
+    EXPECT_EQ(a.intermediateStepsTravMap.size(), b.intermediateStepsTravMap.size());
+  }
+
+  //adding the same motions again only produces duplicates
+  parallel.computeMotions(res, res);
+  EXPECT_EQ(parallel.getNumMotions(), sequential.getNumMotions());
+}
+
+//RobotFootprint.hpp
+TEST(UGV_NAV4D_TEST, check_robot_footprint_masks) {
+  traversability_generator3d::TraversabilityConfig config;
+  config.gridResolution = 0.3;
+  config.robotSizeX = 0.9;
+  config.robotSizeY = 0.5;
+  config.costFunctionDist = 0.4;
+
+  const unsigned int numAngles = 16;
+  const unsigned int subCellSteps = 3;
+  RobotFootprint footprint(config);
+  footprint.precompute(numAngles, subCellSteps);
+
+  const Eigen::Vector2d halfRobot(config.robotSizeX / 2.0, config.robotSizeY / 2.0);
+  const Eigen::Vector2d halfOuter(halfRobot + Eigen::Vector2d::Constant(config.costFunctionDist));
+  const Eigen::AlignedBox<double, 2> robotBox(-halfRobot, halfRobot);
+  const Eigen::AlignedBox<double, 2> outerBox(-halfOuter, halfOuter);
+  const double r = config.gridResolution / 2.0;
+  const std::vector<Eigen::Vector2d> corners = {{-r, -r}, {-r, r}, {r, r}, {r, -r}};
+
+  for(unsigned int t = 0; t < numAngles; ++t)
+  {
+    const double orientation = DiscreteTheta(static_cast<int>(t), numAngles).getRadian();
+    const Eigen::Rotation2D<double> yawInverse(Eigen::Rotation2D<double>(orientation).inverse());
+    for(unsigned int sy = 0; sy < subCellSteps; ++sy)
+    {
+      for(unsigned int sx = 0; sx < subCellSteps; ++sx)
+      {
+        const base::Vector2d poseOffset(((sx + 0.5) / subCellSteps - 0.5) * config.gridResolution,
+                                        ((sy + 0.5) / subCellSteps - 0.5) * config.gridResolution);
+        const RobotFootprint::Mask* mask = footprint.findMask(poseOffset, orientation);
+        ASSERT_NE(mask, nullptr);
+
+        //compare against the geometric check that PathStatistic used to do for every cell
+        for(int y = -10; y <= 10; ++y)
+        {
+          for(int x = -10; x <= 10; ++x)
+          {
+            const Eigen::Vector2d cellPos(x * config.gridResolution, y * config.gridResolution);
+            bool insideRobot = false;
+            bool insideOuter = false;
+            double boundaryDistance = std::numeric_limits<double>::max();
+            for(const Eigen::Vector2d& c : corners)
+            {
+              const Eigen::Vector2d tp = yawInverse * (cellPos + c - poseOffset);
+              if(outerBox.contains(tp))
+              {
+                insideOuter = true;
+                if(robotBox.contains(tp))
+                  insideRobot = true;
+                else
+                  boundaryDistance = std::min(boundaryDistance, robotBox.exteriorDistance(tp));
+              }
+            }
+
+            const RobotFootprint::Cell& cell = mask->at(maps::grid::Index(x, y));
+            EXPECT_EQ(cell.insideCorridor, insideOuter);
+            EXPECT_EQ(cell.insideRobot, insideRobot);
+            EXPECT_DOUBLE_EQ(cell.boundaryDistance, boundaryDistance);
+            if(insideRobot)
+              EXPECT_DOUBLE_EQ(cell.robotDistance, cellPos.norm());
+          }
+        }
+      }
+    }
+  }
+
+  //poses between the precomputed ones are snapped to the closest offset and heading
+  const double subCell = config.gridResolution / subCellSteps;
+  const double angleStep = 2.0 * M_PI / numAngles;
+  const RobotFootprint::Mask* center = footprint.findMask(base::Vector2d(0.0, 0.0), 0.0);
+  ASSERT_NE(center, nullptr);
+  EXPECT_EQ(footprint.findMask(base::Vector2d(0.4 * subCell, -0.4 * subCell), 0.4 * angleStep), center);
+  EXPECT_EQ(footprint.findMask(base::Vector2d(0.0, 0.0), 2.0 * M_PI - 0.4 * angleStep), center);
+  EXPECT_EQ(footprint.findMask(base::Vector2d(0.0, 0.0), -0.4 * angleStep), center);
+  EXPECT_NE(footprint.findMask(base::Vector2d(0.6 * subCell, 0.0), 0.0), center);
+  EXPECT_NE(footprint.findMask(base::Vector2d(0.0, 0.0), 0.6 * angleStep), center);
+  EXPECT_EQ(footprint.findMask(base::Vector2d(config.gridResolution / 2.0, 0.0), 0.0),
+            footprint.findMask(base::Vector2d(subCell, 0.0), 0.0));
+
+  //positions outside of the pose cell
+  EXPECT_EQ(footprint.findMask(base::Vector2d(0.6 * config.gridResolution, 0.0), 0.0), nullptr);
+  EXPECT_TRUE(footprint.matches(config));
+  config.robotSizeX = 1.0;
+  EXPECT_FALSE(footprint.matches(config));
+}
+
+//ObstacleDistanceField.hpp
+TEST(UGV_NAV4D_TEST, check_obstacle_distance_field) {
+  using traversability_generator3d::TravGenNode;
+
+  //a row of connected nodes
+  std::vector<std::unique_ptr<TravGenNode>> nodes;
+  for(int x = 0; x < 10; ++x)
+  {
+    nodes.emplace_back(new TravGenNode(0.0, maps::grid::Index(x, 0)));
+    nodes.back()->getUserData().id = x;
+    if(x > 0)
+    {
+      nodes[x]->addConnection(nodes[x - 1].get());
+      nodes[x - 1]->addConnection(nodes[x].get());
+    }
+  }
+
+  ObstacleDistanceField field;
+  field.reset(nodes.size(), 0.5);
+  field.addSource(nodes[0].get());
+  field.propagate(2.0);
+
+  EXPECT_DOUBLE_EQ(field.getDistance(nodes[0].get()), 0.0);
+  EXPECT_DOUBLE_EQ(field.getDistance(nodes[3].get()), 1.5);
+  EXPECT_DOUBLE_EQ(field.getDistance(nodes[4].get()), 2.0);
+  //out of range
+  EXPECT_EQ(field.getDistance(nodes[5].get()), std::numeric_limits<double>::max());
+
+  //incremental update only decreases distances
+  field.addSource(nodes[9].get());
+  field.propagate(2.0);
+  EXPECT_DOUBLE_EQ(field.getDistance(nodes[7].get()), 1.0);
+  EXPECT_DOUBLE_EQ(field.getDistance(nodes[3].get()), 1.5);
+  EXPECT_EQ(field.getDistance(nodes[4].get()), 2.0);
+
+  //nodes that are not part of the field are reported as close
+  TravGenNode unknown(0.0, maps::grid::Index(20, 0));
+  unknown.getUserData().id = 20;
+  EXPECT_EQ(field.getDistance(&unknown), 0.0);
+}
+
+TEST(UGV_NAV4D_TEST, check_obstacle_distance_field_concave) {
+  using traversability_generator3d::TravGenNode;
+  using maps::grid::TraversabilityNodeBase;
+
+  //a U shaped wall, an L shaped wall and a few single obstacles
+  const int size = 30;
+  std::vector<std::vector<bool>> obstacle(size, std::vector<bool>(size, false));
+  for(int i = 0; i <= 12; ++i)
+  {
+    obstacle[8 + i][6] = true;
+    obstacle[8][6 + i] = true;
+    obstacle[20][6 + i] = true;
+    obstacle[4][20 + i / 2] = true;
+    obstacle[4 + i][26] = true;
+  }
+  obstacle[14][12] = true;
+  obstacle[25][3] = true;
+  obstacle[26][22] = true;
+  obstacle[15][21] = true;
+
+  std::vector<std::unique_ptr<TravGenNode>> nodes;
+  for(int x = 0; x < size; ++x)
+  {
+    for(int y = 0; y < size; ++y)
+    {
+      nodes.emplace_back(new TravGenNode(0.0, maps::grid::Index(x, y)));
+      nodes.back()->getUserData().id = nodes.size() - 1;
+      nodes.back()->setType(obstacle[x][y] ? TraversabilityNodeBase::OBSTACLE : TraversabilityNodeBase::TRAVERSABLE);
+    }
+  }
+  //same as the traversability map, obstacles are only connected to the expanded traversable nodes
+  for(int x = 0; x < size; ++x)
+  {
+    for(int y = 0; y < size; ++y)
+    {
+      for(int nx = std::max(x - 1, 0); nx <= std::min(x + 1, size - 1); ++nx)
+      {
+        for(int ny = std::max(y - 1, 0); ny <= std::min(y + 1, size - 1); ++ny)
+        {
+          if((nx != x || ny != y) && !(obstacle[x][y] && obstacle[nx][ny]))
+            nodes[x * size + y]->addConnection(nodes[nx * size + ny].get());
+        }
+      }
+    }
+  }
+
+  const double res = 0.3;
+  const double range = 12 * res;
+  const double maxError = ObstacleDistanceField::maxErrorCells * res;
+  ObstacleDistanceField field;
+  field.reset(nodes.size(), res);
+  for(const std::unique_ptr<TravGenNode>& n : nodes)
+  {
+    if(n->getType() == TraversabilityNodeBase::OBSTACLE)
+      field.addSource(n.get());
+  }
+  field.propagate(range);
+
+  //compare with the brute force euclidean distance
+  for(const std::unique_ptr<TravGenNode>& n : nodes)
+  {
+    double exact = std::numeric_limits<double>::max();
+    for(const std::unique_ptr<TravGenNode>& o : nodes)
+    {
+      if(o->getType() == TraversabilityNodeBase::OBSTACLE)
+        exact = std::min(exact, (n->getIndex() - o->getIndex()).cast<double>().norm() * res);
+    }
+    const double distance = field.getDistance(n.get());
+    EXPECT_GE(distance, exact - 1e-9);
+    if(exact + maxError <= range)
+    {
+      EXPECT_LE(distance, exact + maxError) << "at " << n->getIndex().transpose();
+    }
+  }
+}
+
 //DiscreteTheta.hpp
+//Trace.hpp
+TEST(UGV_NAV4D_TEST, check_trace_buffer) {
+  TraceBuffer& buffer = TraceBuffer::instance();
+  buffer.clear();
+
+  #pragma omp parallel for
+  for(int i = 0; i < 100; ++i)
+  {
+    buffer.record(TraceEvent::INFO, __FILE__, __LINE__, "event", {double(i), 2.0 * i});
+  }
+
+  const std::vector<TraceEvent> events = buffer.snapshot();
+  EXPECT_EQ(buffer.getNumRecorded(), 100u);
+  ASSERT_EQ(events.size(), 100u);
+  std::vector<bool> found(100, false);
+  for(const TraceEvent& event : events)
+  {
+    ASSERT_EQ(event.numValues, 2u);
+    EXPECT_EQ(event.values[1], 2.0 * event.values[0]);
+    found[static_cast<int>(event.values[0])] = true;
+  }
+  EXPECT_EQ(std::count(found.begin(), found.end(), true), 100);
+
+  //statements below the compile time level are removed
+  buffer.clear();
+  UGV_NAV4D_TRACE(DEBUG, "debug");
+  UGV_NAV4D_TRACE(WARN, "warn", {1.0});
+  const size_t expected = (UGV_NAV4D_TRACE_LEVEL_DEBUG >= UGV_NAV4D_TRACE_LEVEL) + (UGV_NAV4D_TRACE_LEVEL_WARN >= UGV_NAV4D_TRACE_LEVEL);
+  EXPECT_EQ(buffer.snapshot().size(), expected);
+
+  //the oldest events are overwritten
+  buffer.clear();
+  for(size_t i = 0; i < TraceBuffer::capacity + 10; ++i)
+  {
+    buffer.record(TraceEvent::DEBUG, __FILE__, __LINE__, "event", {double(i)});
+  }
+  const std::vector<TraceEvent> wrapped = buffer.snapshot();
+  ASSERT_EQ(wrapped.size(), TraceBuffer::capacity);
+  EXPECT_EQ(wrapped.front().values[0], 10.0);
+  buffer.clear();
+}
+
+TEST(UGV_NAV4D_TEST, check_chrome_trace_concurrent_recordings) {
+  //recordings without a file name are written to the current directory
+  const TempDirectory tempDir(true);
+  const std::string traceFile = tempDir.file("trace.json");
+  setenv(ChromeTrace::environmentVariable, traceFile.c_str(), 1);
+  ChromeTrace& trace = ChromeTrace::instance();
+
+  std::vector<std::thread> planners;
+  for(int i = 0; i < 4; ++i)
+  {
+    planners.emplace_back([&trace]()
+    {
+      for(int run = 0; run < 20; ++run)
+      {
+        const bool recording = trace.start(true, 1);
+        EXPECT_TRUE(recording);
+        for(int span = 0; span < 10; ++span)
+        {
+          ChromeTraceSpan s("span", "test");
+        }
+        if(recording)
+          trace.stop();
+      }
+    });
+  }
+  for(std::thread& planner : planners)
+    planner.join();
+  unsetenv(ChromeTrace::environmentVariable);
+
+  //the last stop() ends the recording
+  EXPECT_FALSE(trace.isRecording());
+  EXPECT_FALSE(trace.getEvents().empty());
+  boost::filesystem::remove(traceFile);
+
+  //a recording that has been joined is written by the last stop()
+  EXPECT_TRUE(trace.start(true, 1));
+  EXPECT_TRUE(trace.start(true, 1));
+  EXPECT_EQ(trace.stop(), "");
+  EXPECT_TRUE(trace.isRecording());
+  const std::string written = trace.stop();
+  EXPECT_FALSE(written.empty());
+  EXPECT_FALSE(trace.isRecording());
+  EXPECT_TRUE(boost::filesystem::exists(written));
+
+  //the recording is left if planning throws
+  setenv(ChromeTrace::environmentVariable, traceFile.c_str(), 1);
+  try
+  {
+    ChromeTraceRecording recording(false, 1);
+    EXPECT_TRUE(trace.isRecording());
+    throw std::runtime_error("planning failed");
+  }
+  catch(const std::runtime_error&)
+  {
+  }
+  unsetenv(ChromeTrace::environmentVariable);
+  EXPECT_FALSE(trace.isRecording());
+  EXPECT_TRUE(boost::filesystem::exists(traceFile));
+}
+
 TEST(UGV_NAV4D_TEST, check_discrete_theta_init) {
   DiscreteTheta theta = DiscreteTheta(0,16);
   EXPECT_NEAR(theta.getRadian(),0, 0.001);
@@ -352,6 +1628,29 @@ TEST(UGV_NAV4D_TEST, check_discrete_theta_init) {
   EXPECT_EQ(thetaA.shortestDist(thetaB).getTheta(),4);
 }
 
+TEST(UGV_NAV4D_TEST, check_discrete_theta_compact) {
+  static_assert(sizeof(DiscreteTheta) == 4, "DiscreteTheta is part of every motion and state");
+  constexpr DiscreteTheta wrapped(17, 16);
+  static_assert(wrapped.getTheta() == 1, "constexpr wraparound");
+  static_assert(DiscreteTheta(3, 16).shortestDist(DiscreteTheta(14, 16)).getTheta() == 5, "constexpr shortestDist");
+
+  //numbers of angles that are not a power of two use the slow path for values far outside of the range
+  const int numAngles = 42;
+  for(int val = -3 * numAngles; val < 3 * numAngles; ++val)
+  {
+    const DiscreteTheta theta(val, numAngles);
+    EXPECT_EQ(theta.getTheta(), ((val % numAngles) + numAngles) % numAngles);
+    for(int other = 0; other < numAngles; ++other)
+    {
+      const DiscreteTheta otherTheta(other, numAngles);
+      EXPECT_EQ((theta + otherTheta).getTheta(), (theta.getTheta() + other) % numAngles);
+      EXPECT_EQ((theta - otherTheta).getTheta(), (theta.getTheta() - other + numAngles) % numAngles);
+      const int diff = std::abs(theta.getTheta() - other);
+      EXPECT_EQ(theta.shortestDist(otherTheta).getTheta(), std::min(diff, numAngles - diff));
+    }
+  }
+}
+
 int main(int argc, char ** argv){
   ::testing::InitGoogleTest(&argc, argv);
 
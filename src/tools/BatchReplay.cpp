@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <base-logging/Logging.hpp>
+#include "ugv_nav4d/ChromeTrace.hpp"
+#include "ugv_nav4d/Planner.hpp"
+#include "ugv_nav4d/PlannerDump.hpp"
+
+/** Replays planner dumps without gui and reports the results as csv or json.
+ *  Several dumps are replayed in parallel. The results of a previous run (csv) can be
+ *  used as baseline to find performance regressions between two builds. */
+
+using namespace ugv_nav4d;
+
+namespace
+{
+
+struct Options
+{
+    std::vector<std::string> inputs;
+    /** 0 uses the number of cores, or 1 if a baseline is compared */
+    unsigned jobs = 0;
+    /** planner threads per dump, 0 keeps the value of the dump */
+    unsigned threads = 1;
+    /** 0 keeps the value of the dump */
+    double maxTime = 0;
+    bool json = false;
+    std::string output;
+    std::string baseline;
+    /** relative slowdown of the total time that counts as regression */
+    double threshold = 0.1;
+    /** expand the maps even if the dump contains them */
+    bool expandMaps = false;
+};
+
+struct ReplayResult
+{
+    std::string dump;
+    std::string result;
+    PlannerStatistics statistics;
+};
+
+const char *csvHeader = "dump,result,totalTime,expandMapTime,setStartTime,setGoalTime,searchTime,getSuccsTime,"
+                        "getTrajectoryTime,expands,statesCreated,successorsGenerated,solutionCost,peakMemory";
+
+void printUsage(const char *name)
+{
+    std::cerr << "Usage: " << name << " [options] <dump or directory>...\n"
+              << "Replays planner dumps (ugv4d_dump_*.bin) without gui.\n"
+              << "  --jobs <n>         number of dumps that are replayed in parallel (default: number of cores, 1 with --compare)\n"
+              << "  --threads <n>      planner threads per dump, 0 uses the value of the dump (default: 1)\n"
+              << "  --max-time <s>     planning time per dump, 0 uses the value of the dump (default: 0)\n"
+              << "  --format csv|json  output format (default: csv)\n"
+              << "  --output <file>    write the results to <file> instead of stdout\n"
+              << "  --compare <file>   csv results of a previous run, prints the differences to stderr.\n"
+              << "                     Concurrent jobs make the timings noisy, thus the default is --jobs 1\n"
+              << "  --threshold <r>    relative slowdown of the total time that counts as regression (default: 0.1)\n"
+              << "  --expand-maps      expand the maps from the mls map even if the dump contains the expanded maps\n"
+              << "peakMemory is the peak resident memory of the whole process, use --jobs 1 to measure single dumps.\n"
+              << ChromeTrace::environmentVariable << " is only used with --jobs 1.\n"
+              << "Exits with 1 if a regression has been found.\n";
+}
+
+/** @return @p value as non negative number. Throws std::invalid_argument or std::out_of_range otherwise */
+unsigned parseCount(const std::string& value)
+{
+    size_t end = 0;
+    const int count = std::stoi(value, &end);
+    if(end != value.size() || count < 0)
+        throw std::invalid_argument(value);
+    return count;
+}
+
+/** @return @p value as non negative number. Throws std::invalid_argument or std::out_of_range otherwise */
+double parseNumber(const std::string& value)
+{
+    size_t end = 0;
+    const double number = std::stod(value, &end);
+    if(end != value.size() || !std::isfinite(number) || number < 0)
+        throw std::invalid_argument(value);
+    return number;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        const bool hasValue = i + 1 < argc;
+        try
+        {
+            if(arg == "--help" || arg == "-h")
+                return false;
+            else if(arg == "--jobs" && hasValue)
+                options.jobs = std::max(1u, parseCount(argv[++i]));
+            else if(arg == "--threads" && hasValue)
+                options.threads = parseCount(argv[++i]);
+            else if(arg == "--max-time" && hasValue)
+                options.maxTime = parseNumber(argv[++i]);
+            else if(arg == "--format" && hasValue)
+            {
+                const std::string format(argv[++i]);
+                if(format != "csv" && format != "json")
+                    throw std::invalid_argument(format);
+                options.json = format == "json";
+            }
+            else if(arg == "--output" && hasValue)
+                options.output = argv[++i];
+            else if(arg == "--compare" && hasValue)
+                options.baseline = argv[++i];
+            else if(arg == "--threshold" && hasValue)
+                options.threshold = parseNumber(argv[++i]);
+            else if(arg == "--expand-maps")
+                options.expandMaps = true;
+            else if(arg.compare(0, 2, "--") == 0)
+            {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+            else
+                options.inputs.push_back(arg);
+        }
+        catch(const std::logic_error&)
+        {
+            //invalid_argument and out_of_range
+            std::cerr << "Invalid value " << argv[i] << " for " << arg << "\n";
+            return false;
+        }
+    }
+
+    if(!options.jobs)
+        options.jobs = options.baseline.empty() ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    return !options.inputs.empty();
+}
+
+/** @return all dumps in @p inputs, directories are searched for *.bin files (not recursive) */
+std::vector<std::string> findDumps(const std::vector<std::string>& inputs)
+{
+    std::vector<std::string> dumps;
+    for(const std::string& input : inputs)
+    {
+        if(!boost::filesystem::is_directory(input))
+        {
+            dumps.push_back(input);
+            continue;
+        }
+
+        std::vector<std::string> dirDumps;
+        for(const boost::filesystem::directory_entry& entry : boost::filesystem::directory_iterator(input))
+        {
+            if(boost::filesystem::is_regular_file(entry.path()) && entry.path().extension() == ".bin")
+                dirDumps.push_back(entry.path().string());
+        }
+        std::sort(dirDumps.begin(), dirDumps.end());
+        dumps.insert(dumps.end(), dirDumps.begin(), dirDumps.end());
+    }
+    return dumps;
+}
+
+std::string toString(Planner::PLANNING_RESULT result)
+{
+    switch(result)
+    {
+        case Planner::GOAL_INVALID: return "GOAL_INVALID";
+        case Planner::START_INVALID: return "START_INVALID";
+        case Planner::NO_SOLUTION: return "NO_SOLUTION";
+        case Planner::NO_MAP: return "NO_MAP";
+        case Planner::INTERNAL_ERROR: return "INTERNAL_ERROR";
+        case Planner::FOUND_SOLUTION: return "FOUND_SOLUTION";
+    }
+    return "UNKNOWN";
+}
+
+ReplayResult replay(const std::string& dumpName, const Options& options)
+{
+    ReplayResult result;
+    result.dump = dumpName;
+    try
+    {
+        const PlannerDump dump(dumpName);
+        PlannerConfig plannerConfig = dump.getPlannerConfig();
+        plannerConfig.collectStatistics = true;
+        //the trace recorder is process wide
+        plannerConfig.recordChromeTrace = false;
+        if(options.threads)
+            plannerConfig.numThreads = options.threads;
+
+        Planner planner(dump.getSplineConfig(), dump.getTravConfig(), dump.getMobilityConf(), plannerConfig);
+        planner.updateMap(dump.getMlsMap());
+        //only the search is replayed, expandMapTime is the time to expand missing parts
+        if(dump.hasExpandedMaps() && !options.expandMaps)
+        {
+            std::istringstream maps(dump.getExpandedMaps());
+            planner.loadExpandedMaps(maps);
+        }
+
+        //the dump contains the poses of the ground frame, plan() expects the body frame
+        Eigen::Affine3d ground2Body(Eigen::Affine3d::Identity());
+        ground2Body.translation() = Eigen::Vector3d(0, 0, -dump.getTravConfig().distToGround);
+        base::samples::RigidBodyState start = dump.getStart();
+        base::samples::RigidBodyState goal = dump.getGoal();
+        start.setTransform(start.getTransform() * ground2Body.inverse());
+        goal.setTransform(goal.getTransform() * ground2Body.inverse());
+
+        const base::Time maxTime = options.maxTime > 0 ? base::Time::fromSeconds(options.maxTime) : dump.getMaxTime();
+        std::vector<trajectory_follower::SubTrajectory> trajectory2D;
+        std::vector<trajectory_follower::SubTrajectory> trajectory3D;
+        result.result = toString(planner.plan(maxTime, start, goal, trajectory2D, trajectory3D));
+        result.statistics = planner.getStatistics();
+    }
+    catch(const std::exception& ex)
+    {
+        LOG_ERROR_S << "Replay of " << dumpName << " failed: " << ex.what();
+        result.result = "EXCEPTION";
+    }
+    return result;
+}
+
+std::string quoteCsv(const std::string& str)
+{
+    if(str.find_first_of(",\"\n") == std::string::npos)
+        return str;
+    std::string quoted = "\"";
+    for(char c : str)
+    {
+        if(c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void writeCsv(std::ostream& out, const std::vector<ReplayResult>& results)
+{
+    out << csvHeader << "\n";
+    for(const ReplayResult& r : results)
+    {
+        const PlannerStatistics& s(r.statistics);
+        out << quoteCsv(r.dump) << ',' << r.result << ',' << s.totalTime << ',' << s.expandMapTime << ',' << s.setStartTime << ','
+            << s.setGoalTime << ',' << s.searchTime << ',' << s.getSuccsTime << ',' << s.getTrajectoryTime << ',' << s.expands << ','
+            << s.statesCreated << ',' << s.successorsGenerated << ',' << s.solutionCost << ',' << s.peakMemory << "\n";
+    }
+}
+
+std::string quoteJson(const std::string& str)
+{
+    std::string quoted = "\"";
+    for(char c : str)
+    {
+        if(c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+void writeJson(std::ostream& out, const std::vector<ReplayResult>& results)
+{
+    out << "[";
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const ReplayResult& r(results[i]);
+        const PlannerStatistics& s(r.statistics);
+        out << (i ? ",\n" : "\n") << " {\"dump\":" << quoteJson(r.dump) << ",\"result\":\"" << r.result << "\""
+            << ",\"totalTime\":" << s.totalTime << ",\"expandMapTime\":" << s.expandMapTime << ",\"setStartTime\":" << s.setStartTime
+            << ",\"setGoalTime\":" << s.setGoalTime << ",\"searchTime\":" << s.searchTime << ",\"getSuccsTime\":" << s.getSuccsTime
+            << ",\"getTrajectoryTime\":" << s.getTrajectoryTime << ",\"expands\":" << s.expands << ",\"statesCreated\":" << s.statesCreated
+            << ",\"successorsGenerated\":" << s.successorsGenerated << ",\"solutionCost\":" << s.solutionCost
+            << ",\"peakMemory\":" << s.peakMemory << "}";
+    }
+    out << "\n]\n";
+}
+
+/** Splits a line written by writeCsv() */
+std::vector<std::string> splitCsv(const std::string& line)
+{
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for(size_t i = 0; i < line.size(); ++i)
+    {
+        const char c = line[i];
+        if(c == '"')
+        {
+            if(quoted && i + 1 < line.size() && line[i + 1] == '"')
+                fields.back() += line[++i];
+            else
+                quoted = !quoted;
+        }
+        else if(c == ',' && !quoted)
+            fields.emplace_back();
+        else
+            fields.back() += c;
+    }
+    return fields;
+}
+
+/** Reads dump name, result, total time and expands of a previous csv run */
+std::map<std::string, ReplayResult> readBaseline(const std::string& fileName)
+{
+    std::ifstream input(fileName);
+    if(!input)
+        throw std::runtime_error("Cannot read baseline " + fileName);
+
+    std::map<std::string, ReplayResult> baseline;
+    std::string line;
+    std::getline(input, line);
+    if(line != csvHeader)
+        throw std::runtime_error("Baseline " + fileName + " has not been written by this version of the tool");
+
+    while(std::getline(input, line))
+    {
+        const std::vector<std::string> fields = splitCsv(line);
+        if(fields.size() < 10)
+            continue;
+        ReplayResult r;
+        r.dump = fields[0];
+        r.result = fields[1];
+        r.statistics.totalTime = std::stod(fields[2]);
+        r.statistics.searchTime = std::stod(fields[6]);
+        r.statistics.expands = std::stoul(fields[9]);
+        baseline[r.dump] = r;
+    }
+    return baseline;
+}
+
+/** Prints the differences to @p baseline. @return true if a regression has been found */
+bool compare(const std::map<std::string, ReplayResult>& baseline, const std::vector<ReplayResult>& results, double threshold)
+{
+    bool regression = false;
+    double logRatioSum = 0;
+    size_t numCompared = 0;
+
+    std::cerr << std::fixed << std::setprecision(3);
+    for(const ReplayResult& r : results)
+    {
+        const auto it = baseline.find(r.dump);
+        if(it == baseline.end())
+        {
+            std::cerr << r.dump << ": not in baseline\n";
+            continue;
+        }
+        const ReplayResult& b(it->second);
+
+        if(b.result != r.result)
+        {
+            std::cerr << r.dump << ": result changed " << b.result << " -> " << r.result << "\n";
+            regression |= b.result == "FOUND_SOLUTION";
+        }
+
+        if(b.statistics.totalTime <= 0 || r.statistics.totalTime <= 0)
+            continue;
+        const double ratio = r.statistics.totalTime / b.statistics.totalTime;
+        logRatioSum += std::log(ratio);
+        ++numCompared;
+        if(ratio > 1.0 + threshold)
+        {
+            std::cerr << r.dump << ": slower " << b.statistics.totalTime << "s -> " << r.statistics.totalTime << "s (x" << ratio
+                      << "), expands " << b.statistics.expands << " -> " << r.statistics.expands << "\n";
+            regression = true;
+        }
+        else if(ratio < 1.0 - threshold)
+        {
+            std::cerr << r.dump << ": faster " << b.statistics.totalTime << "s -> " << r.statistics.totalTime << "s (x" << ratio << ")\n";
+        }
+    }
+
+    if(numCompared)
+        std::cerr << "Geometric mean of the time ratios over " << numCompared << " dumps: " << std::exp(logRatioSum / numCompared) << "\n";
+    return regression;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if(!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    //the trace recorder is process wide, the traces of concurrent replays would be mixed into one file
+    if(options.jobs > 1 && std::getenv(ChromeTrace::environmentVariable))
+    {
+        std::cerr << "Ignoring " << ChromeTrace::environmentVariable << ", use --jobs 1 to record a trace\n";
+        unsetenv(ChromeTrace::environmentVariable);
+    }
+
+    //fail before replaying
+    std::ofstream file;
+    if(!options.output.empty())
+    {
+        file.open(options.output);
+        if(!file.is_open())
+        {
+            std::cerr << "Cannot write " << options.output << "\n";
+            return -1;
+        }
+    }
+
+    const std::vector<std::string> dumps = findDumps(options.inputs);
+    std::vector<ReplayResult> results(dumps.size());
+
+    std::atomic<size_t> nextDump(0);
+    std::vector<std::thread> workers;
+    for(unsigned i = 0; i < std::min<size_t>(options.jobs, dumps.size()); ++i)
+    {
+        workers.emplace_back([&]()
+        {
+            for(size_t d = nextDump++; d < dumps.size(); d = nextDump++)
+            {
+                results[d] = replay(dumps[d], options);
+                LOG_INFO_S << "Replayed " << dumps[d] << ": " << results[d].result;
+            }
+        });
+    }
+    for(std::thread& worker : workers)
+        worker.join();
+
+    std::ostream& out = options.output.empty() ? std::cout : file;
+    if(options.json)
+        writeJson(out, results);
+    else
+        writeCsv(out, results);
+
+    if(!options.baseline.empty())
+    {
+        if(options.jobs > 1)
+            std::cerr << "Note: " << options.jobs << " dumps have been replayed concurrently, the time comparison is noisy. Use --jobs 1\n";
+        try
+        {
+            if(compare(readBaseline(options.baseline), results, options.threshold))
+                return 1;
+        }
+        catch(const std::exception& ex)
+        {
+            std::cerr << ex.what() << "\n";
+            return -1;
+        }
+    }
+    return 0;
+}